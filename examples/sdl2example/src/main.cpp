@@ -340,6 +340,10 @@ int main( int argc, char* args[] ) {
 				morda::Morda(utki::makeShared<mordaren::OpenGL2Renderer>(), 96, 1),
 				userEventType(userEventType)
 		{}
+		
+		~SDLMorda()noexcept{
+			this->shutdownThreadPool();
+		}
 				
 		void postToUiThread_ts(std::function<void()>&& f)override{
 			SDL_Event e;
@@ -392,6 +396,9 @@ int main( int argc, char* args[] ) {
 		};
 	}
 	
+	//update animations once per frame
+	morda::Morda::inst().setFramePeriod(16);
+	
 	SDL_StartTextInput(); 
 
 	for(bool quit = false; !quit;) { 
@@ -464,12 +471,15 @@ int main( int argc, char* args[] ) {
 			}
 		}
 		
+		morda::Morda::inst().flushMouseMoves();
+		
 		glClearColor( 0.5f, 0.5f, 0.5f, 1.f );
 		glClear( GL_COLOR_BUFFER_BIT );
 		
 		morda::Morda::inst().render();
 		
 		SDL_GL_SwapWindow( window ); 
+		morda::Morda::inst().syncFrame();
 	} 
 	
 	SDL_StopTextInput();
@@ -15,6 +15,8 @@ public:
 	virtual ~OpenGL2Factory()noexcept;
 
 	std::shared_ptr<morda::Texture2D> createTexture2D(morda::Texture2D::TexType_e type, kolme::Vec2ui dim, const utki::Buf<std::uint8_t>& data) override;
+	
+	bool isSupported(morda::Texture2D::TexType_e type) override;
 
 	std::shared_ptr<morda::VertexBuffer> createVertexBuffer(const utki::Buf<kolme::Vec4f> vertices) override;
 	
@@ -1,9 +1,11 @@
 #include "OpenGL2Texture2D.hpp"
 
+#include "OpenGL2FrameBuffer.hpp"
 #include "OpenGL2_util.hpp"
 
-OpenGL2Texture2D::OpenGL2Texture2D(kolme::Vec2f dim) :
-		morda::Texture2D(dim)
+OpenGL2Texture2D::OpenGL2Texture2D(kolme::Vec2f dim, GLint format) :
+		morda::Texture2D(dim),
+		format(format)
 {
 	glGenTextures(1, &this->tex);
 	assertOpenGLNoError();
@@ -21,3 +23,71 @@ void OpenGL2Texture2D::bind(unsigned unitNum) const {
 	glBindTexture(GL_TEXTURE_2D, this->tex);
 	assertOpenGLNoError();
 }
+
+void OpenGL2Texture2D::updateRegion(const kolme::Rectangle<unsigned>& rect, const utki::Buf<std::uint8_t>& data){
+	ASSERT(rect.p.x + rect.d.x <= this->dim().x && rect.p.y + rect.d.y <= this->dim().y)
+	ASSERT(rect.d.x * rect.d.y == 0 || data.size() % (rect.d.x * rect.d.y) == 0)
+	
+	if(data.size() == 0){
+		return;
+	}
+	
+	//TODO: save previous bind and restore it after?
+	this->bind(0);
+	
+	//we will be passing pixels to OpenGL which are 1-byte aligned.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	assertOpenGLNoError();
+	
+	glTexSubImage2D(
+			GL_TEXTURE_2D,
+			0,//0th level, no mipmaps
+			rect.p.x,
+			rect.p.y,
+			rect.d.x,
+			rect.d.y,
+			this->format, //format of the texel data
+			GL_UNSIGNED_BYTE,
+			&*data.begin()
+		);
+	assertOpenGLNoError();
+}
+
+void OpenGL2Texture2D::copyFrom(const morda::FrameBuffer* src, const kolme::Rectangle<unsigned>& rect, kolme::Vec2ui pos){
+	ASSERT(pos.x + rect.d.x <= this->dim().x && pos.y + rect.d.y <= this->dim().y)
+	
+	if(rect.d.x == 0 || rect.d.y == 0){
+		return;
+	}
+	
+	GLint oldFb;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFb);
+	assertOpenGLNoError();
+	
+	//framebuffer object 0 is the default framebuffer
+	GLuint fbo = 0;
+	if(src){
+		ASSERT(dynamic_cast<const OpenGL2FrameBuffer*>(src))
+		fbo = static_cast<const OpenGL2FrameBuffer*>(src)->fbo;
+	}
+	
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	assertOpenGLNoError();
+	
+	this->bind(0);
+	
+	glCopyTexSubImage2D(
+			GL_TEXTURE_2D,
+			0,//0th level, no mipmaps
+			pos.x,
+			pos.y,
+			rect.p.x,
+			rect.p.y,
+			rect.d.x,
+			rect.d.y
+		);
+	assertOpenGLNoError();
+	
+	glBindFramebuffer(GL_FRAMEBUFFER, oldFb);
+	assertOpenGLNoError();
+}
@@ -8,9 +8,16 @@
 struct OpenGL2Texture2D : public morda::Texture2D{
 	GLuint tex;
 	
-	OpenGL2Texture2D(kolme::Vec2f dim);
+	//format of the texel data
+	GLint format;
+	
+	OpenGL2Texture2D(kolme::Vec2f dim, GLint format);
 	
 	~OpenGL2Texture2D()noexcept;
 	
 	void bind(unsigned unitNum)const;
+	
+	void updateRegion(const kolme::Rectangle<unsigned>& rect, const utki::Buf<std::uint8_t>& data)override;
+	
+	void copyFrom(const morda::FrameBuffer* src, const kolme::Rectangle<unsigned>& rect, kolme::Vec2ui pos)override;
 };
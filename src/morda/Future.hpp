@@ -0,0 +1,321 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <utki/debug.hpp>
+
+#include "Exc.hpp"
+
+
+namespace morda{
+
+template <class T> class Future;
+template <class T> class Promise;
+
+class FutureStateBase{
+	template <class T> friend class Future;
+	template <class T> friend class Promise;
+	
+public:
+	typedef std::function<void(std::function<void()>&&)> PostFunction;
+	
+protected:
+	enum class State_e{
+		PENDING,
+		DONE,
+		CANCELED
+	};
+	
+	mutable std::mutex mutex;
+	mutable std::condition_variable cv;
+	
+	State_e state = State_e::PENDING;
+	
+	bool cancelRequested = false;
+	
+	std::exception_ptr exception;
+	
+	//posts continuation to UI thread
+	PostFunction post;
+	
+	std::function<void()> continuation;
+	
+	FutureStateBase(PostFunction&& post) :
+			post(std::move(post))
+	{}
+	
+	//must be called with mutex locked, unlocks the mutex
+	void finish(std::unique_lock<std::mutex>& lock, State_e newState){
+		this->state = newState;
+		auto c = std::move(this->continuation);
+		bool canceled = this->cancelRequested;
+		lock.unlock();
+		
+		this->cv.notify_all();
+		
+		if(c && !canceled && newState == State_e::DONE){
+			this->post(std::move(c));
+		}
+	}
+	
+	void wait()const{
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->cv.wait(
+				lock,
+				[this](){
+					return this->state != State_e::PENDING;
+				}
+			);
+	}
+	
+	void rethrowIfFailed()const{
+		if(this->state == State_e::CANCELED){
+			throw Exc("Future: task was canceled");
+		}
+		if(this->exception){
+			std::rethrow_exception(this->exception);
+		}
+	}
+	
+	void setException(std::exception_ptr e){
+		std::unique_lock<std::mutex> lock(this->mutex);
+		if(this->state != State_e::PENDING){
+			return;
+		}
+		this->exception = std::move(e);
+		this->finish(lock, State_e::DONE);
+	}
+	
+	void cancel(){
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->cancelRequested = true;
+		this->continuation = nullptr;
+	}
+	
+	void breakPromise(){
+		std::unique_lock<std::mutex> lock(this->mutex);
+		if(this->state != State_e::PENDING){
+			return;
+		}
+		this->finish(lock, State_e::CANCELED);
+	}
+	
+	void setContinuation(std::function<void()>&& c){
+		std::unique_lock<std::mutex> lock(this->mutex);
+		if(this->cancelRequested){
+			return;
+		}
+		if(this->state == State_e::PENDING){
+			this->continuation = std::move(c);
+			return;
+		}
+		if(this->state == State_e::CANCELED){
+			return;
+		}
+		lock.unlock();
+		this->post(std::move(c));
+	}
+	
+public:
+	virtual ~FutureStateBase()noexcept{}
+};
+
+template <class T> class FutureState : public FutureStateBase{
+	template <class TT> friend class Future;
+	template <class TT> friend class Promise;
+	
+	std::unique_ptr<T> value;
+	
+	FutureState(PostFunction&& post) :
+			FutureStateBase(std::move(post))
+	{}
+	
+	typedef const T& ResultType;
+	
+	ResultType result()const{
+		return *this->value;
+	}
+	
+	template <class F> void setResultOf(F& f){
+		std::unique_ptr<T> v(new T(f()));
+		std::unique_lock<std::mutex> lock(this->mutex);
+		if(this->state != State_e::PENDING){
+			return;
+		}
+		this->value = std::move(v);
+		this->finish(lock, State_e::DONE);
+	}
+};
+
+template <> class FutureState<void> : public FutureStateBase{
+	template <class TT> friend class Future;
+	template <class TT> friend class Promise;
+	
+	FutureState(PostFunction&& post) :
+			FutureStateBase(std::move(post))
+	{}
+	
+	typedef void ResultType;
+	
+	void result()const{}
+	
+	template <class F> void setResultOf(F& f){
+		f();
+		std::unique_lock<std::mutex> lock(this->mutex);
+		if(this->state != State_e::PENDING){
+			return;
+		}
+		this->finish(lock, State_e::DONE);
+	}
+};
+
+
+
+/**
+ * @brief Result of asynchronous operation.
+ * Future is a handle to the result of a task which is executed asynchronously.
+ * Copies of Future object refer to the same result.
+ * @param T - type of the result.
+ */
+template <class T> class Future{
+	friend class Promise<T>;
+	
+	std::shared_ptr<FutureState<T>> s;
+	
+	Future(std::shared_ptr<FutureState<T>> s) :
+			s(std::move(s))
+	{}
+public:
+	Future() = default;
+	
+	/**
+	 * @brief Check if this future refers to some task.
+	 * @return true if future refers to a task.
+	 * @return false if future is default constructed.
+	 */
+	bool isValid()const noexcept{
+		return bool(this->s);
+	}
+	
+	/**
+	 * @brief Check if the result is ready.
+	 * @return true if the task has finished, failed or was canceled.
+	 * @return false if the task is not finished yet.
+	 */
+	bool isReady()const{
+		ASSERT(this->s)
+		std::lock_guard<std::mutex> lock(this->s->mutex);
+		return this->s->state != FutureStateBase::State_e::PENDING;
+	}
+	
+	/**
+	 * @brief Wait for the task to finish.
+	 */
+	void wait()const{
+		ASSERT(this->s)
+		this->s->wait();
+	}
+	
+	/**
+	 * @brief Get result.
+	 * Waits for the task to finish and returns its result.
+	 * If the task has thrown an exception, the exception is re-thrown.
+	 * @return Result of the task.
+	 * @throw morda::Exc - if the task was canceled.
+	 */
+	typename FutureState<T>::ResultType get()const{
+		this->wait();
+		this->s->rethrowIfFailed();
+		return this->s->result();
+	}
+	
+	/**
+	 * @brief Cancel the task.
+	 * If the task has not started yet, it will not be executed.
+	 * The continuation will not be called.
+	 */
+	void cancel(){
+		ASSERT(this->s)
+		this->s->cancel();
+	}
+	
+	/**
+	 * @brief Set continuation.
+	 * Continuation is executed on UI thread when the task is finished or has failed.
+	 * Call get() on the future passed to the continuation to obtain the result.
+	 * If the task is already finished, the continuation is posted to UI thread right away.
+	 * Continuation is not called if the task was canceled.
+	 * @param f - continuation.
+	 */
+	void then(std::function<void(Future<T>)>&& f){
+		ASSERT(this->s)
+		auto s = this->s;
+		this->s->setContinuation(
+				[s, f](){
+					f(Future<T>(s));
+				}
+			);
+	}
+};
+
+
+
+/**
+ * @brief Producer side of a Future.
+ * If promise is destroyed without providing a result, its future becomes canceled.
+ * @param T - type of the result.
+ */
+template <class T> class Promise{
+	std::shared_ptr<FutureState<T>> s;
+public:
+	/**
+	 * @brief Constructor.
+	 * @param post - function which posts continuations for execution on UI thread.
+	 */
+	Promise(FutureStateBase::PostFunction&& post) :
+			s(new FutureState<T>(std::move(post)))
+	{}
+	
+	Promise(const Promise&) = delete;
+	Promise& operator=(const Promise&) = delete;
+	
+	~Promise()noexcept{
+		this->s->breakPromise();
+	}
+	
+	/**
+	 * @brief Get future.
+	 * @return Future associated with this promise.
+	 */
+	Future<T> future(){
+		return Future<T>(this->s);
+	}
+	
+	/**
+	 * @brief Check if cancellation of the task was requested.
+	 * @return true if cancellation was requested.
+	 * @return false otherwise.
+	 */
+	bool isCanceled()const{
+		std::lock_guard<std::mutex> lock(this->s->mutex);
+		return this->s->cancelRequested;
+	}
+	
+	/**
+	 * @brief Run function and set its result or exception.
+	 * @param f - function to run.
+	 */
+	template <class F> void setResultOf(F& f){
+		try{
+			this->s->setResultOf(f);
+		}catch(...){
+			this->s->setException(std::current_exception());
+		}
+	}
+};
+
+}
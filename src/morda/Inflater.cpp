@@ -112,6 +112,21 @@ void substituteVars(stob::Node* to, const std::function<const stob::Node*(const
 }
 }
 
+namespace{
+//Checks if STOB chain or its children have references to variables.
+bool hasVarRefs(const stob::Node* chain){
+	for(; chain; chain = chain->next()){
+		if(*chain == "@"){
+			return true;
+		}
+		if(hasVarRefs(chain->child())){
+			return true;
+		}
+	}
+	return false;
+}
+}
+
 namespace{
 //Merges two STOB chains. 
 std::unique_ptr<stob::Node> mergeGUIChain(const stob::Node* tmpl, const std::set<std::string>& varNames, std::unique_ptr<stob::Node> chain){
@@ -250,9 +265,11 @@ std::shared_ptr<morda::Widget> Inflater::inflate(const stob::Node& chain){
 		if(cloned){
 			cloned = cloned->removeChildren();
 		}else{
-			if(n->child()){
-				cloned = n->child()->cloneChain();
+			if(!hasVarRefs(n->child())){
+				//nothing to substitute, no need to clone the description
+				return fac->create(n->child());
 			}
+			cloned = n->child()->cloneChain();
 		}
 		
 		this->substituteVariables(cloned.get());
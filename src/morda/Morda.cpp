@@ -13,6 +13,7 @@
 
 #include "widgets/label/ColorLabel.hpp"
 #include "widgets/label/TextLabel.hpp"
+#include "widgets/label/ParagraphLabel.hpp"
 
 #include "widgets/TextField.hpp"
 #include "widgets/List.hpp"
@@ -94,6 +95,7 @@ void Morda::initStandardWidgets(papki::File& fi) {
 	//add standard widgets to inflater
 	
 	this->inflater.addWidget<TextLabel>("TextLabel");
+	this->inflater.addWidget<ParagraphLabel>("ParagraphLabel");
 	this->inflater.addWidget<VerticalSlider>("VerticalSlider");
 	this->inflater.addWidget<HorizontalSlider>("HorizontalSlider");
 	this->inflater.addWidget<ImageLabel>("ImageLabel");
@@ -126,6 +128,58 @@ void Morda::initStandardWidgets(papki::File& fi) {
 	}
 }
 
+std::uint32_t Morda::update(){
+	this->uiQueue.drain(this->uiQueueBudget);
+	
+	this->flushMouseMoves();
+	
+	std::uint32_t ret = this->updater.update();
+	
+	if(this->uiQueue.size_ts() != 0){
+		//there are more tasks to execute
+		return 0;
+	}
+	
+	return ret;
+}
+
+
+
+Morda::~Morda()noexcept{
+	//The host class must have stopped worker threads from its destructor already, since workers
+	//may call postToUiThread_ts() which is implemented by the host class.
+	ASSERT_INFO(!this->threadPool_v, "Morda::~Morda(): shutdownThreadPool() was not called from the host class destructor")
+	this->shutdownThreadPool();
+}
+
+
+
+void Morda::shutdownThreadPool()noexcept{
+	this->isDestroying.store(true);
+	this->threadPool_v.reset();
+}
+
+
+
+ThreadPool& Morda::threadPool(){
+	ASSERT_INFO(!this->isDestroying.load(), "Morda::threadPool(): thread pool has been shut down")
+	if(!this->threadPool_v){
+		this->threadPool_v = utki::makeUnique<ThreadPool>();
+	}
+	return *this->threadPool_v;
+}
+
+
+
+void Morda::postToUiQueue_ts(std::function<void()>&& f, UiQueue::Priority_e priority){
+	if(this->uiQueue.push_ts(std::move(f), priority) && !this->isDestroying.load()){
+		//queue has become non-empty, wake up the main loop, tasks will be executed from update()
+		this->postToUiThread_ts([](){});
+	}
+}
+
+
+
 void Morda::setViewportSize(const morda::Vec2r& size){
 	this->viewportSize = size;
 	
@@ -168,7 +222,7 @@ void Morda::render(const Matr4r& matrix)const{
 
 
 
-void Morda::onMouseMove(const Vec2r& pos, unsigned id){
+void Morda::dispatchMouseMove(const Vec2r& pos, unsigned id){
 	if(!this->rootWidget){
 		return;
 	}
@@ -181,7 +235,61 @@ void Morda::onMouseMove(const Vec2r& pos, unsigned id){
 
 
 
+void Morda::onMouseMove(const Vec2r& pos, unsigned id){
+	if(!this->coalesceMouseMoves_v){
+		this->mouseMoveHistory_v.assign(1, pos);
+		this->dispatchMouseMove(pos, id);
+		this->mouseMoveHistory_v.clear();
+		return;
+	}
+	
+	auto& h = this->pendingMouseMoves[id];
+	if(h.size() == maxMouseMoveHistory_c){
+		h.erase(h.begin());
+	}
+	h.push_back(pos);
+}
+
+
+
+void Morda::flushMouseMoves(){
+	if(this->mouseMoveHistory_v.size() != 0){
+		//called from within mouse move dispatching, new moves will be dispatched on next flush
+		return;
+	}
+	
+	for(auto& p : this->pendingMouseMoves){
+		if(p.second.size() == 0){
+			continue;
+		}
+		
+		//swap to keep the allocated buffers and to allow feeding in new moves from within the handlers
+		std::swap(this->mouseMoveHistory_v, p.second);
+		p.second.clear();
+		
+		utki::ScopeExit scopeExit([this](){
+			this->mouseMoveHistory_v.clear();
+		});
+		
+		this->dispatchMouseMove(this->mouseMoveHistory_v.back(), p.first);
+	}
+}
+
+
+
+void Morda::setCoalesceMouseMoves(bool coalesce){
+	if(!coalesce){
+		this->flushMouseMoves();
+	}
+	this->coalesceMouseMoves_v = coalesce;
+}
+
+
+
 void Morda::onMouseButton(bool isDown, const Vec2r& pos, MouseButton_e button, unsigned pointerID){
+	//preserve the order of events
+	this->flushMouseMoves();
+	
 	if(!this->rootWidget){
 		return;
 	}
@@ -195,6 +303,9 @@ void Morda::onMouseButton(bool isDown, const Vec2r& pos, MouseButton_e button, u
 
 
 void Morda::onMouseHover(bool isHovered, unsigned pointerID){
+	//preserve the order of events
+	this->flushMouseMoves();
+	
 	if(!this->rootWidget){
 		return;
 	}
@@ -203,6 +314,9 @@ void Morda::onMouseHover(bool isHovered, unsigned pointerID){
 }
 
 void Morda::onKeyEvent(bool isDown, Key_e keyCode){
+	//preserve the order of events
+	this->flushMouseMoves();
+	
 //		TRACE(<< "HandleKeyEvent(): is_down = " << is_down << " is_char_input_only = " << is_char_input_only << " keyCode = " << unsigned(keyCode) << std::endl)
 
 	if(auto w = this->focusedWidget.lock()){
@@ -232,6 +346,9 @@ void Morda::setFocusedWidget(const std::shared_ptr<Widget> w){
 }
 
 void Morda::onCharacterInput(const UnicodeProvider& unicode, Key_e key){
+	//preserve the order of events
+	this->flushMouseMoves();
+	
 	if(auto w = this->focusedWidget.lock()){
 		//			TRACE(<< "HandleCharacterInput(): there is a focused widget" << std::endl)
 		if(auto c = dynamic_cast<CharInputWidget*>(w.operator->())){
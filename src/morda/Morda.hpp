@@ -7,10 +7,17 @@
 #include "util/MouseButton.hpp"
 
 #include "Updateable.hpp"
+#include "UiQueue.hpp"
+#include "ThreadPool.hpp"
+#include "Future.hpp"
 
 #include "Inflater.hpp"
 #include "ResourceManager.hpp"
 
+#include <map>
+#include <vector>
+#include <type_traits>
+
 namespace morda{
 
 class Morda : public utki::IntrusiveSingleton<Morda>{
@@ -40,7 +47,7 @@ public:
 	Morda(const Morda&) = delete;
 	Morda& operator=(const Morda&) = delete;
 	
-	virtual ~Morda()noexcept{}
+	virtual ~Morda()noexcept;
 
 
 private:
@@ -104,8 +111,41 @@ public:
 	 * Call this function from main loop of the program.
 	 * @return number of milliseconds to sleep before next call.
 	 */
-	std::uint32_t update(){
-		return this->updater.update();
+	std::uint32_t update();
+	
+	/**
+	 * @brief Synchronize updates with frames.
+	 * When frame period is set, all the Updateables which are due within the same frame
+	 * are updated in a single update tick at the beginning of that frame, and the time
+	 * returned by update() is aligned to the frame boundaries. This way the main loop wakes
+	 * up at most once per frame while animating. When nothing is being updated, update()
+	 * still returns infinite wait time.
+	 * @param periodMs - frame period in milliseconds, e.g. 16 for 60 frames per second.
+	 *                   0 disables frame synchronization (default).
+	 */
+	void setFramePeriod(std::uint16_t periodMs)noexcept{
+		this->updater.setFramePeriod(periodMs);
+	}
+	
+	/**
+	 * @brief Align frames with presentation.
+	 * Call this function right after the frame has been presented (e.g. after swapping buffers
+	 * with vertical synchronization enabled), so that the frame boundaries used for updating
+	 * are aligned with the actual frame presentation.
+	 */
+	void syncFrame()noexcept{
+		this->updater.syncFrame();
+	}
+	
+	/**
+	 * @brief Get timestamp of the current frame.
+	 * Animations may use this timestamp for interpolation, it is the same for all
+	 * Updateables updated within one update tick. If frame synchronization is disabled,
+	 * it is the timestamp of the last update tick.
+	 * @return Timestamp of the frame being updated, in milliseconds.
+	 */
+	std::uint32_t frameTimestamp()const noexcept{
+		return this->updater.getFrameTimestamp();
 	}
 	
 	/**
@@ -117,6 +157,107 @@ public:
 	 */
 	virtual void postToUiThread_ts(std::function<void()>&& f) = 0;
 	
+private:
+	UiQueue uiQueue;
+	
+	std::uint32_t uiQueueBudget = 8;
+public:
+	/**
+	 * @brief Execute code on UI thread.
+	 * This function is thread-safe.
+	 * Unlike postToUiThread_ts() which posts each function to the
+	 * program's main loop event queue, this function puts the function to the library's lock-free
+	 * task queue. Tasks from that queue are executed from update() in batches, higher priority tasks first.
+	 * The program's main loop is only woken up (via postToUiThread_ts())
+	 * when the queue becomes non-empty, so worker threads can post many tasks at high rate.
+	 * @param f - function to execute on UI thread.
+	 * @param priority - priority of the task.
+	 */
+	void postToUiQueue_ts(std::function<void()>&& f, UiQueue::Priority_e priority);
+	
+	/**
+	 * @brief Set time budget for executing UI queue tasks.
+	 * Each call to update() executes tasks posted with postToUiQueue_ts()
+	 * until the queue is empty or until the time budget is exhausted. In the latter case update() returns 0
+	 * to continue executing tasks on next main loop cycle.
+	 * @param budgetMs - time budget in milliseconds.
+	 */
+	void setUiQueueBudget(std::uint32_t budgetMs)noexcept{
+		this->uiQueueBudget = budgetMs;
+	}
+	
+private:
+	//set when thread pool is being shut down, so that worker threads do not try to wake up the main loop
+	std::atomic<bool> isDestroying{false};
+	
+	//NOTE: this should go after uiQueue as worker threads may post to it
+	std::unique_ptr<ThreadPool> threadPool_v;
+public:
+	/**
+	 * @brief Get thread pool.
+	 * The thread pool is created on first call to this function.
+	 * The function is not thread-safe.
+	 * @return Thread pool.
+	 */
+	ThreadPool& threadPool();
+	
+	/**
+	 * @brief Stop worker threads.
+	 * Waits for the currently running tasks to finish, tasks which did not start are discarded.
+	 * Worker threads may call postToUiThread_ts(), which is implemented by the
+	 * host class derived from Morda. So, the host class must call this function from its destructor,
+	 * before anything used by its postToUiThread_ts() implementation is destroyed.
+	 * Thread pool cannot be used after this function is called.
+	 * This function is not thread-safe.
+	 */
+	void shutdownThreadPool()noexcept;
+	
+	/**
+	 * @brief Run function on a worker thread.
+	 * The function is executed on one of the worker threads of the thread pool.
+	 * Continuations set on the returned future are executed on UI thread, they are posted to
+	 * UI queue with BACKGROUND priority.
+	 * Not thread-safe when called for the first time, as it creates the thread pool.
+	 * Example:
+	 * @code
+	 * morda::Morda::inst().runAsync([](){
+	 *     return decodeSomething();
+	 * }).then([this](morda::Future<Something> f){
+	 *     try{
+	 *         this->show(f.get());
+	 *     }catch(std::exception& e){
+	 *         //decoding has failed
+	 *     }
+	 * });
+	 * @endcode
+	 * @param f - function to run.
+	 * @return Future of the function result.
+	 */
+	template <class F> Future<typename std::result_of<F()>::type> runAsync(F&& f){
+		typedef typename std::result_of<F()>::type T;
+		
+		auto p = std::make_shared<Promise<T>>(
+				[this](std::function<void()>&& c){
+					this->postToUiQueue_ts(std::move(c), UiQueue::Priority_e::BACKGROUND);
+				}
+			);
+		
+		auto ret = p->future();
+		
+		typename std::decay<F>::type func(std::forward<F>(f));
+		
+		this->threadPool().run_ts(
+				[p, func]() mutable{
+					if(p->isCanceled()){
+						return;
+					}
+					p->setResultOf(func);
+				}
+			);
+		
+		return ret;
+	}
+	
 	/**
 	 * @brief Feed in the mouse move event to GUI.
 	 * @param pos - new position of the mouse pointer.
@@ -124,6 +265,63 @@ public:
 	 */
 	void onMouseMove(const Vec2r& pos, unsigned id);
 	
+private:
+	bool coalesceMouseMoves_v = true;
+	
+	//pending mouse move positions per pointer ID, oldest first
+	std::map<unsigned, std::vector<Vec2r>> pendingMouseMoves;
+	
+	std::vector<Vec2r> mouseMoveHistory_v;
+	
+	void dispatchMouseMove(const Vec2r& pos, unsigned id);
+public:
+	/**
+	 * @brief Maximum number of coalesced mouse move positions kept per pointer.
+	 * When more mouse move events come between two update ticks, the oldest positions are dropped.
+	 */
+	static const size_t maxMouseMoveHistory_c = 64;
+	
+	/**
+	 * @brief Enable or disable mouse move events coalescing.
+	 * When enabled (default), mouse move events fed in with onMouseMove() are queued
+	 * and consecutive moves of the same pointer are dispatched to the widgets hierarchy
+	 * only once per update tick, with the latest position.
+	 * When disabled, every mouse move event is dispatched immediately.
+	 * @param coalesce - whether to coalesce mouse move events.
+	 */
+	void setCoalesceMouseMoves(bool coalesce);
+	
+	/**
+	 * @brief Check if mouse move events are coalesced.
+	 * @return true if mouse move events are coalesced.
+	 * @return false otherwise.
+	 */
+	bool isCoalescingMouseMoves()const noexcept{
+		return this->coalesceMouseMoves_v;
+	}
+	
+	/**
+	 * @brief Dispatch queued mouse move events.
+	 * This function is called automatically from update() and before dispatching any other
+	 * input events, i.e. mouse button, hover, key and character input events. Call it before rendering if rendering is done
+	 * after feeding in the input events, but before calling update().
+	 */
+	void flushMouseMoves();
+	
+	/**
+	 * @brief Get history of coalesced mouse moves.
+	 * Widgets which need all the intermediate pointer positions (e.g. for drawing)
+	 * can call this function from within their Widget::onMouseMove() handler.
+	 * Positions are in GUI viewport coordinates, oldest first. The last position is the one
+	 * which is being dispatched, so the offset to the widget's local coordinates is the
+	 * difference between the last position and the position passed to the handler.
+	 * @return Positions of the mouse pointer since previous dispatched move event.
+	 *         Empty vector if called not from within mouse move event dispatching.
+	 */
+	const std::vector<Vec2r>& mouseMoveHistory()const noexcept{
+		return this->mouseMoveHistory_v;
+	}
+	
 	/**
 	 * @brief Feed in the mouse button event to GUI.
 	 * @param isDown - is mouse button pressed (true) or released (false).
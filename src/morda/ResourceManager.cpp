@@ -1,8 +1,7 @@
-#include <papki/RootDirFile.hpp>
-
 #include "ResourceManager.hpp"
 
 #include "util/util.hpp"
+#include "util/RootDirFile.hpp"
 
 
 
@@ -59,7 +58,7 @@ void ResourceManager::mountResPack(const papki::File& fi){
 	}
 	
 	ResPackEntry rpe;
-	rpe.fi = papki::RootDirFile::makeUniqueConst(fi.spawn(), dir);
+	rpe.fi = utki::makeUnique<RootDirFile>(fi.spawn(), dir);
 	rpe.resScript = resScript->chopNext();
 
 	this->resPacks.push_back(std::move(rpe));
@@ -0,0 +1,215 @@
+#include "ThreadPool.hpp"
+
+#include <exception>
+#include <algorithm>
+
+#include <utki/debug.hpp>
+
+
+using namespace morda;
+
+
+
+namespace{
+//thread pool and worker index of the current thread, if it is a worker thread
+thread_local const ThreadPool* curPool = nullptr;
+thread_local unsigned curWorker = 0;
+}
+
+
+
+ThreadPool::ThreadPool(unsigned numThreads) :
+		numQueued(0),
+		quitFlag(false),
+		nextWorker(0)
+{
+	if(numThreads == 0){
+		//leave one hardware thread for UI thread
+		unsigned n = std::thread::hardware_concurrency();
+		numThreads = n > 2 ? n - 1 : 1;
+	}
+	
+	for(unsigned i = 0; i != numThreads; ++i){
+		this->workers.push_back(std::unique_ptr<Worker>(new Worker()));
+	}
+	
+	//start threads after all workers are created, as workers access each other's queues
+	for(unsigned i = 0; i != numThreads; ++i){
+		this->workers[i]->thread = std::thread(
+				[this, i](){
+					this->run(i);
+				}
+			);
+	}
+}
+
+
+
+ThreadPool::~ThreadPool()noexcept{
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+		this->quitFlag.store(true);
+	}
+	this->sleepCv.notify_all();
+	
+	for(auto& w : this->workers){
+		w->thread.join();
+	}
+}
+
+
+
+void ThreadPool::run_ts(std::function<void()>&& task){
+	ASSERT(this->workers.size() != 0)
+	
+	unsigned index;
+	if(curPool == this){
+		index = curWorker;
+	}else{
+		index = this->nextWorker.fetch_add(1, std::memory_order_relaxed) % this->workers.size();
+	}
+	
+	//Increment under the mutex so that sleeping workers do not miss the notification.
+	//Increment before pushing the task, so that the worker which takes the task never decrements the counter below zero.
+	{
+		std::lock_guard<std::mutex> sleepLock(this->sleepMutex);
+		++this->numQueued;
+		
+		auto& w = *this->workers[index];
+		std::lock_guard<std::mutex> lock(w.mutex);
+		w.tasks.push_back(std::move(task));
+	}
+	this->sleepCv.notify_one();
+}
+
+
+
+void ThreadPool::parallelFor(size_t num, const std::function<void(size_t)>& f){
+	if(num == 0){
+		return;
+	}
+	
+	//helper tasks may start after all indices are processed and parallelFor() has returned, so the state is shared
+	struct State{
+		std::atomic<size_t> next{0};
+		
+		std::mutex mutex;
+		std::condition_variable cv;
+		size_t numDone = 0;
+		std::exception_ptr exception;
+		
+		const std::function<void(size_t)>* f;
+		size_t num;
+	};
+	
+	auto s = std::make_shared<State>();
+	s->f = &f;
+	s->num = num;
+	
+	auto work = [s](){
+		size_t numDone = 0;
+		std::exception_ptr exception;
+		
+		for(size_t i; (i = s->next.fetch_add(1)) < s->num;){
+			try{
+				(*s->f)(i);
+			}catch(...){
+				if(!exception){
+					exception = std::current_exception();
+				}
+			}
+			++numDone;
+		}
+		
+		//the function is not accessed if no index was taken, because parallelFor() might have already returned
+		if(numDone == 0){
+			return;
+		}
+		
+		std::lock_guard<std::mutex> lock(s->mutex);
+		if(exception && !s->exception){
+			s->exception = exception;
+		}
+		s->numDone += numDone;
+		if(s->numDone == s->num){
+			s->cv.notify_all();
+		}
+	};
+	
+	//calling thread also processes indices
+	for(size_t i = 0, n = std::min(this->workers.size(), num - 1); i != n; ++i){
+		this->run_ts(work);
+	}
+	
+	work();
+	
+	std::unique_lock<std::mutex> lock(s->mutex);
+	s->cv.wait(
+			lock,
+			[&s](){
+				return s->numDone == s->num;
+			}
+		);
+	
+	if(s->exception){
+		std::rethrow_exception(s->exception);
+	}
+}
+
+
+
+bool ThreadPool::takeTask(unsigned workerIndex, std::function<void()>& task){
+	//own queue, newest first
+	{
+		auto& w = *this->workers[workerIndex];
+		std::lock_guard<std::mutex> lock(w.mutex);
+		if(w.tasks.size() != 0){
+			task = std::move(w.tasks.back());
+			w.tasks.pop_back();
+			return true;
+		}
+	}
+	
+	//steal from others, oldest first
+	for(size_t i = 1; i != this->workers.size(); ++i){
+		auto& w = *this->workers[(workerIndex + i) % this->workers.size()];
+		std::lock_guard<std::mutex> lock(w.mutex);
+		if(w.tasks.size() != 0){
+			task = std::move(w.tasks.front());
+			w.tasks.pop_front();
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+
+void ThreadPool::run(unsigned workerIndex){
+	curPool = this;
+	curWorker = workerIndex;
+	
+	while(!this->quitFlag.load()){
+		std::function<void()> task;
+		if(this->takeTask(workerIndex, task)){
+			--this->numQueued;
+			try{
+				task();
+			}catch(std::exception& e){
+				TRACE(<< "ThreadPool: uncaught exception in task: " << e.what() << std::endl)
+			}catch(...){
+				TRACE(<< "ThreadPool: uncaught exception in task" << std::endl)
+			}
+			continue;
+		}
+		
+		std::unique_lock<std::mutex> lock(this->sleepMutex);
+		this->sleepCv.wait(
+				lock,
+				[this](){
+					return this->quitFlag.load() || this->numQueued.load() != 0;
+				}
+			);
+	}
+}
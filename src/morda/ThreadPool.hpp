@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace morda{
+
+/**
+ * @brief Pool of worker threads.
+ * Each worker thread has its own queue of tasks. Tasks posted from a worker thread go to the queue
+ * of that worker, tasks posted from other threads are distributed among workers in round-robin manner.
+ * Workers take tasks from their own queue in LIFO order and, when it is empty, steal tasks in FIFO order
+ * from the queues of other workers.
+ */
+class ThreadPool{
+	struct Worker{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+		std::thread thread;
+	};
+	
+	std::vector<std::unique_ptr<Worker>> workers;
+	
+	std::mutex sleepMutex;
+	std::condition_variable sleepCv;
+	
+	//number of tasks in all queues
+	std::atomic<size_t> numQueued;
+	
+	std::atomic<bool> quitFlag;
+	
+	std::atomic<unsigned> nextWorker;
+	
+	bool takeTask(unsigned workerIndex, std::function<void()>& task);
+	
+	void run(unsigned workerIndex);
+	
+public:
+	/**
+	 * @brief Constructor.
+	 * @param numThreads - number of worker threads. If 0, then the number is chosen based on the number of hardware threads.
+	 */
+	explicit ThreadPool(unsigned numThreads = 0);
+	
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	
+	/**
+	 * @brief Destructor.
+	 * Waits for currently running tasks to finish. Tasks which did not start are discarded.
+	 */
+	~ThreadPool()noexcept;
+	
+	/**
+	 * @brief Post task for execution on one of the worker threads.
+	 * This function is thread-safe.
+	 * @param task - task to execute.
+	 */
+	void run_ts(std::function<void()>&& task);
+	
+	/**
+	 * @brief Call function for each index of a range in parallel.
+	 * Indices are processed by worker threads and by the calling thread, the function returns when all indices are processed.
+	 * Since the calling thread takes part in the processing, it is ok to call this function from a worker thread of the same pool.
+	 * If the function throws, the first thrown exception is re-thrown after all indices are processed.
+	 * @param num - number of indices, the function is called for each index from 0 to num - 1.
+	 * @param f - function to call.
+	 */
+	void parallelFor(size_t num, const std::function<void(size_t)>& f);
+	
+	/**
+	 * @brief Get number of worker threads.
+	 * @return Number of worker threads.
+	 */
+	size_t size()const noexcept{
+		return this->workers.size();
+	}
+};
+
+}
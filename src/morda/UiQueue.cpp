@@ -0,0 +1,132 @@
+#include "UiQueue.hpp"
+
+#include <chrono>
+#include <memory>
+
+
+using namespace morda;
+
+
+
+UiQueue::Queue::Queue() :
+		head(&stub),
+		tail(&stub)
+{
+	this->stub.next.store(nullptr, std::memory_order_relaxed);
+}
+
+
+
+UiQueue::Queue::~Queue()noexcept{
+	while(auto n = this->pop()){
+		delete n;
+	}
+}
+
+
+
+void UiQueue::Queue::push(Node* n)noexcept{
+	n->next.store(nullptr, std::memory_order_relaxed);
+	Node* prev = this->head.exchange(n, std::memory_order_acq_rel);
+	//here the queue is inconsistent until the previous node is linked to the new one
+	prev->next.store(n, std::memory_order_release);
+}
+
+
+
+void UiQueue::Queue::push_ts(std::function<void()>&& f){
+	Node* n = new Node();
+	n->f = std::move(f);
+	this->push(n);
+}
+
+
+
+UiQueue::Node* UiQueue::Queue::pop()noexcept{
+	Node* tail = this->tail;
+	Node* next = tail->next.load(std::memory_order_acquire);
+	
+	if(tail == &this->stub){
+		if(!next){
+			return nullptr;
+		}
+		this->tail = next;
+		tail = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+	
+	if(next){
+		this->tail = next;
+		return tail;
+	}
+	
+	if(tail != this->head.load(std::memory_order_acquire)){
+		//some producer is in the middle of pushing
+		return nullptr;
+	}
+	
+	//the last node cannot be popped while it is the head, so put the stub after it
+	this->push(&this->stub);
+	
+	next = tail->next.load(std::memory_order_acquire);
+	if(next){
+		this->tail = next;
+		return tail;
+	}
+	
+	return nullptr;
+}
+
+
+
+UiQueue::UiQueue() :
+		numTasks(0)
+{}
+
+
+
+bool UiQueue::push_ts(std::function<void()>&& f, Priority_e priority){
+	ASSERT(priority < Priority_e::ENUM_SIZE)
+	
+	this->queues[size_t(priority)].push_ts(std::move(f));
+	
+	return this->numTasks.fetch_add(1, std::memory_order_acq_rel) == 0;
+}
+
+
+
+size_t UiQueue::drain(std::uint32_t budgetMs){
+	typedef std::chrono::steady_clock Clock;
+	
+	const auto deadline = Clock::now() + std::chrono::milliseconds(budgetMs);
+	
+	size_t numExecuted = 0;
+	
+	while(this->size_ts() != 0){
+		Node* n = nullptr;
+		for(auto& q : this->queues){
+			if((n = q.pop())){
+				break;
+			}
+		}
+		
+		if(!n){
+			//some producers are in the middle of pushing
+			break;
+		}
+		
+		std::unique_ptr<Node> node(n);
+		
+		this->numTasks.fetch_sub(1, std::memory_order_acq_rel);
+		
+		++numExecuted;
+		
+		node->f();
+		
+		if(Clock::now() >= deadline){
+			break;
+		}
+	}
+	
+	return numExecuted;
+}
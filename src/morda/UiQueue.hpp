@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <functional>
+#include <cstdint>
+
+#include <utki/debug.hpp>
+
+
+namespace morda{
+
+/**
+ * @brief Queue of tasks to be executed on UI thread.
+ * Multiple-producers-single-consumer lock-free queue. Any thread can post tasks to the queue,
+ * while only UI thread executes them. Each priority has its own queue, tasks of higher priority
+ * are always executed before tasks of lower priority. Tasks of the same priority are executed
+ * in the order they were posted.
+ */
+class UiQueue{
+public:
+	/**
+	 * @brief Task priority.
+	 */
+	enum class Priority_e{
+		/**
+		 * @brief Handling of user input.
+		 */
+		INPUT,
+		
+		/**
+		 * @brief Changes to widgets hierarchy and layout.
+		 */
+		LAYOUT,
+		
+		/**
+		 * @brief Results of background work.
+		 */
+		BACKGROUND,
+		
+		ENUM_SIZE
+	};
+	
+private:
+	struct Node{
+		std::atomic<Node*> next;
+		std::function<void()> f;
+	};
+	
+	//Intrusive MPSC queue by Dmitry Vyukov.
+	class Queue{
+		std::atomic<Node*> head;
+		Node* tail;
+		Node stub;
+		
+		void push(Node* n)noexcept;
+	public:
+		Queue();
+		
+		Queue(const Queue&) = delete;
+		Queue& operator=(const Queue&) = delete;
+		
+		~Queue()noexcept;
+		
+		void push_ts(std::function<void()>&& f);
+		
+		//returns nullptr if queue is empty or if some producer has not finished pushing yet
+		Node* pop()noexcept;
+	};
+	
+	std::array<Queue, size_t(Priority_e::ENUM_SIZE)> queues;
+	
+	std::atomic<size_t> numTasks;
+	
+public:
+	UiQueue();
+	
+	UiQueue(const UiQueue&) = delete;
+	UiQueue& operator=(const UiQueue&) = delete;
+	
+	/**
+	 * @brief Post task to the queue.
+	 * This function is thread-safe.
+	 * @param f - task to post.
+	 * @param priority - priority of the task.
+	 * @return true if the queue was empty before the task was posted, i.e. the UI thread needs to be woken up.
+	 * @return false otherwise.
+	 */
+	bool push_ts(std::function<void()>&& f, Priority_e priority);
+	
+	/**
+	 * @brief Get number of tasks in the queue.
+	 * This function is thread-safe.
+	 * @return Number of tasks posted and not yet executed.
+	 */
+	size_t size_ts()const noexcept{
+		return this->numTasks.load(std::memory_order_acquire);
+	}
+	
+	/**
+	 * @brief Execute tasks from the queue.
+	 * Executes tasks in the order of priority until the queue is empty or until the time budget is exhausted.
+	 * At least one task is executed if the queue is not empty.
+	 * Should only be called from UI thread.
+	 * @param budgetMs - time budget in milliseconds.
+	 * @return Number of executed tasks.
+	 */
+	size_t drain(std::uint32_t budgetMs);
+};
+
+}
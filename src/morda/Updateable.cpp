@@ -16,71 +16,201 @@ std::uint32_t getTicks(){
 }
 
 
-Updateable::Updater::UpdateQueue::iterator Updateable::Updater::UpdateQueue::insertPair(const T_Pair& p){
-	if(this->size() == 0 || this->back().first <= p.first){
-		this->push_back(p);
-		return --(this->end());
-	}
+void Updateable::Updater::UpdateQueue::siftUp(size_t index)noexcept{
+	Entry e = this->heap[index];
 	
-	//otherwise, go from the beginning
-	for(auto i = this->begin(); i != this->end(); ++i){
-		if(i->first >= p.first){
-			return this->insert(i, p); //inserts before iterator
+	while(index != 0){
+		size_t parent = (index - 1) / 2;
+		if(this->heap[parent].endAt <= e.endAt){
+			break;
 		}
+		this->place(index, this->heap[parent]);
+		index = parent;
 	}
 	
-	ASSERT(false)
-	return this->end();
+	this->place(index, e);
 }
 
 
 
-void Updateable::Updater::addPending(){
-	while(this->toAdd.size() != 0){
-		T_Pair p;
-		
-		p.first = this->toAdd.front()->endAt();
-		p.second = this->toAdd.front();
-		
-		if(p.first < this->lastUpdatedTimestamp){
-//			TRACE(<< "Updateable::Updater::AddPending(): inserted to inactive queue" << std::endl)
-			this->toAdd.front()->queue = this->inactiveQueue;
-			this->toAdd.front()->iter = this->inactiveQueue->insertPair(p);
-		}else{
-//			TRACE(<< "Updateable::Updater::AddPending(): inserted to active queue" << std::endl)
-			this->toAdd.front()->queue = this->activeQueue;
-			this->toAdd.front()->iter = this->activeQueue->insertPair(p);
+void Updateable::Updater::UpdateQueue::siftDown(size_t index)noexcept{
+	Entry e = this->heap[index];
+	
+	for(;;){
+		size_t child = index * 2 + 1;
+		if(child >= this->heap.size()){
+			break;
 		}
-		
-		this->toAdd.front()->pendingAddition = false;
-		
-		this->toAdd.pop_front();
+		if(child + 1 < this->heap.size() && this->heap[child + 1].endAt < this->heap[child].endAt){
+			++child;
+		}
+		if(e.endAt <= this->heap[child].endAt){
+			break;
+		}
+		this->place(index, this->heap[child]);
+		index = child;
 	}
+	
+	this->place(index, e);
 }
 
 
 
-void Updateable::Updater::updateUpdateable(const std::shared_ptr<morda::Updateable>& u){
-	//if weak ref gave invalid strong ref
-	if(!u){
+void Updateable::Updater::UpdateQueue::insert(Updateable* u){
+	ASSERT(u)
+	ASSERT(!u->queue)
+	
+	Entry e;
+	e.endAt = u->endAt();
+	e.u = u;
+	
+	this->heap.push_back(e);
+	u->queue = this;
+	this->siftUp(this->heap.size() - 1);
+}
+
+
+
+void Updateable::Updater::UpdateQueue::erase(Updateable* u)noexcept{
+	ASSERT(u->queue == this)
+	ASSERT(u->queueIndex < this->heap.size())
+	ASSERT(this->heap[u->queueIndex].u == u)
+	
+	size_t index = u->queueIndex;
+	u->queue = nullptr;
+	
+	Entry last = this->heap.back();
+	this->heap.pop_back();
+	
+	if(index == this->heap.size()){
 		return;
 	}
 	
-	//at this point updateable is removed from update queue, so set it to 0
-	u->queue = 0;
+	this->place(index, last);
 	
-	u->update(this->lastUpdatedTimestamp - u->startedAt);
+	if(index != 0 && this->heap[(index - 1) / 2].endAt > last.endAt){
+		this->siftUp(index);
+	}else{
+		this->siftDown(index);
+	}
+}
+
+
+
+Updateable* Updateable::Updater::UpdateQueue::popFront()noexcept{
+	ASSERT(this->size() != 0)
+	Updateable* ret = this->heap.front().u;
+	this->erase(ret);
+	return ret;
+}
+
+
+
+void Updateable::Updater::UpdateQueue::detachAll()noexcept{
+	for(auto& e : this->heap){
+		e.u->queue = nullptr;
+	}
+	this->heap.clear();
+}
+
+
+
+Updateable::Updater::~Updater()noexcept{
+	this->q1.detachAll();
+	this->q2.detachAll();
 	
-	//if not stopped during update, add it back
-	if(u->isUpdating()){
-		u->startedAt = this->lastUpdatedTimestamp;
-		u->pendingAddition = true;
-		this->toAdd.push_back(u);
+	for(auto u : this->toAdd){
+		u->pendingAddition = false;
 	}
 }
 
 
 
+void Updateable::Updater::addToQueue(Updateable* u){
+	//updateables are never started before the current frame, so if it ends before, then its end time has warped around
+	if(u->endAt() < this->frameTimestamp){
+//		TRACE(<< "Updateable::Updater::addToQueue(): inserted to inactive queue" << std::endl)
+		this->inactiveQueue->insert(u);
+	}else{
+//		TRACE(<< "Updateable::Updater::addToQueue(): inserted to active queue" << std::endl)
+		this->activeQueue->insert(u);
+	}
+}
+
+
+
+void Updateable::Updater::add(Updateable* u){
+	ASSERT(!u->queue)
+	ASSERT(!u->pendingAddition)
+	
+	//If the updateable is due not later than the last update tick, then it could be updated again
+	//from within the same update round (e.g. zero update period) or its end time has warped around.
+	//Defer such updateables till the next update() call.
+	if(u->endAt() > this->lastDueTimestamp){
+		this->activeQueue->insert(u);
+		return;
+	}
+	
+	u->pendingAddition = true;
+	u->queueIndex = this->toAdd.size();
+	this->toAdd.push_back(u);
+}
+
+
+
+void Updateable::Updater::addPending(){
+	for(auto u : this->toAdd){
+		ASSERT(u->pendingAddition)
+		u->pendingAddition = false;
+		this->addToQueue(u);
+	}
+	this->toAdd.clear();
+}
+
+
+
+void Updateable::Updater::updateUpdateable(Updateable* u){
+	ASSERT(u)
+	ASSERT(!u->queue) //at this point updateable is removed from update queue
+	
+	//make sure the updateable is not destroyed while updating
+	auto guard = u->sharedFromThis(u);
+	
+	//updateable could have been started after the beginning of the current frame
+	std::uint32_t dt = this->frameTimestamp - u->startedAt;
+	u->update(std::int32_t(dt) > 0 ? dt : 0);
+	
+	//if not stopped during update and not re-started, add it back
+	if(u->isUpdating() && !u->queue && !u->pendingAddition){
+		u->startedAt = this->frameTimestamp;
+		this->add(u);
+	}
+}
+
+
+
+std::uint32_t Updateable::Updater::frameStart(std::uint32_t timestamp)const noexcept{
+	if(this->framePeriod == 0){
+		return timestamp;
+	}
+	return timestamp - (timestamp - this->frameOrigin) % this->framePeriod;
+}
+
+
+
+void Updateable::Updater::setFramePeriod(std::uint16_t periodMs)noexcept{
+	this->framePeriod = periodMs;
+	this->syncFrame();
+}
+
+
+
+void Updateable::Updater::syncFrame()noexcept{
+	this->frameOrigin = getTicks();
+}
+
+
+
 std::uint32_t Updateable::Updater::update(){
 	std::uint32_t curTime = getTicks();
 	
@@ -88,6 +218,19 @@ std::uint32_t Updateable::Updater::update(){
 	
 	this->addPending();//add pending before updating this->lastUpdatedTimestamp
 	
+	this->frameTimestamp = this->frameStart(curTime);
+	
+	//with frame synchronization update everything which is due before the end of the current frame
+	if(this->framePeriod == 0){
+		this->lastDueTimestamp = curTime;
+	}else{
+		this->lastDueTimestamp = this->frameTimestamp + std::uint32_t(this->framePeriod - 1);
+		if(this->lastDueTimestamp < curTime){
+			//end of the frame warps around
+			this->lastDueTimestamp = curTime;
+		}
+	}
+	
 	//check if there is a warp around
 	if(curTime < this->lastUpdatedTimestamp){
 		this->lastUpdatedTimestamp = curTime;
@@ -95,11 +238,12 @@ std::uint32_t Updateable::Updater::update(){
 //		TRACE(<< "Updateable::Updater::Update(): time has warped, this->activeQueue->Size() = " << this->activeQueue->size() << std::endl)
 		
 		//if time has warped, then all Updateables from active queue have expired.
-		while(this->activeQueue->size() != 0){
-			this->updateUpdateable(this->activeQueue->popFront());
-		}
-		
 		std::swap(this->activeQueue, this->inactiveQueue);
+		
+		//updateables which are added back during this loop go to the new active queue or to the pending list
+		while(this->inactiveQueue->size() != 0){
+			this->updateUpdateable(this->inactiveQueue->popFront());
+		}
 	}else{
 		this->lastUpdatedTimestamp = curTime;
 	}
@@ -107,8 +251,9 @@ std::uint32_t Updateable::Updater::update(){
 	
 //	TRACE(<< "Updateable::Updater::Update(): this->activeQueue->Size() = " << this->activeQueue->size() << std::endl)
 	
+	//updateables added back during this loop are due strictly after lastDueTimestamp, so the loop always terminates
 	while(this->activeQueue->size() != 0){
-		if(this->activeQueue->front().first > curTime){
+		if(this->activeQueue->frontTime() > this->lastDueTimestamp){
 			break;
 		}
 		this->updateUpdateable(this->activeQueue->popFront());
@@ -120,11 +265,19 @@ std::uint32_t Updateable::Updater::update(){
 	
 	std::uint32_t closestTime;
 	if(this->activeQueue->size() != 0){
-		ASSERT(curTime <= this->activeQueue->front().first)
-		closestTime = this->activeQueue->front().first;
+		closestTime = this->activeQueue->frontTime();
+		if(this->framePeriod != 0){
+			if(closestTime <= this->lastDueTimestamp){
+				//was deferred during this round, update on next frame
+				closestTime = this->lastDueTimestamp + 1;
+			}else{
+				closestTime = this->frameStart(closestTime);
+			}
+		}
+		ASSERT(curTime <= closestTime)
 	}else if(this->inactiveQueue->size() != 0){
-		ASSERT(curTime > this->inactiveQueue->front().first)
-		closestTime = this->inactiveQueue->front().first;
+		ASSERT(curTime > this->inactiveQueue->frontTime())
+		closestTime = this->inactiveQueue->frontTime();
 	}else{
 		return std::uint32_t(-1);
 	}
@@ -148,16 +301,24 @@ std::uint32_t Updateable::Updater::update(){
 
 
 
-void Updateable::Updater::removeFromToAdd(Updateable* u){
+void Updateable::Updater::removeFromToAdd(Updateable* u)noexcept{
 	ASSERT(u->pendingAddition)
-	for(T_ToAddList::iterator i = this->toAdd.begin(); i != this->toAdd.end(); ++i){
-		if((*i).operator->() == u){
-			ASSERT((*i)->pendingAddition)
-			u->pendingAddition = false;
-			this->toAdd.erase(i);
-			return;
-		}
-	}
+	ASSERT(u->queueIndex < this->toAdd.size())
+	ASSERT(this->toAdd[u->queueIndex] == u)
+	
+	//swap with the last one and pop
+	auto last = this->toAdd.back();
+	this->toAdd[u->queueIndex] = last;
+	last->queueIndex = u->queueIndex;
+	this->toAdd.pop_back();
+	
+	u->pendingAddition = false;
+}
+
+
+
+Updateable::~Updateable()noexcept{
+	this->stopUpdating();
 }
 
 
@@ -175,9 +336,7 @@ void Updateable::startUpdating(std::uint16_t dtMs){
 	this->startedAt = getTicks();
 	this->isUpdating_v = true;
 	
-	this->pendingAddition = true;
-	
-	Morda::inst().updater.toAdd.push_front(this->sharedFromThis(this));
+	Morda::inst().updater.add(this);
 }
 
 
@@ -186,8 +345,8 @@ void Updateable::stopUpdating()noexcept{
 //	ASSERT(App::inst().thisIsUIThread())
 	
 	if(this->queue){
-		this->queue->erase(this->iter);
-		this->queue = 0;
+		this->queue->erase(this);
+		ASSERT(!this->queue)
 	}else if(this->pendingAddition){
 		Morda::inst().updater.removeFromToAdd(this);
 	}
@@ -1,9 +1,10 @@
 #pragma once
 
 #include <cstdint>
-#include <list>
+#include <vector>
 
 #include <utki/Shared.hpp>
+#include <utki/debug.hpp>
 
 #include "Exc.hpp"
 
@@ -25,17 +26,39 @@ private:
 	class Updater{
 		friend class morda::Updateable;
 		
-		typedef std::pair<std::uint32_t, std::weak_ptr<morda::Updateable>> T_Pair;
-		
-		class UpdateQueue : public std::list<T_Pair>{
+		//binary min-heap of updateables ordered by the time they should be updated at
+		class UpdateQueue{
+			struct Entry{
+				std::uint32_t endAt;
+				Updateable* u;
+			};
+			
+			std::vector<Entry> heap;
+			
+			void place(size_t index, const Entry& e)noexcept{
+				this->heap[index] = e;
+				e.u->queueIndex = index;
+			}
+			
+			void siftUp(size_t index)noexcept;
+			void siftDown(size_t index)noexcept;
 		public:
-			UpdateQueue::iterator insertPair(const T_Pair& p);
-
-			std::shared_ptr<morda::Updateable> popFront(){
-				auto ret = this->front().second.lock();
-				this->pop_front();
-				return ret;
+			size_t size()const noexcept{
+				return this->heap.size();
+			}
+			
+			std::uint32_t frontTime()const noexcept{
+				ASSERT(this->size() != 0)
+				return this->heap.front().endAt;
 			}
+			
+			void insert(Updateable* u);
+			
+			void erase(Updateable* u)noexcept;
+			
+			Updateable* popFront()noexcept;
+			
+			void detachAll()noexcept;
 		};
 		
 		UpdateQueue q1, q2;
@@ -44,19 +67,46 @@ private:
 		
 		std::uint32_t lastUpdatedTimestamp = 0;
 		
-		typedef std::list<std::shared_ptr<morda::Updateable> > T_ToAddList;
-		T_ToAddList toAdd;
+		//everything due not later than this timestamp has been updated during last update round
+		std::uint32_t lastDueTimestamp = 0;
+		
+		//frame synchronization, 0 period means no synchronization
+		std::uint16_t framePeriod = 0;
+		std::uint32_t frameOrigin = 0;
+		std::uint32_t frameTimestamp = 0;
+		
+		std::uint32_t frameStart(std::uint32_t timestamp)const noexcept;
+		
+		//updateables which are to be added to one of the queues on next update, each stores its index in this vector
+		std::vector<Updateable*> toAdd;
 		
 		void addPending();
 		
-		void updateUpdateable(const std::shared_ptr<morda::Updateable>& u);
+		void addToQueue(Updateable* u);
+		
+		void add(Updateable* u);
+		
+		void updateUpdateable(Updateable* u);
 	public:
 		Updater() :
 				activeQueue(&q1),
 				inactiveQueue(&q2)
 		{}
 		
-		void removeFromToAdd(Updateable* u);
+		Updater(const Updater&) = delete;
+		Updater& operator=(const Updater&) = delete;
+		
+		~Updater()noexcept;
+		
+		void removeFromToAdd(Updateable* u)noexcept;
+		
+		void setFramePeriod(std::uint16_t periodMs)noexcept;
+		
+		void syncFrame()noexcept;
+		
+		std::uint32_t getFrameTimestamp()const noexcept{
+			return this->frameTimestamp;
+		}
 		
 		//returns dt to wait before next update
 		std::uint32_t update();
@@ -76,7 +126,8 @@ private:
 	//pointer to the queue the updateable is inserted into
 	Updater::UpdateQueue* queue = nullptr;
 	
-	Updater::UpdateQueue::iterator iter; //iterator into the queue.
+	//index in the queue heap, or in the Updater::toAdd vector if pending addition
+	size_t queueIndex;
 	
 	bool pendingAddition = false;
 	
@@ -91,6 +142,8 @@ public:
 		{}
 	};
 	
+	virtual ~Updateable()noexcept;
+	
 	/**
 	 * @brief Check if the object is currently subscribed for updates.
 	 * @return true if object is subscribed for updates.
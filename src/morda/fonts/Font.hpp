@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <array>
+#include <memory>
 
 #include <utki/Buf.hpp>
 #include <unikod/utf8.hpp>
@@ -10,6 +12,8 @@
 
 #include "../config.hpp"
 
+#include "../render/Texture2D.hpp"
+
 namespace morda{
 
 /**
@@ -140,6 +144,41 @@ public:
 	virtual real charAdvance(char32_t c)const = 0;
 	
 	
+	/**
+	 * @brief Get kerning of a pair of characters.
+	 * @param left - left character of the pair.
+	 * @param right - right character of the pair.
+	 * @return Correction of the advance between the two characters, usually negative or zero.
+	 */
+	virtual real kerning(char32_t left, char32_t right)const{
+		return 0;
+	}
+	
+	
+	/**
+	 * @brief Get glyph quad.
+	 * Fonts which draw all glyphs as textured quads from a single texture report the glyph quads,
+	 * so that text can be put to a single batched mesh instead of being rendered glyph by glyph.
+	 * @param c - character to get the glyph quad for.
+	 * @param verts - output quad vertices, relative to the glyph origin on the baseline.
+	 * @param texCoords - output texture coordinates of the quad vertices.
+	 * @return true if glyph quad is reported.
+	 * @return false if the font does not draw glyphs as textured quads. Output arguments are not changed then.
+	 */
+	virtual bool glyphQuad(char32_t c, std::array<kolme::Vec2f, 4>& verts, std::array<kolme::Vec2f, 4>& texCoords)const{
+		return false;
+	}
+	
+	/**
+	 * @brief Get texture of glyph quads.
+	 * @return Texture the glyph quads refer to.
+	 * @return nullptr if the font does not draw glyphs as textured quads.
+	 */
+	virtual std::shared_ptr<Texture2D> texture()const{
+		return nullptr;
+	}
+	
+	
 	/**
 	 * @brief Get bounding box of the string.
 	 * @param str - string of text to get the bounding box for.
@@ -0,0 +1,334 @@
+#include "Paragraph.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+
+#include "../Morda.hpp"
+#include "../util/util.hpp"
+
+
+using namespace morda;
+
+
+
+namespace{
+bool isSpace(char32_t c){
+	return c == ' ' || c == '\t';
+}
+
+//maximum number of quads which can be addressed by 16 bit indices
+const size_t maxQuadsPerBatch_c = 0x10000 / 4;
+}
+
+
+
+void Paragraph::setRuns(std::vector<Run>&& runs){
+	this->runs_v = std::move(runs);
+	
+	this->chars.clear();
+	this->runBegins.clear();
+	this->offsets.clear();
+	this->words.clear();
+	this->layouts.clear();
+	this->meshValid = false;
+	
+	this->offsets.push_back(0);
+	
+	for(auto& r : this->runs_v){
+		ASSERT(r.font)
+		this->runBegins.push_back(this->chars.size());
+		this->chars.append(r.text);
+		
+		for(auto i = r.text.begin(); i != r.text.end(); ++i){
+			if(*i == '\n'){
+				this->offsets.push_back(this->offsets.back());
+				continue;
+			}
+			real a = r.font->charAdvance(*i);
+			if(i + 1 != r.text.end()){
+				a += r.font->kerning(*i, *(i + 1));
+			}
+			this->offsets.push_back(this->offsets.back() + a);
+		}
+	}
+	this->runBegins.push_back(this->chars.size());
+	
+	for(size_t i = 0; i != this->chars.size();){
+		Word w;
+		w.begin = i;
+		for(; i != this->chars.size() && !isSpace(this->chars[i]) && this->chars[i] != '\n'; ++i){}
+		w.end = i;
+		for(; i != this->chars.size() && isSpace(this->chars[i]); ++i){}
+		w.lineBreak = i != this->chars.size() && this->chars[i] == '\n';
+		if(w.lineBreak){
+			++i;
+		}
+		w.next = i;
+		this->words.push_back(w);
+	}
+}
+
+
+
+void Paragraph::setColor(size_t run, std::uint32_t color){
+	ASSERT(run < this->runs_v.size())
+	if(this->runs_v[run].color == color){
+		return;
+	}
+	this->runs_v[run].color = color;
+	this->meshValid = false;
+}
+
+
+
+size_t Paragraph::runOf(size_t index)const noexcept{
+	ASSERT(this->runBegins.size() != 0)
+	ASSERT(this->runs_v.size() != 0)
+	
+	//last run starting at or before the index, this skips empty runs
+	auto i = std::upper_bound(this->runBegins.begin(), this->runBegins.end(), index);
+	ASSERT(i != this->runBegins.begin())
+	--i;
+	
+	//index past the end of the text belongs to the last run
+	return std::min(size_t(i - this->runBegins.begin()), this->runs_v.size() - 1);
+}
+
+
+
+void Paragraph::measureLine(Line& l)const{
+	l.width = this->offsets[l.end] - this->offsets[l.begin];
+	l.ascent = 0;
+	l.descent = 0;
+	
+	if(this->runs_v.size() == 0){
+		return;
+	}
+	
+	//empty line takes the height of the font at its position
+	size_t last = std::max(l.begin + 1, l.end) - 1;
+	
+	for(size_t r = this->runOf(l.begin); r < this->runs_v.size() && this->runBegins[r] <= last; ++r){
+		auto& bb = this->runs_v[r].font->boundingBox();
+		utki::clampBottom(l.ascent, bb.p.y + bb.d.y);
+		utki::clampBottom(l.descent, -bb.p.y);
+	}
+}
+
+
+
+const Paragraph::Layout& Paragraph::layout(real width)const{
+	if(width < 0){
+		width = -1;
+	}
+	
+	for(auto i = this->layouts.begin(); i != this->layouts.end(); ++i){
+		if(i->width == width){
+			std::rotate(i, i + 1, this->layouts.end());
+			return this->layouts.back();
+		}
+	}
+	
+	if(this->layouts.size() == layoutCacheSize_c){
+		this->layouts.erase(this->layouts.begin());
+	}
+	
+	this->layouts.push_back(Layout());
+	auto& ret = this->layouts.back();
+	ret.width = width;
+	
+	Line line;
+	line.begin = 0;
+	line.end = 0;
+	real x = 0;//position of the next word on the line
+	
+	auto finishLine = [&ret, &line, this](size_t nextBegin){
+		this->measureLine(line);
+		ret.lines.push_back(line);
+		line.begin = nextBegin;
+		line.end = nextBegin;
+	};
+	
+	for(auto& w : this->words){
+		real wordWidth = this->offsets[w.end] - this->offsets[w.begin];
+		
+		if(width >= 0 && line.end != line.begin && x + wordWidth > width){
+			finishLine(w.begin);
+			x = 0;
+		}
+		
+		line.end = w.end;
+		x += this->offsets[w.next] - this->offsets[w.begin];
+		
+		if(w.lineBreak){
+			finishLine(w.next);
+			x = 0;
+		}
+	}
+	finishLine(0);
+	
+	ret.dim.set(0);
+	for(auto& l : ret.lines){
+		utki::clampBottom(ret.dim.x, l.width);
+		ret.dim.y += l.ascent + l.descent;
+	}
+	
+	return ret;
+}
+
+
+
+void Paragraph::buildMesh(real width)const{
+	this->batches.clear();
+	this->fallbacks.clear();
+	
+	auto& lo = this->layout(width);
+	
+	real alignWidth = width < 0 ? lo.dim.x : width;
+	
+	std::array<kolme::Vec2f, 4> verts;
+	std::array<kolme::Vec2f, 4> texCoords;
+	
+	real top = lo.dim.y;
+	for(auto& l : lo.lines){
+		Vec2r pos;
+		switch(this->alignment_v){
+			case Align_e::CENTER:
+				pos.x = std::round((alignWidth - l.width) / 2);
+				break;
+			case Align_e::RIGHT:
+				pos.x = alignWidth - l.width;
+				break;
+			default:
+				pos.x = 0;
+				break;
+		}
+		pos.x -= this->offsets[l.begin];
+		pos.y = top - l.ascent;
+		top -= l.ascent + l.descent;
+		
+		if(l.begin == l.end){
+			continue;
+		}
+		
+		for(size_t r = this->runOf(l.begin); r < this->runs_v.size() && this->runBegins[r] < l.end; ++r){
+			auto& run = this->runs_v[r];
+			size_t b = std::max(this->runBegins[r], l.begin);
+			size_t e = std::min(this->runBegins[r + 1], l.end);
+			
+			auto tex = run.font->texture();
+			if(!tex){
+				this->fallbacks.push_back(Fallback{
+						run.font.get(),
+						Vec2r(pos.x + this->offsets[b], pos.y),
+						run.color,
+						this->chars.substr(b, e - b)
+					});
+				continue;
+			}
+			
+			auto batch = std::find_if(this->batches.begin(), this->batches.end(), [&tex, &run](const Batch& bt){
+				return bt.tex == tex && bt.color == run.color && bt.verts.size() / 4 < maxQuadsPerBatch_c;
+			});
+			if(batch == this->batches.end()){
+				this->batches.push_back(Batch{tex, run.color});
+				batch = this->batches.end() - 1;
+			}
+			
+			for(size_t i = b; i != e; ++i){
+				if(!run.font->glyphQuad(this->chars[i], verts, texCoords)){
+					ASSERT(false)
+					continue;
+				}
+				
+				//skip empty glyphs, e.g. space
+				if(verts[0] == verts[2]){
+					continue;
+				}
+				
+				if(batch->verts.size() / 4 == maxQuadsPerBatch_c){
+					this->batches.push_back(Batch{tex, run.color});
+					batch = this->batches.end() - 1;
+				}
+				
+				kolme::Vec2f p(pos.x + this->offsets[i], pos.y);
+				for(auto& v : verts){
+					batch->verts.push_back(v + p);
+				}
+				batch->texCoords.insert(batch->texCoords.end(), texCoords.begin(), texCoords.end());
+			}
+		}
+	}
+	
+	auto& r = morda::inst().renderer();
+	
+	std::vector<std::uint16_t> indices;
+	for(auto& b : this->batches){
+		if(b.verts.size() == 0){
+			continue;
+		}
+		
+		size_t numQuads = b.verts.size() / 4;
+		indices.clear();
+		indices.reserve(numQuads * 6);
+		for(size_t i = 0; i != numQuads; ++i){
+			std::uint16_t v = std::uint16_t(i * 4);
+			indices.push_back(v);
+			indices.push_back(v + 1);
+			indices.push_back(v + 2);
+			indices.push_back(v);
+			indices.push_back(v + 2);
+			indices.push_back(v + 3);
+		}
+		
+		b.vao = r.factory->createVertexArray(
+				{
+					r.factory->createVertexBuffer(utki::wrapBuf(b.verts)),
+					r.factory->createVertexBuffer(utki::wrapBuf(b.texCoords))
+				},
+				r.factory->createIndexBuffer(utki::wrapBuf(indices)),
+				VertexArray::Mode_e::TRIANGLES
+			);
+		
+		//vertices are on the GPU now
+		decltype(b.verts)().swap(b.verts);
+		decltype(b.texCoords)().swap(b.texCoords);
+	}
+	
+	this->batches.erase(
+			std::remove_if(this->batches.begin(), this->batches.end(), [](const Batch& b){return !b.vao;}),
+			this->batches.end()
+		);
+	
+	this->meshWidth = width;
+	this->meshValid = true;
+}
+
+
+
+void Paragraph::render(const Matr4r& matrix, real width)const{
+	if(width < 0){
+		width = -1;
+	}
+	
+	if(!this->meshValid || this->meshWidth != width){
+		this->buildMesh(width);
+	}
+	
+	applySimpleAlphaBlending();
+	
+	auto& s = morda::inst().renderer().shader;
+	for(auto& b : this->batches){
+		ASSERT(b.vao)
+		s->colorPosTex->render(matrix, *b.tex, colorToVec4f(b.color), *b.vao);
+	}
+	
+	for(auto& f : this->fallbacks){
+		Matr4r matr(matrix);
+		matr.translate(f.pos);
+		f.font->renderString(matr, colorToVec4f(f.color), f.text);
+	}
+}
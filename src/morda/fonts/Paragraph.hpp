@@ -0,0 +1,216 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include <kolme/Vector4.hpp>
+
+#include "../config.hpp"
+
+#include "../render/Texture2D.hpp"
+#include "../render/VertexArray.hpp"
+
+#include "Font.hpp"
+
+
+namespace morda{
+
+/**
+ * @brief Multi-line text layout.
+ * Paragraph is a text made of runs, each run having its own font and color.
+ * Text is broken to lines at '\n' characters and word wrapped at spaces to fit the given width.
+ * Words longer than the width are not broken and stick out of it.
+ * Character advances and word widths are computed once when text is set, so that breaking the text to lines
+ * is a single pass over words. Line breaks are cached for a few most recently requested widths,
+ * this makes re-layout on resizing back and forth cheap.
+ * Glyphs of fonts drawing glyphs as textured quads (see Font::glyphQuad()) are put to a single mesh per texture and color,
+ * the mesh is rebuilt only when the text or the layout width changes.
+ */
+class Paragraph{
+public:
+	/**
+	 * @brief Run of text.
+	 * Part of the paragraph text which is drawn with the same font and color.
+	 */
+	struct Run{
+		std::u32string text;
+		
+		std::shared_ptr<const Font> font;
+		
+		std::uint32_t color;
+	};
+	
+	/**
+	 * @brief Horizontal alignment of lines.
+	 */
+	enum class Align_e{
+		LEFT,
+		CENTER,
+		RIGHT
+	};
+
+private:
+	std::vector<Run> runs_v;
+	
+	Align_e alignment_v = Align_e::LEFT;
+	
+	//whole text of all runs
+	std::u32string chars;
+	
+	//index of the first character of each run, plus the total number of characters
+	std::vector<size_t> runBegins;
+	
+	//cumulative advances, i'th element is where i'th character starts
+	std::vector<real> offsets;
+	
+	//Word is a sequence of non-space characters followed by spaces and, optionally, a line break.
+	struct Word{
+		size_t begin;
+		size_t end;//end of non-space characters
+		size_t next;//beginning of the next word
+		bool lineBreak;
+	};
+	
+	std::vector<Word> words;
+	
+	struct Line{
+		size_t begin;
+		size_t end;//trailing spaces are excluded
+		real width;
+		real ascent;
+		real descent;
+	};
+	
+	struct Layout{
+		real width;
+		std::vector<Line> lines;
+		Vec2r dim;
+	};
+	
+	static const size_t layoutCacheSize_c = 4;
+	
+	//most recently used layout is the last one
+	mutable std::vector<Layout> layouts;
+	
+	struct Batch{
+		std::shared_ptr<Texture2D> tex;
+		std::uint32_t color;
+		std::vector<kolme::Vec2f> verts;
+		std::vector<kolme::Vec2f> texCoords;
+		std::shared_ptr<VertexArray> vao;
+	};
+	
+	//text of fonts which do not draw glyphs as quads
+	struct Fallback{
+		const Font* font;
+		Vec2r pos;
+		std::uint32_t color;
+		std::u32string text;
+	};
+	
+	mutable std::vector<Batch> batches;
+	mutable std::vector<Fallback> fallbacks;
+	mutable real meshWidth;
+	mutable bool meshValid = false;
+	
+	size_t runOf(size_t index)const noexcept;
+	
+	void measureLine(Line& l)const;
+	
+	const Layout& layout(real width)const;
+	
+	void buildMesh(real width)const;
+public:
+	Paragraph(){
+		this->setRuns(std::vector<Run>());
+	}
+	
+	Paragraph(const Paragraph&) = delete;
+	Paragraph& operator=(const Paragraph&) = delete;
+	
+	/**
+	 * @brief Set paragraph text.
+	 * @param runs - text runs.
+	 */
+	void setRuns(std::vector<Run>&& runs);
+	
+	/**
+	 * @brief Set paragraph text of a single run.
+	 * @param text - text.
+	 * @param font - font to use for the whole text.
+	 * @param color - color to use for the whole text.
+	 */
+	void setText(std::u32string&& text, std::shared_ptr<const Font> font, std::uint32_t color){
+		std::vector<Run> runs;
+		runs.push_back(Run{std::move(text), std::move(font), color});
+		this->setRuns(std::move(runs));
+	}
+	
+	/**
+	 * @brief Get text runs.
+	 * @return Text runs of the paragraph.
+	 */
+	const std::vector<Run>& runs()const noexcept{
+		return this->runs_v;
+	}
+	
+	/**
+	 * @brief Set color of a text run.
+	 * Unlike setting new runs, this does not invalidate the layout.
+	 * @param run - index of the run.
+	 * @param color - new color.
+	 */
+	void setColor(size_t run, std::uint32_t color);
+	
+	/**
+	 * @brief Set horizontal alignment of lines.
+	 * @param align - alignment.
+	 */
+	void setAlignment(Align_e align){
+		if(this->alignment_v == align){
+			return;
+		}
+		this->alignment_v = align;
+		this->meshValid = false;
+	}
+	
+	/**
+	 * @brief Get horizontal alignment of lines.
+	 * @return Alignment.
+	 */
+	Align_e alignment()const noexcept{
+		return this->alignment_v;
+	}
+	
+	/**
+	 * @brief Get dimensions of the laid out text.
+	 * @param width - width to lay out the text to. Negative value means no word wrapping.
+	 * @return Width of the longest line and total height of all lines.
+	 */
+	Vec2r dim(real width)const{
+		return this->layout(width).dim;
+	}
+	
+	/**
+	 * @brief Get number of lines.
+	 * @param width - width to lay out the text to. Negative value means no word wrapping.
+	 * @return Number of lines the text is broken to.
+	 */
+	size_t numLines(real width)const{
+		return this->layout(width).lines.size();
+	}
+	
+	/**
+	 * @brief Render the text.
+	 * The text is rendered to a rectangle with the left bottom corner at (0, 0).
+	 * Its width is the layout width, or width of the longest line if the layout width is negative,
+	 * and its height is the height returned by dim().
+	 * @param matrix - transformation matrix to use when rendering.
+	 * @param width - width to lay out the text to. Negative value means no word wrapping.
+	 */
+	void render(const Matr4r& matrix, real width)const;
+};
+
+}
@@ -2,12 +2,15 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_TRUETYPE_TABLES_H
+#include FT_TRUETYPE_TAGS_H
 
 
 #include <utki/debug.hpp>
 
 #include "../util/Image.hpp"
 #include "../util/util.hpp"
+#include "../util/MappedFile.hpp"
 
 #include "TexFont.hpp"
 #include "../Morda.hpp"
@@ -20,26 +23,6 @@ using namespace morda;
 
 namespace{
 
-static void BlitIfGreater(Image& dst, unsigned dstChan, const Image& src, unsigned srcChan, unsigned x, unsigned y){
-	ASSERT(dst.buf().size())
-	ASSERT(dstChan < dst.numChannels())
-	ASSERT(srcChan < src.numChannels())
-
-	unsigned blitAreaW = std::min(src.dim().x, dst.dim().x - x);
-	unsigned blitAreaH = std::min(src.dim().y, dst.dim().y - y);
-
-	for(unsigned j = 0; j < blitAreaH; ++j){
-		for(unsigned i = 0; i < blitAreaW; ++i){
-			std::uint8_t &d = dst.pixChan(i + x, j + y, dstChan);
-			std::uint8_t s = src.pixChan(i, j, srcChan);
-			if(s > d){
-				d = s;
-			}
-		}
-	}
-}
-
-
 static unsigned FindNextPowOf2(unsigned n){
 	unsigned ret = 1;
 	while(ret <= n){
@@ -53,6 +36,55 @@ const unsigned DYGap = 1;
 
 constexpr const char32_t unknownChar_c = 0xfffd;
 
+//characters kerned when the font has kerning, but not in a 'kern' table which can be read directly
+constexpr const char32_t latinLimit_c = 0x250;
+
+std::uint32_t readBe16(const std::uint8_t* p){
+	return (std::uint32_t(p[0]) << 8) | std::uint32_t(p[1]);
+}
+
+//Read glyph pairs listed in horizontal kerning subtables of the 'kern' table, the ones FT_Get_Kerning() takes kerning from.
+//Returns false if the font has no 'kern' table of supported version.
+bool readKernPairs(FT_Face face, std::vector<std::pair<FT_UInt, FT_UInt>>& pairs){
+	FT_ULong length = 0;
+	if(FT_Load_Sfnt_Table(face, TTAG_kern, 0, nullptr, &length) != 0){
+		return false;
+	}
+	
+	std::vector<std::uint8_t> kern(length);
+	if(length < 4 || FT_Load_Sfnt_Table(face, TTAG_kern, 0, &*kern.begin(), &length) != 0){
+		return false;
+	}
+	
+	//only version 0 is supported, as by FreeType itself
+	if(readBe16(&kern[0]) != 0){
+		return false;
+	}
+	
+	const std::uint8_t* p = &kern[4];
+	const std::uint8_t* end = &*kern.begin() + kern.size();
+	for(unsigned numTables = readBe16(&kern[2]); numTables != 0 && end - p >= 6; --numTables){
+		//subtable length is 16 bit and can be wrong for large subtables, so pairs are only bounded by the end of the table
+		const std::uint8_t* next = p + readBe16(p + 2);
+		std::uint32_t coverage = readBe16(p + 4);
+		
+		//format 0 subtable with horizontal kerning values
+		if((coverage >> 8) == 0 && (coverage & 0x7) == 0x1 && end - p >= 14){
+			const std::uint8_t* pair = p + 14;
+			for(unsigned numPairs = readBe16(p + 6); numPairs != 0 && end - pair >= 6; --numPairs, pair += 6){
+				pairs.push_back(std::make_pair(FT_UInt(readBe16(pair)), FT_UInt(readBe16(pair + 2))));
+			}
+		}
+		
+		if(next <= p){
+			break;
+		}
+		p = next;
+	}
+	
+	return true;
+}
+
 }//~namespace
 
 
@@ -63,7 +95,27 @@ void TexFont::load(const papki::File& fi, const std::u32string& chars, unsigned
 	
 //	TRACE(<< "TexFont::Load(): enter" << std::endl)
 
-	this->glyphs.clear();//clear glyphs map if some other font was loaded previously
+	//clear glyphs if some other font was loaded previously
+	this->glyphs.clear();
+	this->directIndex.clear();
+	this->otherIndex.clear();
+	this->kerningPairs.clear();
+	this->runs.clear();
+	this->runIndex.clear();
+	
+	//glyph indices by character, used while loading
+	std::unordered_map<char32_t, std::uint32_t> indices;
+	
+	auto addGlyph = [this, &indices](char32_t c) -> Glyph&{
+		auto i = indices.find(c);
+		if(i != indices.end()){
+			//duplicate character
+			return this->glyphs[i->second];
+		}
+		indices[c] = std::uint32_t(this->glyphs.size());
+		this->glyphs.push_back(Glyph());
+		return this->glyphs.back();
+	};
 	
 	class FreeTypeLibWrapper{
 		FT_Library lib;// handle to freetype library object
@@ -85,11 +137,12 @@ void TexFont::load(const papki::File& fi, const std::u32string& chars, unsigned
 
 	class FreeTypeFaceWrapper{
 		FT_Face face; // handle to face object
-		std::vector<std::uint8_t> fontFile;//the buffer should be alive as long as the Face is alive!!!
+		MappedFile fontFile;//the file should be mapped as long as the Face is alive!!!
 	public:
-		FreeTypeFaceWrapper(FT_Library& lib, const papki::File& fi){
-			this->fontFile = fi.loadWholeFileIntoMemory();
-			if(FT_New_Memory_Face(lib, &*this->fontFile.begin(), int(this->fontFile.size()), 0/* face_index */, &this->face) != 0){
+		FreeTypeFaceWrapper(FT_Library& lib, const papki::File& fi) :
+				fontFile(fi)
+		{
+			if(FT_New_Memory_Face(lib, this->fontFile.data(), FT_Long(this->fontFile.size()), 0/* face_index */, &this->face) != 0){
 				throw utki::Exc("TexFont::Load(): unable to crate font face object");
 			}
 		}
@@ -154,7 +207,7 @@ void TexFont::load(const papki::File& fi, const std::u32string& chars, unsigned
 		FT_GlyphSlot slot = static_cast<FT_Face&>(face)->glyph;
 
 		if(!slot->bitmap.buffer){//if glyph is empty (e.g. space character)
-			Glyph &g = this->glyphs[*c];
+			Glyph &g = addGlyph(*c);
 			g.advance = float(slot->metrics.horiAdvance) / (64.0f);
 			ASSERT(g.verts.size() == g.texCoords.size())
 			for(unsigned i = 0; i < g.verts.size(); ++i){
@@ -178,7 +231,7 @@ void TexFont::load(const papki::File& fi, const std::u32string& chars, unsigned
 					int dy = int(y) - int(outline);
 					if(utki::pow2(dx) + utki::pow2(dy) <= int(utki::pow2(outline))){
 //					if(ting::Abs(dx) + ting::Abs(dy) <= int(outline)){
-						BlitIfGreater(im, 1, glyphim, 0, x, y);
+						im.blitIfGreater(x, y, glyphim, 1, 0);
 					}
 				}
 			}
@@ -215,7 +268,7 @@ void TexFont::load(const papki::File& fi, const std::u32string& chars, unsigned
 		{
 			FT_Glyph_Metrics *m = &slot->metrics;
 			
-			Glyph &g = this->glyphs[*c];
+			Glyph &g = addGlyph(*c);
 			g.advance = real(m->horiAdvance) / (64.0f);
 			
 			ASSERT(outline < (unsigned(-1) >> 1))
@@ -270,20 +323,99 @@ void TexFont::load(const papki::File& fi, const std::u32string& chars, unsigned
 	//now the font image has its final width and heights (no more resizes will be done)
 
 	//normalize texture coordinates
-	for(T_GlyphsIter i = this->glyphs.begin(); i != this->glyphs.end(); ++i){
-		for(unsigned j = 0; j < i->second.texCoords.size(); ++j){
-			i->second.texCoords[j].compDivBy(texImg.dim().to<float>());
+	for(auto& g : this->glyphs){
+		for(unsigned j = 0; j < g.texCoords.size(); ++j){
+			g.texCoords[j].compDivBy(texImg.dim().to<float>());
 		}
 		auto& r = morda::inst().renderer();
-		i->second.vao = r.factory->createVertexArray(
+		g.vao = r.factory->createVertexArray(
 				{
-					r.factory->createVertexBuffer(utki::wrapBuf(i->second.verts)),
-					r.factory->createVertexBuffer(utki::wrapBuf(i->second.texCoords))
+					r.factory->createVertexBuffer(utki::wrapBuf(g.verts)),
+					r.factory->createVertexBuffer(utki::wrapBuf(g.texCoords))
 				},
 				indexBuffer,
 				VertexArray::Mode_e::TRIANGLE_FAN
 			);
 	}
+	
+	//build lookup tables
+	{
+		ASSERT(indices.find(unknownChar_c) != indices.end())
+		this->unknownGlyph = indices[unknownChar_c];
+		
+		char32_t maxDirect = 0;
+		for(auto& i : indices){
+			if(i.first < directIndexLimit_c){
+				utki::clampBottom(maxDirect, char32_t(i.first + 1));
+			}
+		}
+		
+		this->directIndex.assign(maxDirect, this->unknownGlyph);
+		
+		for(auto& i : indices){
+			if(i.first < directIndexLimit_c){
+				this->directIndex[i.first] = i.second;
+			}else{
+				this->otherIndex[i.first] = i.second;
+			}
+		}
+	}
+	
+	//Read kerning of glyph pairs.
+	//Pairs are taken from the 'kern' table, so the work is proportional to the number of pairs listed there instead of growing
+	//quadratically with the number of characters. If the table cannot be read, all pairs of Latin characters are tried.
+	if(FT_HAS_KERNING(static_cast<FT_Face&>(face))){
+		//glyphs by FreeType glyph index, several characters can have the same FreeType glyph
+		std::unordered_multimap<FT_UInt, std::uint32_t> kerned;
+		for(auto& i : indices){
+			FT_UInt ftIndex = FT_Get_Char_Index(face, FT_ULong(i.first));
+			if(ftIndex == 0){
+				continue;
+			}
+			kerned.insert(std::make_pair(ftIndex, i.second));
+		}
+		
+		auto addPair = [this, &face](FT_UInt left, FT_UInt right, std::uint32_t leftGlyph, std::uint32_t rightGlyph){
+			FT_Vector delta;
+			if(FT_Get_Kerning(face, left, right, FT_KERNING_DEFAULT, &delta) != 0 || delta.x == 0){
+				return;
+			}
+			this->kerningPairs[(std::uint64_t(leftGlyph) << 32) | rightGlyph] = real(delta.x) / (64.0f);
+		};
+		
+		std::vector<std::pair<FT_UInt, FT_UInt>> pairs;
+		if(readKernPairs(face, pairs)){
+			for(auto& p : pairs){
+				auto l = kerned.equal_range(p.first);
+				if(l.first == l.second){
+					continue;
+				}
+				auto r = kerned.equal_range(p.second);
+				for(auto i = l.first; i != l.second; ++i){
+					for(auto j = r.first; j != r.second; ++j){
+						addPair(p.first, p.second, i->second, j->second);
+					}
+				}
+			}
+		}else{
+			std::vector<std::pair<FT_UInt, std::uint32_t>> latin;
+			for(auto& i : indices){
+				if(i.first >= latinLimit_c){
+					continue;
+				}
+				FT_UInt ftIndex = FT_Get_Char_Index(face, FT_ULong(i.first));
+				if(ftIndex != 0){
+					latin.push_back(std::make_pair(ftIndex, i.second));
+				}
+			}
+			
+			for(auto& l : latin){
+				for(auto& r : latin){
+					addPair(l.first, r.first, l.second, r.second);
+				}
+			}
+		}
+	}
 
 //	TRACE(<< "TexFont::Load(): initing texture" << std::endl)
 	this->tex = morda::inst().renderer().factory->createTexture2D(
@@ -293,149 +425,179 @@ void TexFont::load(const papki::File& fi, const std::u32string& chars, unsigned
 		);
 }
 
-const TexFont::Glyph& TexFont::findGlyph(char32_t c)const{
-	auto i = this->glyphs.find(c);
-	if(i == this->glyphs.end()){
-		return this->glyphs.at(unknownChar_c);
+TexFont::GlyphRun& TexFont::shape(const std::u32string& str)const{
+	{
+		auto i = this->runIndex.find(str);
+		if(i != this->runIndex.end()){
+			++this->runCacheHits;
+			this->runs.splice(this->runs.begin(), this->runs, i->second);
+			return i->second->second;
+		}
 	}
-	return i->second;
-}
-
-
-
-real TexFont::renderGlyphInternal(const morda::Matr4r& matrix, kolme::Vec4f color, char32_t ch)const{
-	const Glyph& g = this->findGlyph(ch);
 	
-	morda::inst().renderer().shader->colorPosTex->render(matrix, *this->tex, color, *g.vao);
-
-	return g.advance;
-}
-
-
-
-real TexFont::stringAdvanceInternal(const std::u32string& str)const{
-	real ret = 0;
-
-	auto s = str.begin();
+	++this->runCacheMisses;
+	
+	GlyphRun r;
+	r.glyphs.reserve(str.size());
+	r.positions.reserve(str.size());
+	r.numQuads = 0;
 	
-	for(; s != str.end(); ++s){
-		try{
-			const Glyph& g = this->findGlyph(*s);
-			ret += g.advance;
-		}catch(std::out_of_range&){
-			//ignore
+	real x = 0;
+	for(auto c : str){
+		std::uint32_t g = this->findGlyphIndex(c);
+		if(r.glyphs.size() != 0){
+			x += this->glyphKerning(r.glyphs.back(), g);
+		}
+		r.glyphs.push_back(g);
+		r.positions.push_back(x);
+		x += this->glyphs[g].advance;
+		
+		if(this->glyphs[g].verts[0] != this->glyphs[g].verts[2]){
+			++r.numQuads;
 		}
 	}
-
-	return ret;
-}
-
-
-
-morda::Rectr TexFont::stringBoundingBoxInternal(const std::u32string& str)const{
-	morda::Rectr ret;
-
-	if(str.size() == 0){
-		ret.p.set(0);
-		ret.d.set(0);
-		return ret;
+	r.advance = x;
+	
+	if(r.glyphs.size() == 0){
+		r.boundingBox.p.set(0);
+		r.boundingBox.d.set(0);
+	}else{
+		real left = 1000000;
+		real right = -1000000;
+		real top = -1000000;
+		real bottom = 1000000;
+		
+		for(size_t i = 0; i != r.glyphs.size(); ++i){
+			const Glyph& g = this->glyphs[r.glyphs[i]];
+			
+			utki::clampTop(left, r.positions[i] + g.verts[0].x);
+			utki::clampBottom(right, r.positions[i] + g.verts[2].x);
+			utki::clampTop(bottom, g.verts[0].y);
+			utki::clampBottom(top, g.verts[2].y);
+		}
+		
+		r.boundingBox.p.x = left;
+		r.boundingBox.p.y = bottom;
+		r.boundingBox.d.x = right - left;
+		r.boundingBox.d.y = top - bottom;
+		
+		ASSERT(r.boundingBox.d.x >= 0)
+		ASSERT(r.boundingBox.d.y >= 0)
 	}
-
-	auto s = str.begin();
-
-	real curAdvance;
-
-	real left, right, top, bottom;
-	//init with bounding box of the first glyph
-	{
-		const Glyph& g = this->findGlyph(*s);
-		left = g.verts[0].x;
-		right = g.verts[2].x;
-		top = g.verts[2].y;
-		bottom = g.verts[0].y;
-		curAdvance = g.advance;
-		++s;
+	
+	this->runs.push_front(std::make_pair(str, std::move(r)));
+	this->runIndex[str] = this->runs.begin();
+	
+	while(this->runs.size() > std::max(this->runCacheSize_v, size_t(1))){
+		this->runIndex.erase(this->runs.back().first);
+		this->runs.pop_back();
 	}
+	
+	return this->runs.front().second;
+}
 
-	for(; s != str.end(); ++s){
-		auto i = this->glyphs.find(*s);
-		
-#ifdef DEBUG
-		if(i == this->glyphs.end()){
-			TRACE(<< "TexFont::StringBoundingLineInternal(): Character is not loaded, scan code = 0x" << std::hex << *s << std::endl)
-		}
-#endif
 
-		const Glyph& g = i == this->glyphs.end() ? this->glyphs.at(unknownChar_c) : i->second;
 
-		if(g.verts[2].y > top){
-			top = g.verts[2].y;
-		}
+void TexFont::setRunCacheSize(size_t size){
+	this->runCacheSize_v = size;
+	
+	while(this->runs.size() > std::max(this->runCacheSize_v, size_t(1))){
+		this->runIndex.erase(this->runs.back().first);
+		this->runs.pop_back();
+	}
+}
 
-		if(g.verts[0].y < bottom){
-			bottom = g.verts[0].y;
-		}
 
-		if(curAdvance + g.verts[0].x < left){
-			left = curAdvance + g.verts[0].x;
-		}
 
-		if(curAdvance + g.verts[2].x > right){
-			right = curAdvance + g.verts[2].x;
-		}
+real TexFont::stringAdvanceInternal(const std::u32string& str)const{
+	return this->shape(str).advance;
+}
 
-		curAdvance += g.advance;
-	}
 
-	ret.p.x = left;
-	ret.p.y = bottom;
-	ret.d.x = right - left;
-	ret.d.y = top - bottom;
 
-	ASSERT(ret.d.x >= 0)
-	ASSERT(ret.d.y >= 0)
-	return ret;
+morda::Rectr TexFont::stringBoundingBoxInternal(const std::u32string& str)const{
+	return this->shape(str).boundingBox;
 }
 
 
 
-
 real TexFont::renderStringInternal(const morda::Matr4r& matrix, kolme::Vec4f color, const std::u32string& str)const{
 	if(str.size() == 0){
 		return 0;
 	}
 	
+	auto& r = this->shape(str);
+	
+	if(r.numQuads == 0){
+		return r.advance;
+	}
+	
 	applySimpleAlphaBlending();
-
-	real ret = 0;
-
-	morda::Matr4r matr(matrix);
-
-	auto s = str.begin();
-
-	for(; s != str.end(); ++s){
-		try{
-			real advance = this->renderGlyphInternal(matr, color, *s);
-			ret += advance;
-			matr.translate(advance, 0);
-		}catch(std::out_of_range&){
-			//ignore
+	
+	//16 bit indices can address limited number of quads, render such long strings glyph by glyph
+	if(r.numQuads > 0x10000 / 4){
+		for(size_t i = 0; i != r.glyphs.size(); ++i){
+			morda::Matr4r matr(matrix);
+			matr.translate(r.positions[i], 0);
+			morda::inst().renderer().shader->colorPosTex->render(matr, *this->tex, color, *this->glyphs[r.glyphs[i]].vao);
 		}
+		return r.advance;
 	}
 	
-
-	return ret;
+	if(!r.vao){
+		std::vector<kolme::Vec2f> verts;
+		std::vector<kolme::Vec2f> texCoords;
+		std::vector<std::uint16_t> indices;
+		verts.reserve(r.numQuads * 4);
+		texCoords.reserve(r.numQuads * 4);
+		indices.reserve(r.numQuads * 6);
+		
+		for(size_t i = 0; i != r.glyphs.size(); ++i){
+			const Glyph& g = this->glyphs[r.glyphs[i]];
+			if(g.verts[0] == g.verts[2]){
+				continue;
+			}
+			
+			std::uint16_t v = std::uint16_t(verts.size());
+			
+			for(auto& p : g.verts){
+				verts.push_back(p + kolme::Vec2f(r.positions[i], 0));
+			}
+			texCoords.insert(texCoords.end(), g.texCoords.begin(), g.texCoords.end());
+			
+			indices.push_back(v);
+			indices.push_back(v + 1);
+			indices.push_back(v + 2);
+			indices.push_back(v);
+			indices.push_back(v + 2);
+			indices.push_back(v + 3);
+		}
+		
+		auto& rr = morda::inst().renderer();
+		
+		r.vao = rr.factory->createVertexArray(
+				{
+					rr.factory->createVertexBuffer(utki::wrapBuf(verts)),
+					rr.factory->createVertexBuffer(utki::wrapBuf(texCoords))
+				},
+				rr.factory->createIndexBuffer(utki::wrapBuf(indices)),
+				VertexArray::Mode_e::TRIANGLES
+			);
+	}
+	
+	morda::inst().renderer().shader->colorPosTex->render(matrix, *this->tex, color, *r.vao);
+	
+	return r.advance;
 }
 
 
 
 real TexFont::charAdvance(char32_t c) const{
-	auto i = this->glyphs.find(c);
-	if(i == this->glyphs.end()){
-		ASSERT(this->glyphs.find(unknownChar_c) != this->glyphs.end())
-		return this->glyphs.at(unknownChar_c).advance;
-	}
-	
-	const Glyph& g = i->second;
-	return g.advance;
+	return this->findGlyph(c).advance;
+}
+
+
+
+real TexFont::kerning(char32_t left, char32_t right)const{
+	return this->glyphKerning(this->findGlyphIndex(left), this->findGlyphIndex(right));
 }
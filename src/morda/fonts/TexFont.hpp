@@ -1,6 +1,8 @@
 #pragma once
 
-#include <map>
+#include <vector>
+#include <list>
+#include <unordered_map>
 #include <sstream>
 #include <stdexcept>
 
@@ -8,6 +10,7 @@
 #include <kolme/Rectangle.hpp>
 
 #include <utki/Exc.hpp>
+#include <utki/debug.hpp>
 #include <papki/File.hpp>
 
 #include "../config.hpp"
@@ -38,9 +41,49 @@ class TexFont : public Font{
 
 	std::shared_ptr<Texture2D> tex;
 
-	typedef std::map<char32_t, Glyph> T_GlyphsMap;
-	typedef T_GlyphsMap::iterator T_GlyphsIter;
-	T_GlyphsMap glyphs;
+	std::vector<Glyph> glyphs;
+	
+	//Characters below this value are looked up in directly indexed table.
+	//It covers Latin, Cyrillic, Greek and most of other alphabetic scripts.
+	static const char32_t directIndexLimit_c = 0x3000;
+	
+	//glyph indices for characters below directIndexLimit_c, only as large as needed for loaded characters
+	std::vector<std::uint32_t> directIndex;
+	
+	//glyph indices for the rest of characters
+	std::unordered_map<char32_t, std::uint32_t> otherIndex;
+	
+	//index of the glyph used for characters which are not loaded
+	std::uint32_t unknownGlyph = 0;
+	
+	//kerning of glyph pairs, key is index of the left glyph in higher 32 bits and index of the right glyph in lower 32 bits
+	std::unordered_map<std::uint64_t, real> kerningPairs;
+	
+	//Shaped string, i.e. glyphs and their positions.
+	struct GlyphRun{
+		std::vector<std::uint32_t> glyphs;
+		std::vector<real> positions;
+		
+		real advance;
+		morda::Rectr boundingBox;
+		
+		//number of non-empty glyphs
+		size_t numQuads;
+		
+		//mesh of all glyphs of the run, created on first rendering
+		std::shared_ptr<VertexArray> vao;
+	};
+	
+	typedef std::list<std::pair<std::u32string, GlyphRun>> RunList;
+	
+	//cached glyph runs, most recently used first
+	mutable RunList runs;
+	mutable std::unordered_map<std::u32string, RunList::iterator> runIndex;
+	
+	size_t runCacheSize_v = 256;
+	
+	mutable size_t runCacheHits = 0;
+	mutable size_t runCacheMisses = 0;
 
 public:
 	/**
@@ -76,14 +119,92 @@ public:
 
 
 	real charAdvance(char32_t c) const override;
+	
+	real kerning(char32_t left, char32_t right)const override;
+	
+	bool glyphQuad(char32_t c, std::array<kolme::Vec2f, 4>& verts, std::array<kolme::Vec2f, 4>& texCoords)const override{
+		auto& g = this->findGlyph(c);
+		verts = g.verts;
+		texCoords = g.texCoords;
+		return true;
+	}
+	
+	std::shared_ptr<Texture2D> texture()const override{
+		return this->tex;
+	}
+	
+	/**
+	 * @brief Glyph run cache statistics.
+	 */
+	struct RunCacheStats{
+		/**
+		 * @brief Number of strings found in the cache.
+		 */
+		size_t hits;
+		
+		/**
+		 * @brief Number of strings shaped because they were not in the cache.
+		 */
+		size_t misses;
+		
+		/**
+		 * @brief Number of glyph runs currently in the cache.
+		 */
+		size_t size;
+	};
+	
+	/**
+	 * @brief Get glyph run cache statistics.
+	 * @return Statistics of the glyph run cache.
+	 */
+	RunCacheStats runCacheStats()const noexcept{
+		return RunCacheStats{this->runCacheHits, this->runCacheMisses, this->runs.size()};
+	}
+	
+	/**
+	 * @brief Set glyph run cache size.
+	 * Strings are shaped to glyph runs when rendered or measured. Glyph runs of recently used strings
+	 * are kept in the cache, least recently used ones are dropped when the cache is full.
+	 * The most recently used glyph run is always kept, so zero size is same as one.
+	 * @param size - maximum number of glyph runs to keep in the cache.
+	 */
+	void setRunCacheSize(size_t size);
 
 	
 private:
 
 	void load(const papki::File& fi, const std::u32string& chars, unsigned fontSize, unsigned outline = 0);
 	
-	real renderGlyphInternal(const morda::Matr4r& matrix, kolme::Vec4f color, char32_t ch)const;
-
-	const Glyph& findGlyph(char32_t c)const;
+	std::uint32_t findGlyphIndex(char32_t c)const{
+		ASSERT(this->glyphs.size() != 0)
+		if(c < this->directIndex.size()){
+			return this->directIndex[c];
+		}
+		if(c < directIndexLimit_c){
+			return this->unknownGlyph;
+		}
+		auto i = this->otherIndex.find(c);
+		if(i == this->otherIndex.end()){
+			return this->unknownGlyph;
+		}
+		return i->second;
+	}
+	
+	const Glyph& findGlyph(char32_t c)const{
+		return this->glyphs[this->findGlyphIndex(c)];
+	}
+	
+	real glyphKerning(std::uint32_t left, std::uint32_t right)const{
+		if(this->kerningPairs.size() == 0){
+			return 0;
+		}
+		auto i = this->kerningPairs.find((std::uint64_t(left) << 32) | right);
+		if(i == this->kerningPairs.end()){
+			return 0;
+		}
+		return i->second;
+	}
+	
+	GlyphRun& shape(const std::u32string& str)const;
 };
 }
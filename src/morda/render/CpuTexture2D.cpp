@@ -0,0 +1,104 @@
+#include "CpuTexture2D.hpp"
+
+#include <cstring>
+
+#include "../Exc.hpp"
+
+#include "FrameBuffer.hpp"
+
+
+using namespace morda;
+
+
+
+CpuTexture2D::CpuTexture2D(TexType_e type, kolme::Vec2ui dim, const utki::Buf<std::uint8_t>& data) :
+		Texture2D(dim.to<real>()),
+		type_v(type),
+		dim_v(dim),
+		pixels_v(dataSize(type, dim), 0)
+{
+	if(data.size() == 0){
+		return;
+	}
+	
+	if(data.size() != this->pixels_v.size()){
+		throw morda::Exc("CpuTexture2D::CpuTexture2D(): data size does not match texture dimensions");
+	}
+	
+	memcpy(&*this->pixels_v.begin(), &*data.begin(), data.size());
+}
+
+
+
+void CpuTexture2D::updateRegion(const kolme::Rectangle<unsigned>& rect, const utki::Buf<std::uint8_t>& data){
+	if(isCompressed(this->type_v)){
+		throw morda::Exc("CpuTexture2D::updateRegion(): compressed textures cannot be updated");
+	}
+	
+	if(rect.p.x + rect.d.x > this->dim_v.x || rect.p.y + rect.d.y > this->dim_v.y){
+		throw morda::Exc("CpuTexture2D::updateRegion(): region is out of texture");
+	}
+	
+	size_t rowSize = rect.d.x * bytesPerPixel(this->type_v);
+	
+	if(data.size() != rowSize * rect.d.y){
+		throw morda::Exc("CpuTexture2D::updateRegion(): data size does not match region dimensions");
+	}
+	
+	if(data.size() == 0){
+		return;
+	}
+	
+	size_t stride = this->dim_v.x * bytesPerPixel(this->type_v);
+	
+	for(unsigned y = 0; y != rect.d.y; ++y){
+		memcpy(
+				&this->pixels_v[(rect.p.y + y) * stride + rect.p.x * bytesPerPixel(this->type_v)],
+				&data[y * rowSize],
+				rowSize
+			);
+	}
+}
+
+
+
+void CpuTexture2D::copyFrom(const FrameBuffer* src, const kolme::Rectangle<unsigned>& rect, kolme::Vec2ui pos){
+	auto srcTex = src ? dynamic_cast<const CpuTexture2D*>(src->colorTexture().get()) : nullptr;
+	if(!srcTex){
+		throw morda::Exc("CpuTexture2D::copyFrom(): only copying from framebuffers with CpuTexture2D color attachment is supported");
+	}
+	
+	if(srcTex->type() != this->type_v){
+		throw morda::Exc("CpuTexture2D::copyFrom(): texture types do not match");
+	}
+	
+	if(isCompressed(this->type_v)){
+		throw morda::Exc("CpuTexture2D::copyFrom(): compressed textures cannot be updated");
+	}
+	
+	if(rect.p.x + rect.d.x > srcTex->dim_v.x || rect.p.y + rect.d.y > srcTex->dim_v.y){
+		throw morda::Exc("CpuTexture2D::copyFrom(): region is out of framebuffer");
+	}
+	
+	if(pos.x + rect.d.x > this->dim_v.x || pos.y + rect.d.y > this->dim_v.y){
+		throw morda::Exc("CpuTexture2D::copyFrom(): region is out of texture");
+	}
+	
+	if(rect.d.x == 0 || rect.d.y == 0){
+		return;
+	}
+	
+	size_t bpp = bytesPerPixel(this->type_v);
+	size_t srcStride = srcTex->dim_v.x * bpp;
+	size_t dstStride = this->dim_v.x * bpp;
+	
+	//memmove, since source and destination can be the same texture
+	for(unsigned y = 0; y != rect.d.y; ++y){
+		unsigned row = pos.y > rect.p.y ? rect.d.y - 1 - y : y;
+		memmove(
+				&this->pixels_v[(pos.y + row) * dstStride + pos.x * bpp],
+				&srcTex->pixels_v[(rect.p.y + row) * srcStride + rect.p.x * bpp],
+				rect.d.x * bpp
+			);
+	}
+}
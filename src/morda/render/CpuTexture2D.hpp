@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include "Texture2D.hpp"
+
+namespace morda{
+
+/**
+ * @brief Texture kept in memory.
+ * Texture implementation for render backends which do not have a GPU, e.g. headless ones used in tests.
+ * Pixel data is kept in memory, region updates are done on CPU.
+ * Copying from framebuffers is supported for framebuffers which have CpuTexture2D color attachment
+ * of the same type.
+ */
+class CpuTexture2D : public Texture2D{
+	TexType_e type_v;
+	
+	kolme::Vec2ui dim_v;
+	
+	std::vector<std::uint8_t> pixels_v;
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param type - texture type.
+	 * @param dim - texture dimensions in pixels.
+	 * @param data - pixel data, same as for RenderFactory::createTexture2D(). Empty buffer means initialize all pixels to 0.
+	 */
+	CpuTexture2D(TexType_e type, kolme::Vec2ui dim, const utki::Buf<std::uint8_t>& data);
+	
+	/**
+	 * @brief Get texture type.
+	 * @return Texture type.
+	 */
+	TexType_e type()const noexcept{
+		return this->type_v;
+	}
+	
+	/**
+	 * @brief Get pixel data.
+	 * Rows go in the same order as for RenderFactory::createTexture2D().
+	 * @return Pixel data.
+	 */
+	const std::vector<std::uint8_t>& pixels()const noexcept{
+		return this->pixels_v;
+	}
+	
+	void updateRegion(const kolme::Rectangle<unsigned>& rect, const utki::Buf<std::uint8_t>& data)override;
+	
+	void copyFrom(const FrameBuffer* src, const kolme::Rectangle<unsigned>& rect, kolme::Vec2ui pos)override;
+};
+
+}
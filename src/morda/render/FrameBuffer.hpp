@@ -18,6 +18,14 @@ public:
 	FrameBuffer(const FrameBuffer&) = delete;
 	FrameBuffer& operator=(const FrameBuffer&) = delete;
 	
+	/**
+	 * @brief Get color attachment.
+	 * @return Texture the framebuffer renders color to.
+	 */
+	const std::shared_ptr<Texture2D>& colorTexture()const noexcept{
+		return this->color;
+	}
+	
 private:
 
 };
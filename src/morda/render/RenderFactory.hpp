@@ -32,6 +32,16 @@ public:
 	
 	std::shared_ptr<Texture2D> createTexture2D(kolme::Vec2ui dim, const utki::Buf<std::uint32_t>& data);
 	
+	/**
+	 * @brief Check if texture type is supported.
+	 * Uncompressed texture types are always supported, support of compressed ones depends on the render backend.
+	 * @param type - texture type.
+	 * @return true if textures of given type can be created.
+	 */
+	virtual bool isSupported(Texture2D::TexType_e type){
+		return !Texture2D::isCompressed(type);
+	}
+	
 	virtual std::shared_ptr<VertexBuffer> createVertexBuffer(const utki::Buf<kolme::Vec4f> vertices) = 0;
 	
 	virtual std::shared_ptr<VertexBuffer> createVertexBuffer(const utki::Buf<kolme::Vec3f> vertices) = 0;
@@ -16,3 +16,26 @@ unsigned Texture2D::bytesPerPixel(Texture2D::TexType_e t) {
 			return 0;
 	}
 }
+
+bool Texture2D::isCompressed(Texture2D::TexType_e t){
+	switch(t){
+		case Texture2D::TexType_e::ETC2_RGB8:
+		case Texture2D::TexType_e::ETC2_RGBA8:
+			return true;
+		default:
+			return false;
+	}
+}
+
+size_t Texture2D::dataSize(Texture2D::TexType_e t, kolme::Vec2ui dim){
+	//compressed formats are made of 4x4 pixel blocks
+	size_t numBlocks = size_t((dim.x + 3) / 4) * size_t((dim.y + 3) / 4);
+	switch(t){
+		case Texture2D::TexType_e::ETC2_RGB8:
+			return numBlocks * 8;
+		case Texture2D::TexType_e::ETC2_RGBA8:
+			return numBlocks * 16;
+		default:
+			return size_t(dim.x) * size_t(dim.y) * bytesPerPixel(t);
+	}
+}
@@ -3,8 +3,13 @@
 #include "../config.hpp"
 
 #include <utki/Shared.hpp>
+#include <utki/Buf.hpp>
+
+#include <kolme/Rectangle.hpp>
 
 namespace morda{
+
+class FrameBuffer;
 	
 
 class Texture2D : virtual public utki::Shared{
@@ -28,10 +33,64 @@ public:
 		GREY,
 		GREYA,
 		RGB,
-		RGBA
+		RGBA,
+		
+		/**
+		 * @brief ETC2 compressed RGB.
+		 * 8 bytes per 4x4 pixels block. Compatible with ETC1.
+		 */
+		ETC2_RGB8,
+		
+		/**
+		 * @brief ETC2 compressed RGB with EAC compressed alpha.
+		 * 16 bytes per 4x4 pixels block.
+		 */
+		ETC2_RGBA8
 	};
 	
+	/**
+	 * @brief Get number of bytes per pixel.
+	 * @param t - texture type.
+	 * @return Number of bytes per pixel for uncompressed texture types.
+	 * @return 0 for compressed texture types.
+	 */
 	static unsigned bytesPerPixel(Texture2D::TexType_e t);
+	
+	/**
+	 * @brief Check if texture type is a compressed one.
+	 * @param t - texture type.
+	 * @return true if pixel data of the texture type is compressed.
+	 */
+	static bool isCompressed(Texture2D::TexType_e t);
+	
+	/**
+	 * @brief Get size of pixel data.
+	 * @param t - texture type.
+	 * @param dim - dimensions in pixels.
+	 * @return Number of bytes of pixel data of a texture of given type and dimensions.
+	 */
+	static size_t dataSize(Texture2D::TexType_e t, kolme::Vec2ui dim);
+	
+	/**
+	 * @brief Replace pixels of a part of the texture.
+	 * Allows uploading a texture in bands as it is decoded, or updating parts of atlases
+	 * without re-uploading the whole texture.
+	 * Not supported for compressed textures.
+	 * @param rect - rectangle of the texture to update, in pixels.
+	 * @param data - pixel data of the same format as was given when creating the texture,
+	 *               rows go in the same order as for RenderFactory::createTexture2D().
+	 */
+	virtual void updateRegion(const kolme::Rectangle<unsigned>& rect, const utki::Buf<std::uint8_t>& data) = 0;
+	
+	/**
+	 * @brief Copy pixels from framebuffer to a part of the texture.
+	 * Pixels are copied without going through the CPU where the render backend allows it.
+	 * Not supported for compressed textures.
+	 * @param src - framebuffer to copy pixels from, nullptr means the default framebuffer.
+	 * @param rect - rectangle of the framebuffer to copy, in pixels.
+	 * @param pos - position in the texture to copy the pixels to, in pixels.
+	 */
+	virtual void copyFrom(const FrameBuffer* src, const kolme::Rectangle<unsigned>& rect, kolme::Vec2ui pos) = 0;
 };
 
 }
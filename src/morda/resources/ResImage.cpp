@@ -14,6 +14,8 @@
 #include "../Morda.hpp"
 
 #include "../util/util.hpp"
+#include "../util/Image.hpp"
+#include "../util/ImageKernels.hpp"
 
 
 
@@ -78,9 +80,111 @@ public:
 	}
 };
 	
-class ResRasterImage : public ResImage, public TexQuadTexture{
+class ResRasterImage : public ResImage{
+	std::unique_ptr<const papki::File> file;
+	
+	kolme::Vec2ui dim_v;
+	
+	kolme::Vec2ui levelDim(unsigned level)const noexcept{
+		return kolme::Vec2ui(
+				std::max(this->dim_v.x >> level, 1u),
+				std::max(this->dim_v.y >> level, 1u)
+			);
+	}
+
 public:
-	ResRasterImage(std::shared_ptr<Texture2D> tex) :
+	ResRasterImage(std::unique_ptr<const papki::File> file, kolme::Vec2ui dim) :
+			file(std::move(file)),
+			dim_v(dim)
+	{}
+	
+	//Texture of the image downscaled by a power of 2, i.e. a mipmap level.
+	class RasterTexture : public TexQuadTexture{
+		std::weak_ptr<const ResRasterImage> parent;
+		unsigned level;
+	public:
+		RasterTexture(std::shared_ptr<const ResRasterImage> parent, unsigned level, std::shared_ptr<Texture2D> tex) :
+				TexQuadTexture(std::move(tex)),
+				parent(parent),
+				level(level)
+		{}
+		
+		~RasterTexture()noexcept{
+			if(auto p = this->parent.lock()){
+				p->cache.erase(this->level);
+			}
+		}
+	};
+	
+	std::shared_ptr<const ResImage::QuadTexture> get(Vec2r forDim) const override{
+		unsigned level = 0;
+		
+		if(forDim.x > 0 || forDim.y > 0){
+			Vec2r d = this->dim_v.to<real>();
+			if(forDim.x <= 0){
+				forDim.x = d.x * forDim.y / d.y;
+			}else if(forDim.y <= 0){
+				forDim.y = d.y * forDim.x / d.x;
+			}
+	
+			//Take the smallest level which is not smaller than requested, so that the image is never upscaled from a downscaled texture.
+			for(; level != 31; ++level){
+				auto next = this->levelDim(level + 1);
+				if(next == this->levelDim(level) || real(next.x) < forDim.x || real(next.y) < forDim.y){
+					break;
+				}
+			}
+		}
+		
+		{//check if in cache
+			auto i = this->cache.find(level);
+			if(i != this->cache.end()){
+				if(auto p = i->second.lock()){
+					this->lastUsed = p;
+					return p;
+				}
+			}
+		}
+		
+		//decode directly at the level size, uploading to texture while decoding
+		Image::LoadOptions options;
+		if(level != 0){
+			options.dim = this->levelDim(level);
+		}
+		auto t = loadTexture(*this->file, options);
+		
+		auto tex = utki::makeShared<RasterTexture>(this->sharedFromThis(this), level, std::move(t));
+		
+		this->cache[level] = tex;
+		this->lastUsed = tex;
+		
+		return tex;
+	}
+	
+	mutable std::map<unsigned, std::weak_ptr<RasterTexture>> cache;
+	
+	//most recently requested texture is kept, so that it is not decoded again when it is requested after being released, e.g. on widget resize
+	mutable std::shared_ptr<RasterTexture> lastUsed;
+	
+	Vec2r dim(real dpi) const noexcept override{
+		return this->dim_v.to<real>();
+	}
+	
+	static std::shared_ptr<ResRasterImage> load(const papki::File& fi){
+		//image is decoded only when texture is requested, at the requested size
+		auto dim = Image::readDim(fi);
+		
+		auto f = fi.spawn();
+		f->setPath(fi.path());
+		
+		return utki::makeShared<ResRasterImage>(std::move(f), dim);
+	}
+};
+
+//Image loaded from KTX file with ETC2 compressed data, it has no mipmap levels and is used at any requested size.
+class ResCompressedImage : public ResImage, public TexQuadTexture{
+public:
+	ResCompressedImage(std::shared_ptr<Texture2D> tex) :
 			TexQuadTexture(std::move(tex))
 	{}
 	
@@ -89,11 +193,11 @@ public:
 	}
 	
 	Vec2r dim(real dpi) const noexcept override{
-		return this->tex_v->dim();
+		return this->ResImage::QuadTexture::dim();
 	}
 	
-	static std::shared_ptr<ResRasterImage> load(const papki::File& fi){
-		return utki::makeShared<ResRasterImage>(loadTexture(fi));
+	static std::shared_ptr<ResCompressedImage> load(const papki::File& fi){
+		return utki::makeShared<ResCompressedImage>(loadTexture(fi));
 	}
 };
 
@@ -154,19 +258,7 @@ public:
 		ASSERT(imHeight != 0)
 		ASSERT_INFO(imWidth * imHeight == pixels.size(), "imWidth = " << imWidth << " imHeight = " << imHeight << " pixels.size() = " << pixels.size())
 		
-		//flip pixels vertically
-		{
-			std::vector<std::uint32_t> line(imWidth);
-
-			size_t stride = imWidth * sizeof(pixels[0]);
-			
-			//TODO: use iterators
-			for(unsigned i = 0; i != imHeight / 2; ++i){
-				memcpy(&*line.begin(), &*pixels.begin() + imWidth * i, stride);//move line to temp
-				memcpy(&*pixels.begin() + imWidth * i, &*pixels.begin() + imWidth * (imHeight - i - 1), stride);//move bottom line to top
-				memcpy(&*pixels.begin() + imWidth * (imHeight - i - 1), &*line.begin(), stride);
-			}
-		}
+		imageKernels::flipVertical(reinterpret_cast<std::uint8_t*>(&*pixels.begin()), imWidth * sizeof(pixels[0]), imHeight);
 		
 		auto img = utki::makeShared<SvgTexture>(
 				this->sharedFromThis(this),
@@ -202,6 +294,8 @@ std::shared_ptr<ResImage> ResImage::load(const stob::Node& chain, const papki::F
 std::shared_ptr<ResImage> ResImage::load(const papki::File& fi) {
 	if(fi.ext().compare("svg") == 0){
 		return ResSvgImage::load(fi);
+	}else if(fi.ext().compare("ktx") == 0){
+		return ResCompressedImage::load(fi);
 	}else{
 		return ResRasterImage::load(fi);
 	}
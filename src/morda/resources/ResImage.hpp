@@ -17,7 +17,7 @@ namespace morda{
  * 
  * %Resource description:
  * 
- * @param file - name of the file to read the image from, can be raster image or SVG.
+ * @param file - name of the file to read the image from, can be raster image, SVG or KTX with ETC2 compressed data.
  * 
  * Example:
  * @code
@@ -84,7 +84,7 @@ private:
 public:
 	/**
 	 * @brief Load image resource from image file.
-	 * Files supported are PNG, JPG, SVG.
+	 * Files supported are PNG, JPG, SVG and KTX with ETC2 compressed data.
 	 * @param fi - image file.
 	 * @return Loaded resource.
 	 */
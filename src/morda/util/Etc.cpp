@@ -0,0 +1,746 @@
+#include "Etc.hpp"
+
+#include <array>
+#include <cmath>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <utki/debug.hpp>
+
+#include "../Exc.hpp"
+#include "../ThreadPool.hpp"
+
+#include "MappedFile.hpp"
+
+
+using namespace morda;
+
+
+
+namespace{
+
+//pixels of 4x4 block, row by row, with red, green, blue and alpha values
+typedef std::array<std::array<int, 4>, 16> Block;
+
+//intensity modifiers of individual and differential modes
+const int modifierTable_c[8][2] = {
+	{2, 8},
+	{5, 17},
+	{9, 29},
+	{13, 42},
+	{18, 60},
+	{24, 80},
+	{33, 106},
+	{47, 183}
+};
+
+//distances between paint colors of T and H modes
+const int distanceTable_c[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+//alpha modifiers of EAC blocks
+const int alphaTable_c[16][8] = {
+	{-3, -6, -9, -15, 2, 5, 8, 14},
+	{-3, -7, -10, -13, 2, 6, 9, 12},
+	{-2, -5, -8, -13, 1, 4, 7, 12},
+	{-2, -4, -6, -13, 1, 3, 5, 12},
+	{-3, -6, -8, -12, 2, 5, 7, 11},
+	{-3, -7, -9, -11, 2, 6, 8, 10},
+	{-4, -7, -8, -11, 3, 6, 7, 10},
+	{-3, -5, -8, -11, 2, 4, 7, 10},
+	{-2, -6, -8, -10, 1, 5, 7, 9},
+	{-2, -5, -8, -10, 1, 4, 7, 9},
+	{-2, -4, -8, -10, 1, 3, 7, 9},
+	{-2, -5, -7, -10, 1, 4, 6, 9},
+	{-3, -4, -7, -10, 2, 3, 6, 9},
+	{-1, -2, -3, -10, 0, 1, 2, 9},
+	{-4, -6, -8, -9, 3, 5, 7, 8},
+	{-3, -5, -7, -9, 2, 4, 6, 8}
+};
+
+//alpha table with zero modifier, used for blocks of constant alpha
+const unsigned constantAlphaTable_c = 13;
+const unsigned constantAlphaIndex_c = 4;
+
+int clamp255(int v){
+	return std::min(std::max(v, 0), 255);
+}
+
+int extend4(unsigned v){
+	return int((v << 4) | v);
+}
+
+int extend5(unsigned v){
+	return int((v << 3) | (v >> 2));
+}
+
+int extend6(unsigned v){
+	return int((v << 2) | (v >> 4));
+}
+
+int extend7(unsigned v){
+	return int((v << 1) | (v >> 6));
+}
+
+int signed3(unsigned v){
+	return v >= 4 ? int(v) - 8 : int(v);
+}
+
+int square(int v){
+	return v * v;
+}
+
+std::uint64_t readBlock(const std::uint8_t* p){
+	std::uint64_t ret = 0;
+	for(unsigned i = 0; i != 8; ++i){
+		ret = (ret << 8) | p[i];
+	}
+	return ret;
+}
+
+void writeBlock(std::uint8_t* p, std::uint64_t bits){
+	for(unsigned i = 0; i != 8; ++i){
+		p[7 - i] = std::uint8_t(bits);
+		bits >>= 8;
+	}
+}
+
+//index of the pixel in pixel index bits, pixels go column by column
+unsigned bitIndex(unsigned i){
+	return (i % 4) * 4 + i / 4;
+}
+
+//index of the subblock to which the pixel belongs
+unsigned subblockOf(unsigned i, bool flip){
+	return (flip ? i / 4 : i % 4) / 2;
+}
+
+void forEachBlockRow(unsigned numRows, ThreadPool* pool, const std::function<void(unsigned)>& f){
+	if(pool && numRows > 1){
+		pool->parallelFor(numRows, [&f](size_t i){
+			f(unsigned(i));
+		});
+	}else{
+		for(unsigned i = 0; i != numRows; ++i){
+			f(i);
+		}
+	}
+}
+
+
+
+//find modifier table and pixel indices which give the least error for the subblock with given base color
+unsigned fitSubblock(const Block& b, bool flip, unsigned sub, const int* base, unsigned& table, std::uint32_t& indices){
+	unsigned bestError = ~0u;
+	std::uint32_t bestIndices = 0;
+	
+	for(unsigned t = 0; t != 8; ++t){
+		const int mods[4] = {modifierTable_c[t][0], modifierTable_c[t][1], -modifierTable_c[t][0], -modifierTable_c[t][1]};
+		
+		unsigned error = 0;
+		std::uint32_t ind = 0;
+		for(unsigned i = 0; i != b.size(); ++i){
+			if(subblockOf(i, flip) != sub){
+				continue;
+			}
+			
+			unsigned bestPixelError = ~0u;
+			unsigned bestIndex = 0;
+			for(unsigned m = 0; m != 4; ++m){
+				unsigned e = 0;
+				for(unsigned c = 0; c != 3; ++c){
+					e += unsigned(square(clamp255(base[c] + mods[m]) - b[i][c]));
+				}
+				if(e < bestPixelError){
+					bestPixelError = e;
+					bestIndex = m;
+				}
+			}
+			error += bestPixelError;
+			
+			unsigned p = bitIndex(i);
+			ind |= ((bestIndex >> 1) << (16 + p)) | ((bestIndex & 1) << p);
+		}
+		
+		if(error < bestError){
+			bestError = error;
+			bestIndices = ind;
+			table = t;
+		}
+	}
+	
+	indices |= bestIndices;
+	return bestError;
+}
+
+
+
+std::uint64_t encodeColorBlock(const Block& b){
+	std::uint64_t ret = 0;
+	unsigned bestError = ~0u;
+	
+	for(unsigned flip = 0; flip != 2; ++flip){
+		float avg[2][3] = {};
+		for(unsigned i = 0; i != b.size(); ++i){
+			for(unsigned c = 0; c != 3; ++c){
+				avg[subblockOf(i, flip != 0)][c] += float(b[i][c]) / 8;
+			}
+		}
+		
+		//individual mode, 4 bits per component of base color of each subblock
+		{
+			unsigned q[2][3];
+			int base[2][3];
+			for(unsigned s = 0; s != 2; ++s){
+				for(unsigned c = 0; c != 3; ++c){
+					q[s][c] = unsigned(std::lround(avg[s][c] * 15 / 255));
+					base[s][c] = extend4(q[s][c]);
+				}
+			}
+			
+			unsigned t[2];
+			std::uint32_t indices = 0;
+			unsigned error = fitSubblock(b, flip != 0, 0, base[0], t[0], indices)
+					+ fitSubblock(b, flip != 0, 1, base[1], t[1], indices);
+			
+			if(error < bestError){
+				bestError = error;
+				ret = (std::uint64_t(q[0][0]) << 60) | (std::uint64_t(q[1][0]) << 56)
+						| (std::uint64_t(q[0][1]) << 52) | (std::uint64_t(q[1][1]) << 48)
+						| (std::uint64_t(q[0][2]) << 44) | (std::uint64_t(q[1][2]) << 40)
+						| (std::uint64_t(t[0]) << 37) | (std::uint64_t(t[1]) << 34)
+						| (std::uint64_t(flip) << 32) | indices;
+			}
+		}
+		
+		//differential mode, 5 bits per component of base color of the first subblock and 3 bit signed difference for the second one
+		{
+			unsigned q[3];
+			int d[3];
+			int base[2][3];
+			for(unsigned c = 0; c != 3; ++c){
+				q[c] = unsigned(std::lround(avg[0][c] * 31 / 255));
+				d[c] = std::min(std::max(int(std::lround(avg[1][c] * 31 / 255)) - int(q[c]), -4), 3);
+				
+				//keep the second base color within 5 bit range, otherwise the block would be decoded in one of ETC2 modes
+				d[c] = std::min(std::max(d[c], -int(q[c])), 31 - int(q[c]));
+				
+				base[0][c] = extend5(q[c]);
+				base[1][c] = extend5(unsigned(int(q[c]) + d[c]));
+			}
+			
+			unsigned t[2];
+			std::uint32_t indices = 0;
+			unsigned error = fitSubblock(b, flip != 0, 0, base[0], t[0], indices)
+					+ fitSubblock(b, flip != 0, 1, base[1], t[1], indices);
+			
+			if(error < bestError){
+				bestError = error;
+				ret = (std::uint64_t(q[0]) << 59) | (std::uint64_t(d[0] & 7) << 56)
+						| (std::uint64_t(q[1]) << 51) | (std::uint64_t(d[1] & 7) << 48)
+						| (std::uint64_t(q[2]) << 43) | (std::uint64_t(d[2] & 7) << 40)
+						| (std::uint64_t(t[0]) << 37) | (std::uint64_t(t[1]) << 34)
+						| (std::uint64_t(1) << 33) | (std::uint64_t(flip) << 32) | indices;
+			}
+		}
+	}
+	
+	return ret;
+}
+
+
+
+std::uint64_t encodeAlphaBlock(const Block& b){
+	int minAlpha = 255;
+	int maxAlpha = 0;
+	for(auto& p : b){
+		minAlpha = std::min(minAlpha, p[3]);
+		maxAlpha = std::max(maxAlpha, p[3]);
+	}
+	
+	if(minAlpha == maxAlpha){
+		std::uint64_t ret = (std::uint64_t(minAlpha) << 56) | (std::uint64_t(1) << 52) | (std::uint64_t(constantAlphaTable_c) << 48);
+		for(unsigned i = 0; i != b.size(); ++i){
+			ret |= std::uint64_t(constantAlphaIndex_c) << (45 - 3 * bitIndex(i));
+		}
+		return ret;
+	}
+	
+	std::uint64_t ret = 0;
+	unsigned bestError = ~0u;
+	
+	for(unsigned t = 0; t != 16; ++t){
+		//modifiers 3 and 7 are the smallest and the largest ones in each table
+		int range = alphaTable_c[t][7] - alphaTable_c[t][3];
+		int mult = int(std::lround(float(maxAlpha - minAlpha) / range));
+		
+		for(int m = std::max(mult - 1, 1); m <= std::min(mult + 1, 15); ++m){
+			int center = (minAlpha + maxAlpha - (alphaTable_c[t][3] + alphaTable_c[t][7]) * m) / 2;
+			
+			for(int base = std::max(center - 2, 0); base <= std::min(center + 2, 255); ++base){
+				unsigned error = 0;
+				std::uint64_t indices = 0;
+				for(unsigned i = 0; i != b.size(); ++i){
+					unsigned bestPixelError = ~0u;
+					unsigned bestIndex = 0;
+					for(unsigned k = 0; k != 8; ++k){
+						unsigned e = unsigned(square(clamp255(base + alphaTable_c[t][k] * m) - b[i][3]));
+						if(e < bestPixelError){
+							bestPixelError = e;
+							bestIndex = k;
+						}
+					}
+					error += bestPixelError;
+					indices |= std::uint64_t(bestIndex) << (45 - 3 * bitIndex(i));
+				}
+				
+				if(error < bestError){
+					bestError = error;
+					ret = (std::uint64_t(base) << 56) | (std::uint64_t(m) << 52) | (std::uint64_t(t) << 48) | indices;
+				}
+			}
+		}
+	}
+	
+	return ret;
+}
+
+
+
+void decodeColorBlock(std::uint64_t bits, Block& b){
+	unsigned pixelIndex[16];
+	for(unsigned i = 0; i != b.size(); ++i){
+		unsigned p = bitIndex(i);
+		pixelIndex[i] = unsigned(((bits >> (16 + p)) & 1) << 1) | unsigned((bits >> p) & 1);
+	}
+	
+	bool flip = ((bits >> 32) & 1) != 0;
+	
+	int base[2][3];
+	
+	if(((bits >> 33) & 1) == 0){
+		//individual mode
+		for(unsigned c = 0; c != 3; ++c){
+			base[0][c] = extend4(unsigned(bits >> (60 - c * 8)) & 0xf);
+			base[1][c] = extend4(unsigned(bits >> (56 - c * 8)) & 0xf);
+		}
+	}else{
+		int q[3];
+		int d[3];
+		for(unsigned c = 0; c != 3; ++c){
+			q[c] = int((bits >> (59 - c * 8)) & 0x1f);
+			d[c] = signed3(unsigned(bits >> (56 - c * 8)) & 0x7);
+		}
+		
+		if(q[0] + d[0] < 0 || q[0] + d[0] > 31 || q[1] + d[1] < 0 || q[1] + d[1] > 31){
+			//T or H mode
+			int c0[3];
+			int c1[3];
+			int dist;
+			std::array<std::array<int, 3>, 4> paint;
+			
+			if(q[0] + d[0] < 0 || q[0] + d[0] > 31){
+				//T mode
+				c0[0] = extend4(unsigned(((bits >> 57) & 0xc) | ((bits >> 56) & 0x3)));
+				c0[1] = extend4(unsigned(bits >> 52) & 0xf);
+				c0[2] = extend4(unsigned(bits >> 48) & 0xf);
+				c1[0] = extend4(unsigned(bits >> 44) & 0xf);
+				c1[1] = extend4(unsigned(bits >> 40) & 0xf);
+				c1[2] = extend4(unsigned(bits >> 36) & 0xf);
+				dist = distanceTable_c[((bits >> 33) & 0x6) | ((bits >> 32) & 0x1)];
+				
+				for(unsigned c = 0; c != 3; ++c){
+					paint[0][c] = c0[c];
+					paint[1][c] = clamp255(c1[c] + dist);
+					paint[2][c] = c1[c];
+					paint[3][c] = clamp255(c1[c] - dist);
+				}
+			}else{
+				//H mode
+				c0[0] = extend4(unsigned(bits >> 59) & 0xf);
+				c0[1] = extend4(unsigned(((bits >> 55) & 0xe) | ((bits >> 52) & 0x1)));
+				c0[2] = extend4(unsigned(((bits >> 48) & 0x8) | ((bits >> 47) & 0x7)));
+				c1[0] = extend4(unsigned(bits >> 43) & 0xf);
+				c1[1] = extend4(unsigned(((bits >> 39) & 0xe) | ((bits >> 39) & 0x1)));
+				c1[2] = extend4(unsigned(bits >> 35) & 0xf);
+				
+				//lowest bit of distance index is given by the order of the colors
+				unsigned v0 = unsigned((c0[0] << 16) | (c0[1] << 8) | c0[2]);
+				unsigned v1 = unsigned((c1[0] << 16) | (c1[1] << 8) | c1[2]);
+				dist = distanceTable_c[((bits >> 32) & 0x4) | ((bits >> 31) & 0x2) | (v0 >= v1 ? 1 : 0)];
+				
+				for(unsigned c = 0; c != 3; ++c){
+					paint[0][c] = clamp255(c0[c] + dist);
+					paint[1][c] = clamp255(c0[c] - dist);
+					paint[2][c] = clamp255(c1[c] + dist);
+					paint[3][c] = clamp255(c1[c] - dist);
+				}
+			}
+			
+			for(unsigned i = 0; i != b.size(); ++i){
+				for(unsigned c = 0; c != 3; ++c){
+					b[i][c] = paint[pixelIndex[i]][c];
+				}
+			}
+			return;
+		}
+		
+		if(q[2] + d[2] < 0 || q[2] + d[2] > 31){
+			//planar mode
+			int o[3];
+			int h[3];
+			int v[3];
+			o[0] = extend6(unsigned(bits >> 57) & 0x3f);
+			o[1] = extend7(unsigned(((bits >> 50) & 0x40) | ((bits >> 49) & 0x3f)));
+			o[2] = extend6(unsigned(((bits >> 43) & 0x20) | ((bits >> 40) & 0x18) | ((bits >> 39) & 0x7)));
+			h[0] = extend6(unsigned(((bits >> 33) & 0x3e) | ((bits >> 32) & 0x1)));
+			h[1] = extend7(unsigned(bits >> 25) & 0x7f);
+			h[2] = extend6(unsigned(bits >> 19) & 0x3f);
+			v[0] = extend6(unsigned(bits >> 13) & 0x3f);
+			v[1] = extend7(unsigned(bits >> 6) & 0x7f);
+			v[2] = extend6(unsigned(bits) & 0x3f);
+			
+			for(unsigned i = 0; i != b.size(); ++i){
+				int x = int(i % 4);
+				int y = int(i / 4);
+				for(unsigned c = 0; c != 3; ++c){
+					b[i][c] = clamp255((x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2);
+				}
+			}
+			return;
+		}
+		
+		//differential mode
+		for(unsigned c = 0; c != 3; ++c){
+			base[0][c] = extend5(unsigned(q[c]));
+			base[1][c] = extend5(unsigned(q[c] + d[c]));
+		}
+	}
+	
+	unsigned table[2] = {unsigned(bits >> 37) & 0x7, unsigned(bits >> 34) & 0x7};
+	
+	for(unsigned i = 0; i != b.size(); ++i){
+		unsigned s = subblockOf(i, flip);
+		auto& m = modifierTable_c[table[s]];
+		int mod = pixelIndex[i] & 1 ? m[1] : m[0];
+		if(pixelIndex[i] & 2){
+			mod = -mod;
+		}
+		for(unsigned c = 0; c != 3; ++c){
+			b[i][c] = clamp255(base[s][c] + mod);
+		}
+	}
+}
+
+
+
+void decodeAlphaBlock(std::uint64_t bits, Block& b){
+	int base = int(bits >> 56);
+	int mult = int((bits >> 52) & 0xf);
+	auto& table = alphaTable_c[(bits >> 48) & 0xf];
+	
+	for(unsigned i = 0; i != b.size(); ++i){
+		b[i][3] = clamp255(base + table[(bits >> (45 - 3 * bitIndex(i))) & 0x7] * mult);
+	}
+}
+
+
+
+const std::array<std::uint8_t, 12> ktxIdentifier_c = {{0xab, 'K', 'T', 'X', ' ', '1', '1', 0xbb, '\r', '\n', 0x1a, '\n'}};
+
+const std::uint32_t ktxEndianness_c = 0x04030201;
+
+//number of 32 bit fields in KTX header after the identifier
+const unsigned ktxNumHeaderFields_c = 13;
+
+const std::uint32_t glCompressedRgb8Etc2_c = 0x9274;
+const std::uint32_t glCompressedRgba8Etc2Eac_c = 0x9278;
+const std::uint32_t glRgb_c = 0x1907;
+const std::uint32_t glRgba_c = 0x1908;
+
+const char* ktxOrientationKey_c = "KTXorientation";
+const char* ktxOrientationValue_c = "S=r,T=u";
+
+std::uint32_t readUint32(const std::uint8_t* p, bool swap){
+	if(swap){
+		return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+	}
+	return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+}
+
+void appendUint32(std::vector<std::uint8_t>& buf, std::uint32_t v){
+	for(unsigned i = 0; i != 4; ++i){
+		buf.push_back(std::uint8_t(v));
+		v >>= 8;
+	}
+}
+
+//Find value of the key in KTX key and value data.
+//Returns empty string if there is no such key.
+std::string findKtxValue(const std::uint8_t* p, size_t size, bool swap, const char* key){
+	while(size >= 4){
+		size_t keyAndValueSize = readUint32(p, swap);
+		p += 4;
+		size -= 4;
+		if(keyAndValueSize > size){
+			throw morda::Exc("etc::loadKtx(): invalid key and value data");
+		}
+		
+		auto kv = reinterpret_cast<const char*>(p);
+		auto keyEnd = std::find(kv, kv + keyAndValueSize, '\0');
+		if(keyEnd != kv + keyAndValueSize && strcmp(kv, key) == 0){
+			return std::string(keyEnd + 1, std::find(keyEnd + 1, kv + keyAndValueSize, '\0'));
+		}
+		
+		//key and value pairs are padded to 4 bytes
+		size_t padded = std::min((keyAndValueSize + 3) / 4 * 4, size);
+		p += padded;
+		size -= padded;
+	}
+	return std::string();
+}
+
+}
+
+
+
+etc::CompressedImage etc::encode(const Image& image, ThreadPool* pool){
+	if(image.dim().x == 0 || image.dim().y == 0){
+		throw morda::Exc("etc::encode(): image is empty");
+	}
+	
+	bool hasAlpha;
+	switch(image.colorDepth()){
+		case Image::ColorDepth_e::GREY:
+		case Image::ColorDepth_e::RGB:
+			hasAlpha = false;
+			break;
+		case Image::ColorDepth_e::GREYA:
+		case Image::ColorDepth_e::RGBA:
+			hasAlpha = true;
+			break;
+		default:
+			throw morda::Exc("etc::encode(): unknown image color depth");
+	}
+	
+	CompressedImage ret;
+	ret.type = hasAlpha ? Texture2D::TexType_e::ETC2_RGBA8 : Texture2D::TexType_e::ETC2_RGB8;
+	ret.dim = image.dim();
+	ret.data.resize(Texture2D::dataSize(ret.type, ret.dim));
+	
+	unsigned blocksPerRow = (ret.dim.x + 3) / 4;
+	unsigned numBlockRows = (ret.dim.y + 3) / 4;
+	size_t blockSize = hasAlpha ? 16 : 8;
+	
+	forEachBlockRow(numBlockRows, pool, [&image, &ret, blocksPerRow, blockSize, hasAlpha](unsigned row){
+		auto src = image.buf();
+		unsigned numChannels = image.numChannels();
+		
+		for(unsigned bx = 0; bx != blocksPerRow; ++bx){
+			Block b;
+			for(unsigned i = 0; i != b.size(); ++i){
+				//pixels outside of the image are padded with the nearest edge pixels
+				unsigned x = std::min(bx * 4 + i % 4, ret.dim.x - 1);
+				unsigned y = std::min(row * 4 + i / 4, ret.dim.y - 1);
+				auto p = &src[(size_t(y) * ret.dim.x + x) * numChannels];
+				if(numChannels < 3){
+					b[i] = {{p[0], p[0], p[0], numChannels == 2 ? p[1] : 0xff}};
+				}else{
+					b[i] = {{p[0], p[1], p[2], numChannels == 4 ? p[3] : 0xff}};
+				}
+			}
+			
+			std::uint8_t* dst = &ret.data[(size_t(row) * blocksPerRow + bx) * blockSize];
+			if(hasAlpha){
+				writeBlock(dst, encodeAlphaBlock(b));
+				dst += 8;
+			}
+			writeBlock(dst, encodeColorBlock(b));
+		}
+	});
+	
+	return ret;
+}
+
+
+
+Image etc::decode(const CompressedImage& image, ThreadPool* pool){
+	bool hasAlpha;
+	switch(image.type){
+		case Texture2D::TexType_e::ETC2_RGB8:
+			hasAlpha = false;
+			break;
+		case Texture2D::TexType_e::ETC2_RGBA8:
+			hasAlpha = true;
+			break;
+		default:
+			throw morda::Exc("etc::decode(): unsupported compressed texture type");
+	}
+	
+	if(image.data.size() != Texture2D::dataSize(image.type, image.dim)){
+		throw morda::Exc("etc::decode(): compressed data size does not match image dimensions");
+	}
+	
+	Image ret(image.dim, hasAlpha ? Image::ColorDepth_e::RGBA : Image::ColorDepth_e::RGB);
+	
+	unsigned blocksPerRow = (image.dim.x + 3) / 4;
+	unsigned numBlockRows = (image.dim.y + 3) / 4;
+	size_t blockSize = hasAlpha ? 16 : 8;
+	
+	forEachBlockRow(numBlockRows, pool, [&image, &ret, blocksPerRow, blockSize, hasAlpha](unsigned row){
+		auto dst = ret.buf();
+		unsigned numChannels = ret.numChannels();
+		
+		for(unsigned bx = 0; bx != blocksPerRow; ++bx){
+			const std::uint8_t* src = &image.data[(size_t(row) * blocksPerRow + bx) * blockSize];
+			
+			Block b;
+			if(hasAlpha){
+				decodeAlphaBlock(readBlock(src), b);
+				src += 8;
+			}
+			decodeColorBlock(readBlock(src), b);
+			
+			//padding pixels of edge blocks are dropped
+			for(unsigned i = 0; i != b.size(); ++i){
+				unsigned x = bx * 4 + i % 4;
+				unsigned y = row * 4 + i / 4;
+				if(x >= image.dim.x || y >= image.dim.y){
+					continue;
+				}
+				auto p = &dst[(size_t(y) * image.dim.x + x) * numChannels];
+				for(unsigned c = 0; c != numChannels; ++c){
+					p[c] = std::uint8_t(b[i][c]);
+				}
+			}
+		}
+	});
+	
+	return ret;
+}
+
+
+
+etc::CompressedImage etc::loadKtx(const papki::File& fi){
+	MappedFile file(fi);
+	auto data = file.buf();
+	
+	const size_t headerSize = ktxIdentifier_c.size() + ktxNumHeaderFields_c * 4;
+	if(data.size() < headerSize || !std::equal(ktxIdentifier_c.begin(), ktxIdentifier_c.end(), data.begin())){
+		throw morda::Exc("etc::loadKtx(): not a KTX file");
+	}
+	
+	const std::uint8_t* p = &data[ktxIdentifier_c.size()];
+	
+	//file is written in the endianness of the writer, endianness field tells which one it is
+	bool swap;
+	if(readUint32(p, false) == ktxEndianness_c){
+		swap = false;
+	}else if(readUint32(p, true) == ktxEndianness_c){
+		swap = true;
+	}else{
+		throw morda::Exc("etc::loadKtx(): invalid endianness field");
+	}
+	
+	std::array<std::uint32_t, ktxNumHeaderFields_c> header;
+	for(unsigned i = 0; i != header.size(); ++i){
+		header[i] = readUint32(p + i * 4, swap);
+	}
+	
+	//header fields following endianness: glType, glTypeSize, glFormat, glInternalFormat, glBaseInternalFormat,
+	//pixelWidth, pixelHeight, pixelDepth, numberOfArrayElements, numberOfFaces, numberOfMipmapLevels, bytesOfKeyValueData
+	CompressedImage ret;
+	switch(header[4]){
+		case glCompressedRgb8Etc2_c:
+			ret.type = Texture2D::TexType_e::ETC2_RGB8;
+			break;
+		case glCompressedRgba8Etc2Eac_c:
+			ret.type = Texture2D::TexType_e::ETC2_RGBA8;
+			break;
+		default:
+			throw morda::Exc("etc::loadKtx(): unsupported texture format, only ETC2 RGB8 and RGBA8 are supported");
+	}
+	
+	if(header[8] > 1 || header[9] > 1 || header[10] != 1){
+		throw morda::Exc("etc::loadKtx(): only 2D textures are supported");
+	}
+	
+	ret.dim = kolme::Vec2ui(header[6], header[7]);
+	
+	size_t pos = headerSize + size_t(header[12]);
+	if(pos + 4 > data.size()){
+		throw morda::Exc("etc::loadKtx(): unexpected end of file");
+	}
+	
+	//Rows are returned as they are stored, so only bottom to top rows of left to right pixels are supported.
+	//Files without orientation are assumed to have it, as the ones written by saveKtx().
+	{
+		std::string orientation = findKtxValue(&data[headerSize], size_t(header[12]), swap, ktxOrientationKey_c);
+		if(orientation.find("S=l") != std::string::npos || orientation.find("T=d") != std::string::npos){
+			throw morda::Exc(std::string("etc::loadKtx(): unsupported orientation '") + orientation + "', only '" + ktxOrientationValue_c + "' is supported");
+		}
+	}
+	
+	size_t imageSize = readUint32(&data[pos], swap);
+	pos += 4;
+	if(imageSize != Texture2D::dataSize(ret.type, ret.dim) || pos + imageSize > data.size()){
+		throw morda::Exc("etc::loadKtx(): image size does not match texture dimensions");
+	}
+	
+	ret.data.assign(data.begin() + pos, data.begin() + pos + imageSize);
+	
+	return ret;
+}
+
+
+
+void etc::saveKtx(const CompressedImage& image, const papki::File& fo){
+	if(image.data.size() != Texture2D::dataSize(image.type, image.dim)){
+		throw morda::Exc("etc::saveKtx(): compressed data size does not match image dimensions");
+	}
+	
+	bool hasAlpha;
+	switch(image.type){
+		case Texture2D::TexType_e::ETC2_RGB8:
+			hasAlpha = false;
+			break;
+		case Texture2D::TexType_e::ETC2_RGBA8:
+			hasAlpha = true;
+			break;
+		default:
+			throw morda::Exc("etc::saveKtx(): unsupported compressed texture type");
+	}
+	
+	std::vector<std::uint8_t> keyValue;
+	keyValue.insert(keyValue.end(), ktxOrientationKey_c, ktxOrientationKey_c + strlen(ktxOrientationKey_c) + 1);
+	keyValue.insert(keyValue.end(), ktxOrientationValue_c, ktxOrientationValue_c + strlen(ktxOrientationValue_c) + 1);
+	
+	std::vector<std::uint8_t> buf(ktxIdentifier_c.begin(), ktxIdentifier_c.end());
+	appendUint32(buf, ktxEndianness_c);
+	appendUint32(buf, 0);//glType, 0 for compressed textures
+	appendUint32(buf, 1);//glTypeSize
+	appendUint32(buf, 0);//glFormat, 0 for compressed textures
+	appendUint32(buf, hasAlpha ? glCompressedRgba8Etc2Eac_c : glCompressedRgb8Etc2_c);
+	appendUint32(buf, hasAlpha ? glRgba_c : glRgb_c);
+	appendUint32(buf, image.dim.x);
+	appendUint32(buf, image.dim.y);
+	appendUint32(buf, 0);//pixelDepth
+	appendUint32(buf, 0);//numberOfArrayElements
+	appendUint32(buf, 1);//numberOfFaces
+	appendUint32(buf, 1);//numberOfMipmapLevels
+	
+	//key and value pairs are padded to 4 bytes
+	size_t keyValueSize = (keyValue.size() + 3) / 4 * 4;
+	appendUint32(buf, std::uint32_t(4 + keyValueSize));
+	appendUint32(buf, std::uint32_t(keyValue.size()));
+	buf.insert(buf.end(), keyValue.begin(), keyValue.end());
+	buf.resize(buf.size() + keyValueSize - keyValue.size(), 0);
+	
+	//size of compressed data is always multiple of 4, so no padding is needed after it
+	appendUint32(buf, std::uint32_t(image.data.size()));
+	buf.insert(buf.end(), image.data.begin(), image.data.end());
+	
+	papki::File::Guard fileGuard(fo, papki::File::E_Mode::CREATE);
+	fo.write(utki::wrapBuf(buf));
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <kolme/Vector2.hpp>
+
+#include <papki/File.hpp>
+
+#include "../render/Texture2D.hpp"
+
+#include "Image.hpp"
+
+
+namespace morda{
+
+class ThreadPool;
+
+/**
+ * @brief ETC2 texture compression.
+ * CPU encoder and decoder of ETC2 compressed texture data, see Texture2D::TexType_e::ETC2_RGB8 and Texture2D::TexType_e::ETC2_RGBA8.
+ * The encoder is meant for packing resources offline, it produces color blocks only in ETC1 compatible
+ * individual and differential modes, and EAC blocks for alpha. The decoder supports all ETC2 modes,
+ * it is used when the render backend does not support compressed textures.
+ */
+namespace etc{
+
+/**
+ * @brief Compressed image data.
+ */
+struct CompressedImage{
+	/**
+	 * @brief Compressed texture type.
+	 */
+	Texture2D::TexType_e type;
+	
+	/**
+	 * @brief Image dimensions in pixels.
+	 */
+	kolme::Vec2ui dim;
+	
+	/**
+	 * @brief Compressed data.
+	 * 4x4 pixel blocks, row by row. Blocks on the right and bottom edges are padded if image dimensions are not multiple of 4.
+	 */
+	std::vector<std::uint8_t> data;
+};
+
+/**
+ * @brief Compress image.
+ * Images without alpha channel are compressed to ETC2_RGB8, images with alpha channel are compressed to ETC2_RGBA8.
+ * Rows of compressed data go in the same order as in the image, so to get texture data the image needs to be
+ * flipped vertically before compressing, as it is done for uncompressed textures.
+ * @param image - image to compress.
+ * @param pool - thread pool to compress rows of blocks in parallel, nullptr to do all the work on calling thread.
+ * @return Compressed image.
+ */
+CompressedImage encode(const Image& image, ThreadPool* pool = nullptr);
+
+/**
+ * @brief Decompress image.
+ * @param image - compressed image.
+ * @param pool - thread pool to decompress rows of blocks in parallel, nullptr to do all the work on calling thread.
+ * @return RGB image for ETC2_RGB8 data and RGBA image for ETC2_RGBA8 data.
+ */
+Image decode(const CompressedImage& image, ThreadPool* pool = nullptr);
+
+/**
+ * @brief Load compressed image from KTX file.
+ * Only the first mipmap level of a 2D texture in one of the ETC2 formats is loaded.
+ * Compressed data is returned as stored, so only files with rows in bottom to top order, as written by saveKtx(),
+ * are supported. Files with other orientation are rejected, files without orientation are assumed to have the supported one.
+ * @param fi - file to load from.
+ * @return Compressed image.
+ */
+CompressedImage loadKtx(const papki::File& fi);
+
+/**
+ * @brief Save compressed image to KTX file.
+ * The file is marked as having rows in bottom to top order, i.e. it is assumed that the compressed image
+ * was made of a vertically flipped image, see encode().
+ * @param image - compressed image to save.
+ * @param fo - file to save to.
+ */
+void saveKtx(const CompressedImage& image, const papki::File& fo);
+
+}
+
+}
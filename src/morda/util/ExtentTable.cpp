@@ -0,0 +1,211 @@
+#include "ExtentTable.hpp"
+
+#include <utki/debug.hpp>
+
+#include <algorithm>
+
+
+using namespace morda;
+
+
+
+void ExtentTable::reset(size_t size){
+	this->extents.assign(size, real(-1));
+	this->sumTree.assign(size + 1, 0);
+	this->countTree.assign(size + 1, 0);
+	this->measuredSum = 0;
+	this->numMeasured = 0;
+}
+
+
+
+void ExtentTable::add(size_t index, double extent, std::int32_t count)noexcept{
+	for(size_t i = index + 1; i < this->sumTree.size(); i += i & (~i + 1)){
+		this->sumTree[i] += extent;
+		this->countTree[i] += count;
+	}
+	this->measuredSum += extent;
+	this->numMeasured += count;
+}
+
+
+
+void ExtentTable::set(size_t index, real extent)noexcept{
+	ASSERT(index < this->size())
+	ASSERT(extent >= 0)
+	
+	real& e = this->extents[index];
+	
+	if(e < 0){
+		this->add(index, double(extent), 1);
+	}else if(e != extent){
+		this->add(index, double(extent) - double(e), 0);
+	}
+	e = extent;
+}
+
+
+
+void ExtentTable::prefix(size_t index, double& sum, size_t& count)const noexcept{
+	sum = 0;
+	count = 0;
+	for(size_t i = index; i != 0; i -= i & (~i + 1)){
+		sum += this->sumTree[i];
+		count += this->countTree[i];
+	}
+}
+
+
+
+void ExtentTable::invalidate(size_t index)noexcept{
+	ASSERT(index < this->size())
+	
+	real& e = this->extents[index];
+	if(e >= 0){
+		this->add(index, -double(e), -1);
+		e = real(-1);
+	}
+}
+
+
+
+void ExtentTable::rebuild(){
+	this->sumTree.assign(this->extents.size() + 1, 0);
+	this->countTree.assign(this->extents.size() + 1, 0);
+	this->measuredSum = 0;
+	this->numMeasured = 0;
+	
+	//linear time construction of Fenwick trees
+	for(size_t i = 1; i < this->sumTree.size(); ++i){
+		real e = this->extents[i - 1];
+		if(e >= 0){
+			this->sumTree[i] += double(e);
+			++this->countTree[i];
+			this->measuredSum += double(e);
+			++this->numMeasured;
+		}
+		size_t parent = i + (i & (~i + 1));
+		if(parent < this->sumTree.size()){
+			this->sumTree[parent] += this->sumTree[i];
+			this->countTree[parent] += this->countTree[i];
+		}
+	}
+}
+
+
+
+void ExtentTable::insert(size_t index, size_t num){
+	ASSERT(index <= this->size())
+	
+	if(num == 0){
+		return;
+	}
+	
+	if(index != this->size()){
+		this->extents.insert(this->extents.begin() + index, num, real(-1));
+		this->rebuild();
+		return;
+	}
+	
+	//appending, only new tree nodes need to be computed,
+	//each of them covers a range which ends with new not measured items
+	size_t oldSize = this->size();
+	this->extents.resize(oldSize + num, real(-1));
+	this->sumTree.resize(this->extents.size() + 1);
+	this->countTree.resize(this->extents.size() + 1);
+	
+	for(size_t i = oldSize + 1; i < this->sumTree.size(); ++i){
+		this->sumTree[i] = 0;
+		this->countTree[i] = 0;
+		
+		//node i covers items (i - lowbit(i), i], collect the covered nodes
+		size_t low = i - (i & (~i + 1));
+		for(size_t j = i - 1; j > low; j -= j & (~j + 1)){
+			this->sumTree[i] += this->sumTree[j];
+			this->countTree[i] += this->countTree[j];
+		}
+	}
+}
+
+
+
+void ExtentTable::erase(size_t index, size_t num){
+	ASSERT(index + num <= this->size())
+	
+	if(num == 0){
+		return;
+	}
+	
+	this->extents.erase(this->extents.begin() + index, this->extents.begin() + index + num);
+	
+	//after removing from the end the remaining tree nodes are still valid
+	if(index == this->extents.size()){
+		this->sumTree.resize(this->extents.size() + 1);
+		this->countTree.resize(this->extents.size() + 1);
+		this->prefix(this->extents.size(), this->measuredSum, this->numMeasured);
+		return;
+	}
+	
+	this->rebuild();
+}
+
+
+
+void ExtentTable::move(size_t from, size_t to, size_t num){
+	ASSERT(from + num <= this->size())
+	ASSERT(to + num <= this->size())
+	
+	if(num == 0 || from == to){
+		return;
+	}
+	
+	auto b = this->extents.begin();
+	if(from < to){
+		std::rotate(b + from, b + from + num, b + to + num);
+	}else{
+		std::rotate(b + to, b + from, b + from + num);
+	}
+	
+	this->rebuild();
+}
+
+
+
+double ExtentTable::offset(size_t index)const noexcept{
+	ASSERT(index <= this->size())
+	
+	double sum;
+	size_t count;
+	this->prefix(index, sum, count);
+	
+	return sum + double(index - count) * double(this->estimate());
+}
+
+
+
+size_t ExtentTable::indexAt(double offset, double& itemOffset)const noexcept{
+	double est = double(this->estimate());
+	
+	size_t step = 1;
+	while(step * 2 <= this->size()){
+		step *= 2;
+	}
+	
+	//binary descent, pos is the number of items which end not after the offset
+	size_t pos = 0;
+	double rest = offset;
+	for(; step != 0; step /= 2){
+		size_t next = pos + step;
+		if(next > this->size()){
+			continue;
+		}
+		double v = this->sumTree[next] + double(step - this->countTree[next]) * est;
+		if(v <= rest){
+			pos = next;
+			rest -= v;
+		}
+	}
+	
+	itemOffset = rest;
+	return pos;
+}
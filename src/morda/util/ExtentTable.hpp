@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "../config.hpp"
+
+
+namespace morda{
+
+/**
+ * @brief Table of item extents.
+ * Holds extents (e.g. heights) of a sequence of items, some of which might not be measured yet.
+ * Extent of an item which is not measured is estimated as average extent of measured items.
+ * Offset of an item from the beginning of the sequence and index of an item by offset
+ * are found in O(log n) time.
+ */
+class ExtentTable{
+	//negative value means not measured
+	std::vector<real> extents;
+	
+	//Fenwick trees of measured extents and numbers of measured items, 1-based
+	std::vector<double> sumTree;
+	std::vector<std::uint32_t> countTree;
+	
+	double measuredSum = 0;
+	size_t numMeasured = 0;
+	
+	void add(size_t index, double extent, std::int32_t count)noexcept;
+	
+	void rebuild();
+	
+	void prefix(size_t index, double& sum, size_t& count)const noexcept;
+public:
+	/**
+	 * @brief Clear the table and set its size.
+	 * All items become not measured.
+	 * @param size - number of items.
+	 */
+	void reset(size_t size);
+	
+	/**
+	 * @brief Get number of items.
+	 * @return Number of items.
+	 */
+	size_t size()const noexcept{
+		return this->extents.size();
+	}
+	
+	/**
+	 * @brief Set item extent.
+	 * @param index - index of the item.
+	 * @param extent - measured extent of the item.
+	 */
+	void set(size_t index, real extent)noexcept;
+	
+	/**
+	 * @brief Mark item as not measured.
+	 * @param index - index of the item.
+	 */
+	void invalidate(size_t index)noexcept;
+	
+	/**
+	 * @brief Insert not measured items.
+	 * Appending items to the end takes O(k log n) time, inserting in the middle takes O(n) time.
+	 * @param index - index to insert items at, can be equal to size().
+	 * @param num - number of items to insert.
+	 */
+	void insert(size_t index, size_t num);
+	
+	/**
+	 * @brief Remove items.
+	 * @param index - index of the first item to remove.
+	 * @param num - number of items to remove.
+	 */
+	void erase(size_t index, size_t num);
+	
+	/**
+	 * @brief Move items.
+	 * Extents of the moved items are preserved.
+	 * @param from - index of the first item to move.
+	 * @param to - index of the first moved item after the move.
+	 * @param num - number of items to move.
+	 */
+	void move(size_t from, size_t to, size_t num);
+	
+	/**
+	 * @brief Check if item is measured.
+	 * @param index - index of the item.
+	 * @return true if extent of the item is known.
+	 * @return false otherwise.
+	 */
+	bool isMeasured(size_t index)const noexcept{
+		return this->extents[index] >= 0;
+	}
+	
+	/**
+	 * @brief Get estimated extent of not measured item.
+	 * @return Average extent of measured items.
+	 */
+	real estimate()const noexcept{
+		if(this->numMeasured == 0){
+			return 0;
+		}
+		return real(this->measuredSum / double(this->numMeasured));
+	}
+	
+	/**
+	 * @brief Get item extent.
+	 * @param index - index of the item.
+	 * @return Measured or estimated extent of the item.
+	 */
+	real extent(size_t index)const noexcept{
+		if(this->isMeasured(index)){
+			return this->extents[index];
+		}
+		return this->estimate();
+	}
+	
+	/**
+	 * @brief Get offset of item.
+	 * @param index - index of the item, can be equal to size().
+	 * @return Sum of extents of all the items before the given one.
+	 */
+	double offset(size_t index)const noexcept;
+	
+	/**
+	 * @brief Get total extent.
+	 * @return Sum of extents of all items.
+	 */
+	double total()const noexcept{
+		return this->measuredSum + double(this->size() - this->numMeasured) * double(this->estimate());
+	}
+	
+	/**
+	 * @brief Find item by offset.
+	 * @param offset - offset from the beginning of the sequence.
+	 * @param itemOffset - returns offset within the found item.
+	 * @return Index of the item containing the given offset.
+	 *         size() if the offset is beyond the end of the sequence.
+	 */
+	size_t indexAt(double offset, double& itemOffset)const noexcept;
+};
+
+}
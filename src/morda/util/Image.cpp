@@ -5,7 +5,9 @@
 
 
 #include <cstring>
+#include <cmath>
 #include <algorithm>
+#include <functional>
 
 #include <utki/Exc.hpp>
 
@@ -21,6 +23,10 @@ extern "C"{
 
 
 #include "Image.hpp"
+#include "ImageKernels.hpp"
+#include "MappedFile.hpp"
+
+#include "../ThreadPool.hpp"
 
 
 
@@ -89,24 +95,32 @@ void Image::reset(){
 
 
 
-//====================================================
-//============Flip Image vertical method==============
-//====================================================
-//Flips vertically current image
 void Image::flipVertical(){
 	if(!this->buf_v.size()){
 		return;//nothing to flip
 	}
+	
+	imageKernels::flipVertical(&*this->buf_v.begin(), this->numChannels() * this->dim().x, this->dim().y);
+}
+
+
+
+void Image::premultiplyAlpha(){
+	if(!this->buf_v.size()){
+		return;
+	}
+	
+	imageKernels::premultiplyAlpha(&*this->buf_v.begin(), this->numChannels(), this->dim().x * this->dim().y);
+}
 
-	unsigned stride = this->numChannels() * this->dim().x;//stride
-	std::vector<std::uint8_t> line(stride);
 
-	//TODO: use iterators
-	for(unsigned i = 0; i < this->dim().y / 2; ++i){
-		memcpy(&*line.begin(), &*this->buf_v.begin() + stride * i, stride);//move line to temp
-		memcpy(&*this->buf_v.begin() + stride * i, &*this->buf_v.begin() + stride * (this->dim().y - i - 1), stride);//move bottom line to top
-		memcpy(&*this->buf_v.begin() + stride * (this->dim().y - i - 1), &*line.begin(), stride);
+
+void Image::swapRedBlue(){
+	if(!this->buf_v.size()){
+		return;
 	}
+	
+	imageKernels::swapRedBlue(&*this->buf_v.begin(), this->numChannels(), this->dim().x * this->dim().y);
 }
 
 
@@ -119,28 +133,15 @@ void Image::blit(unsigned x, unsigned y, const Image& src){
 
 	unsigned blitAreaW = std::min(src.dim().x, this->dim().x - x);
 	unsigned blitAreaH = std::min(src.dim().y, this->dim().y - y);
-
-	//TODO: implement blitting for all image types
-	switch(this->colorDepth()){
-		case ColorDepth_e::GREY:
-			for(unsigned j = 0; j < blitAreaH; ++j){
-				for(unsigned i = 0; i < blitAreaW; ++i){
-					this->pixChan(i + x, j + y, 0) = src.pixChan(i, j, 0);
-				}
-			}
-			break;
-		case ColorDepth_e::GREYA:
-			for(unsigned j = 0; j < blitAreaH; ++j){
-				for(unsigned i = 0; i < blitAreaW; ++i){
-					this->pixChan(i + x, j + y, 0) = src.pixChan(i, j, 0);
-					this->pixChan(i + x, j + y, 1) = src.pixChan(i, j, 1);
-				}
-			}
-			break;
-		default:
-			ASSERT_INFO(false, "Image::Blit(): unknown image type")
-			break;
-	}//~switch(type)
+	
+	if(blitAreaW == 0){
+		return;
+	}
+	
+	//pixels of one row are contiguous for any color depth
+	for(unsigned j = 0; j < blitAreaH; ++j){
+		memcpy(&this->pixChan(x, j + y, 0), &src.pixChan(0, j, 0), blitAreaW * this->numChannels());
+	}
 }
 
 
@@ -157,36 +158,541 @@ void Image::blit(unsigned x, unsigned y, const Image& src, unsigned dstChan, uns
 
 	unsigned blitAreaW = std::min(src.dim().x, this->dim().x - x);
 	unsigned blitAreaH = std::min(src.dim().y, this->dim().y - y);
+	
+	if(blitAreaW == 0){
+		return;
+	}
 
 	for(unsigned j = 0; j < blitAreaH; ++j){
-		for(unsigned i = 0; i < blitAreaW; ++i){
-			this->pixChan(i + x, j + y, dstChan) = src.pixChan(i, j, srcChan);
+		imageKernels::copyChannel(&this->pixChan(x, j + y, dstChan), this->numChannels(), &src.pixChan(0, j, srcChan), src.numChannels(), blitAreaW);
+	}
+}
+
+
+
+void Image::blitIfGreater(unsigned x, unsigned y, const Image& src, unsigned dstChan, unsigned srcChan){
+	ASSERT(this->buf_v.size())
+	if(dstChan >= this->numChannels()){
+		throw utki::Exc("Image::blitIfGreater(): destination channel index is greater than number of channels in the image");
+	}
+
+	if(srcChan >= src.numChannels()){
+		throw utki::Exc("Image::blitIfGreater(): source channel index is greater than number of channels in the image");
+	}
+
+	unsigned blitAreaW = std::min(src.dim().x, this->dim().x - x);
+	unsigned blitAreaH = std::min(src.dim().y, this->dim().y - y);
+	
+	if(blitAreaW == 0){
+		return;
+	}
+
+	for(unsigned j = 0; j < blitAreaH; ++j){
+		imageKernels::maxChannel(&this->pixChan(x, j + y, dstChan), this->numChannels(), &src.pixChan(0, j, srcChan), src.numChannels(), blitAreaW);
+	}
+}
+
+
+
+namespace{
+
+//Contributions of source pixels to destination pixels along one axis.
+struct Weights{
+	//maximum number of source pixels contributing to one destination pixel
+	size_t stride;
+	
+	//index of the first contributing source pixel for each destination pixel
+	std::vector<unsigned> first;
+	
+	//number of contributing source pixels for each destination pixel
+	std::vector<unsigned> num;
+	
+	//'stride' weights for each destination pixel
+	std::vector<float> weights;
+	
+	//Window is the part of the source, in source pixels, which is resampled to the whole destination.
+	Weights(unsigned srcSize, double windowPos, double windowSize, unsigned dstSize, Image::Filter_e filter){
+		const double pi = 3.14159265358979323846;
+		
+		double radius = filter == Image::Filter_e::LANCZOS ? 3 : 0.5;
+		
+		auto f = [filter, radius, pi](double x) -> double{
+			if(filter == Image::Filter_e::BOX){
+				return -0.5 <= x && x < 0.5 ? 1 : 0;
+			}
+			
+			if(x <= -radius || radius <= x){
+				return 0;
+			}
+			if(x == 0){
+				return 1;
+			}
+			double px = pi * x;
+			return radius * std::sin(px) * std::sin(px / radius) / (px * px);
+		};
+		
+		double scale = windowSize / double(dstSize);
+		
+		//when downscaling the filter is stretched to cover all source pixels
+		double filterScale = std::max(scale, 1.0);
+		double support = radius * filterScale;
+		
+		this->stride = size_t(std::ceil(support * 2)) + 2;
+		this->first.resize(dstSize);
+		this->num.resize(dstSize);
+		this->weights.assign(dstSize * this->stride, 0);
+		
+		for(unsigned i = 0; i != dstSize; ++i){
+			double center = windowPos + (i + 0.5) * scale;
+			int left = std::max(int(std::floor(center - support)), 0);
+			int right = std::min(int(std::ceil(center + support)), int(srcSize));
+			
+			float* w = &this->weights[i * this->stride];
+			
+			double sum = 0;
+			unsigned n = 0;
+			for(int j = left; j < right; ++j){
+				double v = f((j + 0.5 - center) / filterScale);
+				if(n == 0 && v == 0){
+					//skip leading zero weights
+					++left;
+					continue;
+				}
+				ASSERT(n < this->stride)
+				w[n] = float(v);
+				sum += v;
+				++n;
+			}
+			
+			//drop trailing zero weights
+			for(; n != 0 && w[n - 1] == 0; --n){}
+			
+			if(n == 0 || sum == 0){
+				//can only happen for extreme scale factors due to rounding, take nearest pixel
+				left = std::max(std::min(int(center), int(srcSize) - 1), 0);
+				w[0] = 1;
+				n = 1;
+				sum = 1;
+			}
+			
+			for(unsigned j = 0; j != n; ++j){
+				w[j] = float(w[j] / sum);
+			}
+			
+			this->first[i] = unsigned(left);
+			this->num[i] = n;
+		}
+	}
+};
+
+//process rows in chunks of this size, to have tasks big enough
+const unsigned rowsPerTask_c = 16;
+
+void forEachChunk(unsigned numRows, ThreadPool* pool, const std::function<void(unsigned, unsigned)>& f){
+	unsigned numChunks = (numRows + rowsPerTask_c - 1) / rowsPerTask_c;
+	
+	auto chunk = [numRows, &f](size_t i){
+		unsigned begin = unsigned(i) * rowsPerTask_c;
+		f(begin, std::min(begin + rowsPerTask_c, numRows));
+	};
+	
+	if(pool && numChunks > 1){
+		pool->parallelFor(numChunks, chunk);
+	}else{
+		for(unsigned i = 0; i != numChunks; ++i){
+			chunk(i);
 		}
 	}
 }
 
 
+//Separable resampler. Source rows are resampled horizontally as they are added.
+//When rows are streamed, each destination row is emitted as soon as all its source rows are added and only the source rows
+//which are still needed are kept, so that decoders can stream rows to it without keeping the whole source or destination image.
+class Resampler{
+	kolme::Vec2ui srcDim;
+	kolme::Vec2ui dstDim;
+	
+	unsigned numChannels;
+	bool hasAlpha;
+	unsigned alpha;
+	
+	Weights hWeights;
+	Weights vWeights;
+	
+	size_t dstStride;
+	
+	//number of kept source rows, source row y is kept at index y % numKeptRows
+	unsigned numKeptRows;
+	
+	//source rows resampled horizontally
+	std::vector<float> rows;
+	
+	//number of source rows streamed so far
+	unsigned numStreamed = 0;
+	
+	//number of destination rows emitted so far
+	unsigned numEmitted = 0;
+	
+	//buffers for streamed rows
+	std::vector<float> streamSrc;
+	std::vector<float> streamAcc;
+	std::vector<std::uint8_t> streamDst;
+	
+	//Destination rows are emitted in order, each one when the last source row needed by it or by preceding rows is added.
+	//Source rows needed by this and following destination rows have to be kept at that moment.
+	static unsigned numStreamedRowsToKeep(const Weights& w){
+		std::vector<unsigned> minFirst(w.first.size());
+		unsigned m = unsigned(-1);
+		for(size_t i = w.first.size(); i != 0; --i){
+			m = std::min(m, w.first[i - 1]);
+			minFirst[i - 1] = m;
+		}
+		
+		unsigned end = 0;
+		unsigned ret = 1;
+		for(size_t i = 0; i != w.first.size(); ++i){
+			end = std::max(end, w.first[i] + w.num[i]);
+			ret = std::max(ret, end - minFirst[i]);
+		}
+		return ret;
+	}
+	
+	void resampleRow(unsigned y, float* acc, std::uint8_t* dst)const{
+		std::fill(acc, acc + this->dstStride, 0.0f);
+		
+		const float* w = &this->vWeights.weights[y * this->vWeights.stride];
+		for(unsigned j = 0; j != this->vWeights.num[y]; ++j){
+			imageKernels::addWeighted(acc, &this->rows[((this->vWeights.first[y] + j) % this->numKeptRows) * this->dstStride], w[j], this->dstStride);
+		}
+		
+		if(this->hasAlpha){
+			for(auto a = acc; a != acc + this->dstStride; a += this->numChannels){
+				if(a[this->alpha] <= 0){
+					continue;
+				}
+				float mul = 255 / a[this->alpha];
+				for(unsigned c = 0; c != this->alpha; ++c){
+					a[c] *= mul;
+				}
+			}
+		}
+		
+		imageKernels::floatsToBytes(dst, acc, this->dstStride);
+	}
+
+public:
+	Resampler(kolme::Vec2ui srcDim, kolme::Vec2d windowPos, kolme::Vec2d windowDim, kolme::Vec2ui dstDim, unsigned numChannels, Image::Filter_e filter, bool streamed) :
+			srcDim(srcDim),
+			dstDim(dstDim),
+			numChannels(numChannels),
+			hasAlpha(numChannels == 2 || numChannels == 4),
+			alpha(numChannels - 1),
+			hWeights(srcDim.x, windowPos.x, windowDim.x, dstDim.x, filter),
+			vWeights(srcDim.y, windowPos.y, windowDim.y, dstDim.y, filter),
+			dstStride(dstDim.x * numChannels),
+			numKeptRows(streamed ? std::min(numStreamedRowsToKeep(this->vWeights), srcDim.y) : srcDim.y),
+			rows(this->numKeptRows * this->dstStride)
+	{
+		if(streamed){
+			this->streamAcc.resize(this->dstStride);
+			this->streamDst.resize(this->dstStride);
+		}
+	}
+	
+	//Different rows can be added from different threads, each thread needs its own 'src' buffer.
+	//Rows can only be added in arbitrary order if all source rows are kept.
+	void addRow(unsigned y, const std::uint8_t* p, std::vector<float>& src){
+		ASSERT(y < this->srcDim.y)
+		
+		src.resize(this->srcDim.x * this->numChannels);
+		
+		if(this->hasAlpha){
+			for(auto s = src.begin(); s != src.end(); s += this->numChannels, p += this->numChannels){
+				float a = p[this->alpha];
+				for(unsigned c = 0; c != this->alpha; ++c){
+					s[c] = p[c] * a / 255;
+				}
+				s[this->alpha] = a;
+			}
+		}else{
+			std::copy(p, p + src.size(), src.begin());
+		}
+		
+		float* dst = &this->rows[(y % this->numKeptRows) * this->dstStride];
+		for(unsigned x = 0; x != this->hWeights.first.size(); ++x){
+			const float* w = &this->hWeights.weights[x * this->hWeights.stride];
+			const float* s = &src[this->hWeights.first[x] * this->numChannels];
+			
+			for(unsigned c = 0; c != this->numChannels; ++c){
+				dst[c] = 0;
+			}
+			for(unsigned j = 0; j != this->hWeights.num[x]; ++j, s += this->numChannels){
+				for(unsigned c = 0; c != this->numChannels; ++c){
+					dst[c] += s[c] * w[j];
+				}
+			}
+			dst += this->numChannels;
+		}
+	}
+	
+	//Add next source row of streamed resampler and emit destination rows which have all their source rows added.
+	void streamRow(const std::uint8_t* p, const std::function<void(const std::uint8_t*)>& emit){
+		ASSERT(this->numStreamed < this->srcDim.y)
+		ASSERT(this->streamDst.size() == this->dstStride)
+		
+		if(this->numEmitted == this->dstDim.y){
+			//rest of source rows are not needed
+			++this->numStreamed;
+			return;
+		}
+		
+		this->addRow(this->numStreamed, p, this->streamSrc);
+		++this->numStreamed;
+		
+		for(; this->numEmitted != this->dstDim.y; ++this->numEmitted){
+			if(this->vWeights.first[this->numEmitted] + this->vWeights.num[this->numEmitted] > this->numStreamed){
+				break;
+			}
+			this->resampleRow(this->numEmitted, &*this->streamAcc.begin(), &*this->streamDst.begin());
+			emit(&*this->streamDst.begin());
+		}
+	}
+	
+	//Do the vertical pass, all source rows must be added before.
+	Image finish(Image::ColorDepth_e colorDepth, ThreadPool* pool)const{
+		ASSERT(unsigned(colorDepth) == this->numChannels)
+		ASSERT(this->numKeptRows == this->srcDim.y)
+		
+		Image ret(this->dstDim, colorDepth);
+		
+		forEachChunk(this->dstDim.y, pool, [this, &ret](unsigned begin, unsigned end){
+			std::vector<float> acc(this->dstStride);
+			
+			for(unsigned y = begin; y != end; ++y){
+				this->resampleRow(y, &*acc.begin(), &ret.pixChan(0, y, 0));
+			}
+		});
+		
+		return ret;
+	}
+};
+
+
+
+//Region of the image to decode and dimensions to resample it to.
+struct Region{
+	kolme::Vec2ui pos;
+	kolme::Vec2ui dim;
+	kolme::Vec2ui target;
+	
+	//Exact requested region relative to the decoded one, differs from the decoded region when
+	//the image is downscaled by decoder and the region is not aligned to scaled pixels.
+	kolme::Vec2d windowPos;
+	kolme::Vec2d windowDim;
+	
+	Region(){}
+	
+	Region(kolme::Vec2ui imageDim, const Image::LoadOptions& options){
+		if(options.crop.d.x == 0 || options.crop.d.y == 0){
+			this->pos.set(0);
+			this->dim = imageDim;
+		}else{
+			if(options.crop.p.x >= imageDim.x || options.crop.p.y >= imageDim.y){
+				throw Image::IllegalArgumentExc("Image: crop region is outside of the image");
+			}
+			this->pos = options.crop.p;
+			this->dim.x = std::min(options.crop.d.x, imageDim.x - this->pos.x);
+			this->dim.y = std::min(options.crop.d.y, imageDim.y - this->pos.y);
+		}
+		
+		this->target = options.dim;
+		if(this->target.x == 0 && this->target.y == 0){
+			this->target = this->dim;
+		}else if(this->target.x == 0){
+			this->target.x = std::max(unsigned(std::round(double(this->dim.x) * this->target.y / this->dim.y)), 1u);
+		}else if(this->target.y == 0){
+			this->target.y = std::max(unsigned(std::round(double(this->dim.y) * this->target.x / this->dim.x)), 1u);
+		}
+		
+		this->windowPos.set(0);
+		this->windowDim = this->dim.to<double>();
+	}
+	
+	//Same region in the image downscaled by given factor, libjpeg rounds scaled dimensions up.
+	Region scaled(unsigned denom)const{
+		Region ret;
+		ret.pos = this->pos / denom;
+		ret.dim = (this->pos + this->dim + kolme::Vec2ui(denom - 1)) / denom - ret.pos;
+		ret.target = this->target;
+		ret.windowPos = this->pos.to<double>() / double(denom) - ret.pos.to<double>();
+		ret.windowDim = this->dim.to<double>() / double(denom);
+		return ret;
+	}
+	
+	bool needsResampling()const noexcept{
+		return this->dim != this->target || this->windowPos != kolme::Vec2d(0) || this->windowDim != this->dim.to<double>();
+	}
+};
+
+
+
+//Receives decoded rows of the region and puts them to the image, resampling if needed.
+//If band listener is given, the image holds only the current band and full bands are passed to the listener.
+class RowSink{
+	Image& image;
+	Image::ColorDepth_e colorDepth;
+	
+	Image::BandListener* listener;
+	unsigned bandHeight;
+	kolme::Vec2ui dim;
+	
+	std::unique_ptr<Resampler> resampler;
+	
+	//number of rows of the loaded image put so far
+	unsigned y = 0;
+	
+	//index of the first row of the current band
+	unsigned bandBegin = 0;
+	
+	void startBand(){
+		this->bandBegin = this->y;
+		this->image.init(kolme::Vec2ui(this->dim.x, std::min(this->bandHeight, this->dim.y - this->y)), this->colorDepth);
+	}
+	
+	void put(const std::uint8_t* row){
+		ASSERT(this->y < this->dim.y)
+		
+		memcpy(&this->image.pixChan(0, this->y - this->bandBegin, 0), row, this->image.dim().x * this->image.numChannels());
+		++this->y;
+		
+		if(this->listener && this->y - this->bandBegin == this->image.dim().y){
+			this->listener->onBand(this->image, this->bandBegin);
+			if(this->y != this->dim.y){
+				this->startBand();
+			}
+		}
+	}
+public:
+	RowSink(Image& image, Image::ColorDepth_e colorDepth, const Region& region, Image::BandListener* listener, unsigned bandHeight) :
+			image(image),
+			colorDepth(colorDepth),
+			listener(listener),
+			bandHeight(std::max(bandHeight, 1u)),
+			dim(region.target)
+	{
+		if(this->listener){
+			this->listener->onBegin(this->dim, colorDepth);
+		}
+		
+		if(region.needsResampling()){
+			this->resampler = std::unique_ptr<Resampler>(new Resampler(
+					region.dim,
+					region.windowPos,
+					region.windowDim,
+					region.target,
+					unsigned(colorDepth),
+					Image::Filter_e::LANCZOS,
+					true
+				));
+		}
+		
+		if(this->listener){
+			this->startBand();
+		}else{
+			this->image.init(this->dim, colorDepth);
+		}
+	}
+	
+	//row points to the first pixel of the region in a decoded row
+	void push(const std::uint8_t* row){
+		if(this->resampler){
+			this->resampler->streamRow(
+					row,
+					[this](const std::uint8_t* r){
+						this->put(r);
+					}
+				);
+			return;
+		}
+		
+		this->put(row);
+	}
+	
+	void finish(){
+		ASSERT(this->y == this->dim.y)
+		this->resampler.reset();
+	}
+};
+
+}
+
+
+
+Image Image::resize(kolme::Vec2ui dimensions, Filter_e filter, ThreadPool* pool)const{
+	if(this->dim().x == 0 || this->dim().y == 0 || dimensions.x == 0 || dimensions.y == 0){
+		throw Image::IllegalArgumentExc("Image::resize(): zero dimensions");
+	}
+	
+	if(dimensions == this->dim()){
+		return *this;
+	}
+	
+	Resampler resampler(this->dim(), kolme::Vec2d(0), this->dim().to<double>(), dimensions, this->numChannels(), filter, false);
+	
+	forEachChunk(this->dim().y, pool, [this, &resampler](unsigned begin, unsigned end){
+		std::vector<float> src;
+		for(unsigned y = begin; y != end; ++y){
+			resampler.addRow(y, &this->pixChan(0, y, 0), src);
+		}
+	});
+	
+	return resampler.finish(this->colorDepth(), pool);
+}
+
+
+
+std::vector<Image> Image::mipChain(ThreadPool* pool)const{
+	std::vector<Image> ret;
+	
+	for(kolme::Vec2ui d = this->dim(); d.x > 1 || d.y > 1;){
+		d.x = std::max(d.x / 2, 1u);
+		d.y = std::max(d.y / 2, 1u);
+		
+		const Image& prev = ret.size() == 0 ? *this : ret.back();
+		Image level = prev.resize(d, Filter_e::BOX, pool);
+		ret.push_back(std::move(level));
+	}
+	
+	return ret;
+}
+
+
 
 //================================\      /====\      /=PPPP===N===N===GGGG====|
 //=================================\    /======\    /==P===P==NN==N==G========|
 //======Read PNG file method========|--|========|--|===PPPP===N=N=N==G==GG====|
 //=================================/    \======/    \==P======N==NN==G===G====|
 //================================/      \====/      \=P======N===N===GGG=====|
-//custom file read function for PNG
+//custom read function for PNG, reads from file contents mapped to memory
 namespace{
 
-void PNG_CustomReadFunction(png_structp pngPtr, png_bytep data, png_size_t length){
-	papki::File* fi = reinterpret_cast<papki::File*>(png_get_io_ptr(pngPtr));
-	ASSERT(fi)
-//	TRACE(<< "PNG_CustomReadFunction: fi = " << fi << " pngPtr = " << pngPtr << " data = " << std::hex << data << " length = " << length << std::endl)
-	try{
-		utki::Buf<png_byte> bufWrapper(data, size_t(length));
-		fi->read(bufWrapper);
-//		TRACE(<< "PNG_CustomReadFunction: fi->Read() finished" << std::endl)
-	}catch(...){
-		//do not let any exception get out of this function
-//		TRACE(<< "PNG_CustomReadFunction: fi->Read() failed" << std::endl)
-	}
+struct PNGMemorySource{
+	const png_byte* data;
+	size_t size;
+};
+
+void PNG_MemoryReadFunction(png_structp pngPtr, png_bytep data, png_size_t length){
+	PNGMemorySource* src = reinterpret_cast<PNGMemorySource*>(png_get_io_ptr(pngPtr));
+	ASSERT(src)
+	
+	size_t n = std::min(size_t(length), src->size);
+	memcpy(data, src->data, n);
+	src->data += n;
+	src->size -= n;
+	
+	//truncated file, there is no way to report an error from here without longjmp, so give zeros
+	memset(data + n, 0, size_t(length) - n);
 }
 
 }//~namespace
@@ -194,29 +700,18 @@ void PNG_CustomReadFunction(png_structp pngPtr, png_bytep data, png_size_t lengt
 
 
 //Read PNG file method
-void Image::loadPNG(const papki::File& fi){
+void Image::loadPNG(const papki::File& fi, const LoadOptions& options, BandListener* listener, unsigned bandHeight){
 	ASSERT(!fi.isOpened())
 
 	if(this->buf_v.size() > 0){
 		this->reset();
 	}
 
-	papki::File::Guard fileGuard(fi);//this will guarantee that the file will be closed upon exit
-//	TRACE(<< "Image::LoadPNG(): file opened" << std::endl)
+	MappedFile file(fi);//file contents are decoded right from memory, without copying
+//	TRACE(<< "Image::LoadPNG(): file mapped" << std::endl)
 
 #define PNGSIGSIZE 8 //The size of PNG signature (max 8 bytes)
-	std::array<png_byte, PNGSIGSIZE> sig;
-	memset(&*sig.begin(), 0, sig.size() * sizeof(sig[0]));
-
-	{
-#ifdef DEBUG
-		auto ret = //TODO: we should not rely on that it will always read the requested number of bytes
-#endif
-		fi.read(utki::wrapBuf(sig));
-		ASSERT(ret == sig.size() * sizeof(sig[0]))
-	}
-
-	if(png_sig_cmp(&*sig.begin(), 0, sig.size() * sizeof(sig[0])) != 0){//if it is not a PNG-file
+	if(file.size() < PNGSIGSIZE || png_sig_cmp(const_cast<png_bytep>(file.data()), 0, PNGSIGSIZE) != 0){//if it is not a PNG-file
 		throw Image::Exc("Image::LoadPNG(): not a PNG file");
 	}
 
@@ -231,8 +726,9 @@ void Image::loadPNG(const papki::File& fi){
 
 	png_set_sig_bytes(pngPtr, PNGSIGSIZE);//We've already read PNGSIGSIZE bytes
 
-	//Set custom "ReadFromFile" function
-	png_set_read_fn(pngPtr, const_cast<papki::File*>(&fi), PNG_CustomReadFunction);
+	//Set custom "ReadFromMemory" function
+	PNGMemorySource pngSource = {file.data() + PNGSIGSIZE, file.size() - PNGSIGSIZE};
+	png_set_read_fn(pngPtr, &pngSource, PNG_MemoryReadFunction);
 
 	png_read_info(pngPtr, infoPtr);//Read in all information about file
 
@@ -267,6 +763,9 @@ void Image::loadPNG(const papki::File& fi){
 		png_set_gamma(pngPtr, 2.2, 0.45455);//set to 0.45455 otherwise (good guess for GIF images on PCs)
 	}
 
+	//interlaced images are decoded in several passes over all rows
+	int numPasses = png_set_interlace_handling(pngPtr);
+	
 	//update info after all transformations
 	png_read_update_info(pngPtr, infoPtr);
 	//get all dimensions and color info again
@@ -294,39 +793,62 @@ void Image::loadPNG(const papki::File& fi){
 	}
 	//Great! Number of channels and bits per pixel are initialized now!
 
-	//set image dimensions and set buffer size
-	this->init(kolme::Vec2ui(width, height), imageType);//Set buf array size (allocate memory)
-	//Great! height and width are initialized and buffer memory allocated
-
-//	TRACE(<< "Image::LoadPNG(): memory for image allocated" << std::endl)
+	Region region;
+	try{
+		region = Region(kolme::Vec2ui(width, height), options);
+	}catch(...){
+		png_destroy_read_struct(&pngPtr, &infoPtr, 0);
+		throw;
+	}
 
 	//Read image data
 	png_size_t bytesPerRow = png_get_rowbytes(pngPtr, infoPtr);//get bytes per row
 
 	//check that our expectations are correct
-	if(bytesPerRow != this->dim().x * this->numChannels()){
+	if(bytesPerRow != width * unsigned(imageType)){
 		throw Image::Exc("Image::LoadPNG(): number of bytes per row does not match expected value");
 	}
 
-	ASSERT((bytesPerRow * height) == this->buf_v.size())
+	if(!listener && numPasses == 1 && !region.needsResampling() && region.dim.x == width){
+		//rows of the region are contiguous in the image, read them directly to the image buffer
+		this->init(region.dim, imageType);
 
-//	TRACE(<< "Image::LoadPNG(): going to read in the data" << std::endl)
-	{
-		ASSERT(this->dim().y && this->buf_v.size())
-		std::vector<png_bytep> rows(this->dim().y);
-		//initialize row pointers
-//		M_IMAGE_PRINT(<< "Image::LoadPNG(): this->buf.Buf() = " << std::hex << this->buf.Buf() << std::endl)
-		for(unsigned i = 0; i < this->dim().y; ++i){
-			rows[i] = &*this->buf_v.begin() + i * bytesPerRow;
-//			M_IMAGE_PRINT(<< "Image::LoadPNG(): rows[i] = " << std::hex << rows[i] << std::endl)
+		std::vector<png_byte> skipped(bytesPerRow);
+		for(unsigned i = 0; i != region.pos.y; ++i){
+			png_read_row(pngPtr, &*skipped.begin(), 0);
+		}
+		for(unsigned i = 0; i != region.dim.y; ++i){
+			png_read_row(pngPtr, &this->pixChan(0, i, 0), 0);
+		}
+	}else{
+		RowSink sink(*this, imageType, region, listener, bandHeight);
+		
+		if(numPasses == 1){
+			//stream rows to the sink one by one, rows below the region are not decoded at all
+			std::vector<png_byte> row(bytesPerRow);
+			for(unsigned i = 0; i != region.pos.y + region.dim.y; ++i){
+				png_read_row(pngPtr, &*row.begin(), 0);
+				if(i >= region.pos.y){
+					sink.push(&*row.begin() + region.pos.x * unsigned(imageType));
+				}
+			}
+		}else{
+			//interlaced image needs all rows in memory
+			std::vector<png_byte> buf(bytesPerRow * height);
+			std::vector<png_bytep> rows(height);
+			for(unsigned i = 0; i != height; ++i){
+				rows[i] = &*buf.begin() + i * bytesPerRow;
+			}
+			png_read_image(pngPtr, &*rows.begin());
+			for(unsigned i = 0; i != region.dim.y; ++i){
+				sink.push(rows[region.pos.y + i] + region.pos.x * unsigned(imageType));
+			}
 		}
-//		TRACE(<< "Image::LoadPNG(): row pointers are set" << std::endl)
-		//Read in image data!
-		png_read_image(pngPtr, &*rows.begin());
-//		TRACE(<< "Image::LoadPNG(): image data read" << std::endl)
-	}
 
-	png_destroy_read_struct(&pngPtr,0,0);//free libpng memory
+		sink.finish();
+	}
+	
+	png_destroy_read_struct(&pngPtr, &infoPtr, 0);//free libpng memory
 }//~Image::LoadPNG()
 
 
@@ -347,57 +869,46 @@ void Image::loadPNG(const papki::File& fi){
 namespace{
 
 
-const size_t DJpegInputBufferSize = 4096;
-
-
-
+//JPEG source reading from file contents mapped to memory
 struct DataManagerJPEGSource{
 	jpeg_source_mgr pub;
-	papki::File *fi;
-	JOCTET *buffer;
-	bool sof;//true if the file was just opened
+	const JOCTET* data;
+	size_t size;
+	JOCTET eoi[2];//fake end of image marker given out if the file is truncated
 };
 
 
 
 void JPEG_InitSource(j_decompress_ptr cinfo){
 	ASSERT(cinfo)
-	reinterpret_cast<DataManagerJPEGSource*>(cinfo->src)->sof = true;
+	DataManagerJPEGSource* src = reinterpret_cast<DataManagerJPEGSource*>(cinfo->src);
+	ASSERT(src)
+	
+	//whole file is in the buffer
+	src->pub.next_input_byte = src->data;
+	src->pub.bytes_in_buffer = src->size;
 }
 
 
 
-//This function is calld when variable "bytes_in_buffer" reaches 0 and
-//the necessarity in new portion of information appears.
+//This function is calld when variable "bytes_in_buffer" reaches 0,
+//since whole file is in the buffer from the beginning, this means that the file is truncated.
 //RETURNS: TRUE if the buffer is successfuly filled.
 //         FALSE if i/o error occured
 boolean JPEG_FillInputBuffer(j_decompress_ptr cinfo){
 	DataManagerJPEGSource* src = reinterpret_cast<DataManagerJPEGSource*>(cinfo->src);
 	ASSERT(src)
 
-	//Read in JPEGINPUTBUFFERSIZE JOCTET's
-	size_t nbytes;
-
-	try{
-		utki::Buf<std::uint8_t> bufWrapper(src->buffer, sizeof(JOCTET) * DJpegInputBufferSize);
-		ASSERT(src->fi)
-		nbytes = src->fi->read(bufWrapper);
-	}catch(papki::Exc&){
-		if(src->sof){
-			return FALSE;//the specified file is empty
-		}
-		//we read the data before. Insert End Of File info into the buffer
-		src->buffer[0] = (JOCTET)(0xFF);
-		src->buffer[1] = (JOCTET)(JPEG_EOI);
-		nbytes = 2;
-	}catch(...){
-		return FALSE;//error
+	if(src->size == 0){
+		return FALSE;//the specified file is empty
 	}
 
-	//Set nexit input byte for JPEG and number of bytes read
-	src->pub.next_input_byte = src->buffer;
-	src->pub.bytes_in_buffer = nbytes;
-	src->sof = false;//the file is not empty since we read some data
+	//we read the data before. Insert End Of File info into the buffer
+	src->eoi[0] = (JOCTET)(0xFF);
+	src->eoi[1] = (JOCTET)(JPEG_EOI);
+	
+	src->pub.next_input_byte = src->eoi;
+	src->pub.bytes_in_buffer = 2;
 	return TRUE;//Operation successful
 }
 
@@ -412,10 +923,10 @@ void JPEG_SkipInputData(j_decompress_ptr cinfo, long numBytes){
 		return;//nothing to skip
 	}
 
-	//read "numBytes" bytes and waste them away
-	while(numBytes > long(src->pub.bytes_in_buffer)){
-		numBytes -= long(src->pub.bytes_in_buffer);
+	if(numBytes > long(src->pub.bytes_in_buffer)){
+		//skipping past the end of the file
 		JPEG_FillInputBuffer(cinfo);
+		return;
 	}
 
 	//update current JPEG read position
@@ -430,67 +941,31 @@ void JPEG_SkipInputData(j_decompress_ptr cinfo, long numBytes){
 void JPEG_TermSource(j_decompress_ptr cinfo){}
 
 
-}//~namespace
-
-
-
-//Read JPEG function
-void Image::loadJPG(const papki::File& fi){
-	ASSERT(!fi.isOpened())
-
-//	TRACE(<< "Image::LoadJPG(): enter" << std::endl)
-	if(this->buf_v.size()){
-		this->reset();
-	}
-	
-	papki::File::Guard fileGuard(fi);//this will guarantee that the file will be closed upon exit
-//	TRACE(<< "Image::LoadJPG(): file opened" << std::endl)
-
-	//Required JPEG structures
-	jpeg_decompress_struct cinfo;//decompression object
-	jpeg_error_mgr jerr;
-
-	cinfo.err = jpeg_std_error(&jerr);
-
-	jpeg_create_decompress(&cinfo);//creat decompress object
-
+//Set up decompressor to read the JPEG file from memory.
+void JPEG_SetMemorySource(j_decompress_ptr cinfo, const std::uint8_t* data, size_t size){
 	DataManagerJPEGSource* src = 0;
 
 	//Check if memory for JPEG-decompressor manager is allocated.
 	//It is possible that several libraries accessing the source
-	if(cinfo.src == 0){
+	if(cinfo->src == 0){
 		//Allocate memory for our manager and set a pointer of global library
 		//structure to it. We use JPEG library memory manager, this means that
 		//the library will take care of memory freeing for us.
 		//JPOOL_PERMANENT means that the memory is allocated for a whole
 		//time  of working with the library.
-		cinfo.src = reinterpret_cast<jpeg_source_mgr*>(
-				(cinfo.mem->alloc_small)(
-						j_common_ptr(&cinfo),
+		cinfo->src = reinterpret_cast<jpeg_source_mgr*>(
+				(cinfo->mem->alloc_small)(
+						j_common_ptr(cinfo),
 						JPOOL_PERMANENT,
 						sizeof(DataManagerJPEGSource)
 					)
 			);
-		src = reinterpret_cast<DataManagerJPEGSource*>(cinfo.src);
+		src = reinterpret_cast<DataManagerJPEGSource*>(cinfo->src);
 		if(!src){
 			throw Image::Exc("Image::LoadJPG(): memory alloc failed");
 		}
-		//Allocate memory for read data
-		src->buffer = reinterpret_cast<JOCTET*>(
-				(cinfo.mem->alloc_small)(
-						j_common_ptr(&cinfo),
-						JPOOL_PERMANENT,
-						DJpegInputBufferSize * sizeof(JOCTET)
-					)
-			);
-
-		if(!src->buffer){
-			throw Image::Exc("Image::LoadJPG(): memory alloc failed");
-		}
-
-		memset(src->buffer, 0, DJpegInputBufferSize * sizeof(JOCTET));
 	}else{
-		src = reinterpret_cast<DataManagerJPEGSource*>(cinfo.src);
+		src = reinterpret_cast<DataManagerJPEGSource*>(cinfo->src);
 	}
 
 	//set handler functions
@@ -500,10 +975,40 @@ void Image::loadJPG(const papki::File& fi){
 	src->pub.resync_to_restart = &jpeg_resync_to_restart;// use default func
 	src->pub.term_source = &JPEG_TermSource;
 	//Set the fields of our structure
-	src->fi = const_cast<papki::File*>(&fi);
+	src->data = data;
+	src->size = size;
 	//set pointers to the buffers
-	src->pub.bytes_in_buffer = 0;//forces fill_input_buffer on first read
-	src->pub.next_input_byte = 0;//until buffer loaded
+	src->pub.bytes_in_buffer = src->size;
+	src->pub.next_input_byte = src->data;
+}
+
+
+
+}//~namespace
+
+
+
+//Read JPEG function
+void Image::loadJPG(const papki::File& fi, const LoadOptions& options, BandListener* listener, unsigned bandHeight){
+	ASSERT(!fi.isOpened())
+
+//	TRACE(<< "Image::LoadJPG(): enter" << std::endl)
+	if(this->buf_v.size()){
+		this->reset();
+	}
+	
+	MappedFile file(fi);//file contents are decoded right from memory, without copying
+//	TRACE(<< "Image::LoadJPG(): file mapped" << std::endl)
+
+	//Required JPEG structures
+	jpeg_decompress_struct cinfo;//decompression object
+	jpeg_error_mgr jerr;
+
+	cinfo.err = jpeg_std_error(&jerr);
+
+	jpeg_create_decompress(&cinfo);//creat decompress object
+
+	JPEG_SetMemorySource(&cinfo, file.data(), file.size());
 	
 	//TODO: remove this comment
 	//WARNING!!! there's a little bug in the JPEG library. If "infile" is set
@@ -513,6 +1018,28 @@ void Image::loadJPG(const papki::File& fi){
 
 	jpeg_read_header(&cinfo, TRUE);//read parametrs of a JPEG file
 
+	Region region;
+	try{
+		region = Region(kolme::Vec2ui(cinfo.image_width, cinfo.image_height), options);
+	}catch(...){
+		jpeg_destroy_decompress(&cinfo);
+		throw;
+	}
+	
+	//Use the biggest DCT scaling factor which still gives at least the requested number of pixels,
+	//so that the decoder does not produce pixels which would be thrown away by resampling.
+	//Scaled pixels which only partially cover the region are not counted.
+	unsigned denom = 8;
+	for(; denom != 1; denom /= 2){
+		auto d = region.scaled(denom).windowDim;
+		if(d.x >= double(region.target.x) && d.y >= double(region.target.y)){
+			break;
+		}
+	}
+	region = region.scaled(denom);
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = denom;
+	
 	jpeg_start_decompress(&cinfo);//start decompression
 
 	//TODO:remove this comment
@@ -541,11 +1068,15 @@ void Image::loadJPG(const papki::File& fi){
 			return;
 	}
 	
-	//Set buffer size (allocate memory for image)
-	this->init(kolme::Vec2ui(cinfo.output_width, cinfo.output_height), imageType);
+	if(region.pos.x + region.dim.x > cinfo.output_width || region.pos.y + region.dim.y > cinfo.output_height){
+		jpeg_destroy_decompress(&cinfo);
+		throw Image::Exc("Image::LoadJPG(): unexpected scaled image dimensions");
+	}
+	
+	RowSink sink(*this, imageType, region, listener, bandHeight);
 
 	//calculate the size of a row in bytes
-	int bytesRow = this->dim().x * this->numChannels();
+	int bytesRow = cinfo.output_width * unsigned(imageType);
 
 	//Allocate memory for one row. It is an array of rows which
 	//contains only one row. JPOOL_IMAGE means that the memory is allocated
@@ -558,13 +1089,23 @@ void Image::loadJPG(const papki::File& fi){
 		);
 	memset(*buffer, 0, sizeof(JSAMPLE) * bytesRow);
 
-	int y = 0;
-	while(cinfo.output_scanline < this->dim().y){
+	//rows below the region are not decoded
+	while(cinfo.output_scanline < region.pos.y + region.dim.y){
+		unsigned y = cinfo.output_scanline;
 		//read the string into buffer
 		jpeg_read_scanlines(&cinfo, buffer, 1);
-		//copy the data to an image
-		memcpy(&*this->buf_v.begin() + bytesRow * y, buffer[0], bytesRow);
-		++y;
+		//pass the data to an image
+		if(y >= region.pos.y){
+			sink.push(buffer[0] + region.pos.x * unsigned(imageType));
+		}
+	}
+	
+	sink.finish();
+	
+	if(cinfo.output_scanline != cinfo.output_height){
+		jpeg_abort_decompress(&cinfo);
+		jpeg_destroy_decompress(&cinfo);
+		return;
 	}
 
 	jpeg_finish_decompress(&cinfo);//finish file decompression
@@ -794,15 +1335,15 @@ void Image::loadTGA(File& fi){
 
 
 
-void Image::load(const papki::File& fi){
+void Image::loadInternal(const papki::File& fi, const LoadOptions& options, BandListener* listener, unsigned bandHeight){
 	std::string ext = fi.ext();
 
 	if(ext == "png"){
 //		TRACE(<< "Image::Load(): loading PNG image" << std::endl)
-		this->loadPNG(fi);
+		this->loadPNG(fi, options, listener, bandHeight);
 	}else if(ext == "jpg"){
 //		TRACE(<< "Image::Load(): loading JPG image" << std::endl)
-		this->loadJPG(fi);
+		this->loadJPG(fi, options, listener, bandHeight);
 	}/*else if(ext == "tga"){
 //		TRACE(<< "Image::Load(): loading TGA image" << std::endl)
 		this->loadTGA(fi);
@@ -812,3 +1353,63 @@ void Image::load(const papki::File& fi){
 }
 
 
+
+void Image::loadInBands(const papki::File& f, BandListener& listener, unsigned bandHeight, const LoadOptions& options){
+	//holds the current band
+	Image band;
+	band.loadInternal(f, options, &listener, bandHeight);
+}
+
+
+
+kolme::Vec2ui Image::readDim(const papki::File& fi){
+	ASSERT(!fi.isOpened())
+	
+	std::string ext = fi.ext();
+	
+	if(ext == "png"){
+		MappedFile file(fi);
+		
+		if(file.size() < PNGSIGSIZE || png_sig_cmp(const_cast<png_bytep>(file.data()), 0, PNGSIGSIZE) != 0){
+			throw Image::Exc("Image::readDim(): not a PNG file");
+		}
+		
+		png_structp pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+		png_infop infoPtr = png_create_info_struct(pngPtr);
+		
+		png_set_sig_bytes(pngPtr, PNGSIGSIZE);
+		
+		PNGMemorySource pngSource = {file.data() + PNGSIGSIZE, file.size() - PNGSIGSIZE};
+		png_set_read_fn(pngPtr, &pngSource, PNG_MemoryReadFunction);
+		
+		//reads chunks up to the image data
+		png_read_info(pngPtr, infoPtr);
+		
+		png_uint_32 width = 0;
+		png_uint_32 height = 0;
+		png_get_IHDR(pngPtr, infoPtr, &width, &height, 0, 0, 0, 0, 0);
+		
+		png_destroy_read_struct(&pngPtr, &infoPtr, 0);
+		
+		return kolme::Vec2ui(width, height);
+	}else if(ext == "jpg"){
+		MappedFile file(fi);
+		
+		jpeg_decompress_struct cinfo;
+		jpeg_error_mgr jerr;
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_decompress(&cinfo);
+		
+		JPEG_SetMemorySource(&cinfo, file.data(), file.size());
+		
+		jpeg_read_header(&cinfo, TRUE);
+		
+		kolme::Vec2ui ret(cinfo.image_width, cinfo.image_height);
+		
+		jpeg_destroy_decompress(&cinfo);
+		
+		return ret;
+	}
+	
+	throw Image::Exc("Image::readDim(): unknown image format");
+}
@@ -1,13 +1,17 @@
 #pragma once
 
+#include <vector>
+
 #include <papki/File.hpp>
 
 #include <kolme/Vector2.hpp>
+#include <kolme/Rectangle.hpp>
 
 
 
 namespace morda{
 
+class ThreadPool;
 
 /**
  * @brief Utility class for loading and manipulating raster images.
@@ -42,6 +46,76 @@ public:
 		{}
 	};
 	
+	/**
+	 * @brief Resampling filter.
+	 */
+	enum class Filter_e{
+		/**
+		 * @brief Box filter.
+		 * Averages source pixels covered by destination pixel. Fast, good for downscaling by integer factors.
+		 */
+		BOX,
+		
+		/**
+		 * @brief Lanczos filter with 3 lobes.
+		 * Slower, but gives sharp results without aliasing for arbitrary scale factors.
+		 */
+		LANCZOS
+	};
+
+	/**
+	 * @brief Image loading options.
+	 * Allow decoding only a region of the image and downscaling it while decoding.
+	 * JPEG images are decoded directly at reduced size when possible, using DCT domain scaling of libjpeg.
+	 * Decoded rows are streamed to the resampler, so the full size image is never kept in memory.
+	 */
+	struct LoadOptions{
+		/**
+		 * @brief Region of the image to load.
+		 * In pixels of the full size image, row 0 is the top row of the image as it is stored in the file.
+		 * The region is clipped to the image. Zero dimensions mean the whole image.
+		 */
+		kolme::Rectangle<unsigned> crop;
+		
+		/**
+		 * @brief Dimensions of the loaded image.
+		 * Loaded region is resampled to these dimensions.
+		 * If one of the dimensions is zero, it is calculated to preserve the aspect ratio of the region.
+		 * If both are zero, the region is loaded at its original size.
+		 */
+		kolme::Vec2ui dim;
+		
+		LoadOptions() :
+				crop(0),
+				dim(0)
+		{}
+	};
+	
+	/**
+	 * @brief Receiver of decoded image bands.
+	 * Allows processing an image while it is being decoded, e.g. uploading it to a texture,
+	 * without keeping the whole decoded image in memory. See loadInBands().
+	 */
+	class BandListener{
+	public:
+		/**
+		 * @brief Called before the first band.
+		 * @param dim - dimensions of the loaded image.
+		 * @param colorDepth - color depth of the loaded image.
+		 */
+		virtual void onBegin(kolme::Vec2ui dim, ColorDepth_e colorDepth) = 0;
+		
+		/**
+		 * @brief Called for each decoded band.
+		 * Bands go from top to bottom of the image, the listener is free to modify the band image.
+		 * @param band - image containing the band rows.
+		 * @param firstRow - index of the first row of the band in the loaded image.
+		 */
+		virtual void onBand(Image& band, unsigned firstRow) = 0;
+		
+		virtual ~BandListener()noexcept{}
+	};
+
 private:
 	ColorDepth_e colorDepth_v;
 	kolme::Vec2ui dim_v = kolme::Vec2ui(0);
@@ -57,6 +131,12 @@ public:
 	{}
 
 	Image(const Image& im) = default;
+	
+	Image(Image&& im) = default;
+	
+	Image& operator=(const Image& im) = default;
+	
+	Image& operator=(Image&& im) = default;
 
 	/**
 	 * @brief Constructor.
@@ -90,9 +170,10 @@ public:
 	 * @brief Constructor.
 	 * Creates an image by loading it from file. Supported file types are PNG and JPG.
 	 * @param f - file to load image from.
+	 * @param options - loading options.
 	 */
-	Image(const papki::File& f){
-		this->load(f);
+	Image(const papki::File& f, const LoadOptions& options = LoadOptions()){
+		this->load(f, options);
 	}
 
 	/**
@@ -176,6 +257,18 @@ public:
 	 * @brief Flip image vertically.
 	 */
 	void flipVertical();
+	
+	/**
+	 * @brief Premultiply color channels by alpha channel.
+	 * Does nothing for images without alpha channel.
+	 */
+	void premultiplyAlpha();
+	
+	/**
+	 * @brief Swap red and blue channels.
+	 * Converts RGB image to BGR and RGBA to BGRA, and vice versa. Does nothing for grey images.
+	 */
+	void swapRedBlue();
 
 	/**
 	 * @brief Blit another image to this image.
@@ -198,7 +291,39 @@ public:
 	 * @param srcChan - index of source color channel.
 	 */
 	void blit(unsigned x, unsigned y, const Image& src, unsigned dstChan, unsigned srcChan);
+	
+	/**
+	 * @brief Blit color channel of another image to this image where it is greater.
+	 * Same as blit() for color channels, but destination channel value is only
+	 * replaced if source channel value is greater.
+	 * @param x - destination X location.
+	 * @param y - destination Y location.
+	 * @param src - image to copy to this image.
+	 * @param dstChan - index of destination color channel.
+	 * @param srcChan - index of source color channel.
+	 */
+	void blitIfGreater(unsigned x, unsigned y, const Image& src, unsigned dstChan, unsigned srcChan);
 
+	/**
+	 * @brief Resample image to another size.
+	 * Color channels of images with alpha channel are weighted by alpha, so that colors of
+	 * transparent pixels do not bleed to neighbouring pixels.
+	 * @param dimensions - dimensions of the resulting image.
+	 * @param filter - resampling filter.
+	 * @param pool - thread pool to process rows of pixels in parallel, nullptr to do all the work on calling thread.
+	 * @return Resampled image.
+	 */
+	Image resize(kolme::Vec2ui dimensions, Filter_e filter = Filter_e::LANCZOS, ThreadPool* pool = nullptr)const;
+	
+	/**
+	 * @brief Generate mipmap chain.
+	 * Each next level is half the size of the previous one, until 1x1 level is reached.
+	 * Levels are downscaled with box filter.
+	 * @param pool - thread pool to process rows of pixels in parallel, nullptr to do all the work on calling thread.
+	 * @return Mipmap levels after this image, i.e. starting from the one which is half the size of this image.
+	 */
+	std::vector<Image> mipChain(ThreadPool* pool = nullptr)const;
+	
 	/**
 	 * @brief Get reference to specific channel for given pixel.
 	 * @param x - X pixel location.
@@ -228,14 +353,20 @@ public:
 	/**
 	 * @brief Load image from PNG file.
 	 * @param f - PNG file.
+	 * @param options - loading options.
 	 */
-	void loadPNG(const papki::File& f);//Load image from PNG-file
+	void loadPNG(const papki::File& f, const LoadOptions& options = LoadOptions()){//Load image from PNG-file
+		this->loadPNG(f, options, nullptr, 0);
+	}
 	
 	/**
 	 * @brief Load image from JPG file.
 	 * @param f - JPG file.
+	 * @param options - loading options.
 	 */
-	void loadJPG(const papki::File& f);//Load image from JPG-file
+	void loadJPG(const papki::File& f, const LoadOptions& options = LoadOptions()){//Load image from JPG-file
+		this->loadJPG(f, options, nullptr, 0);
+	}
 	
 //	void loadTGA(papki::File& f);//Load image from TGA-file
 
@@ -243,8 +374,38 @@ public:
 	 * @brief Load image from file.
 	 * It will try to determine the file type from file name.
 	 * @param f - file to load image from.
+	 * @param options - loading options.
 	 */
-	void load(const papki::File& f);
+	void load(const papki::File& f, const LoadOptions& options = LoadOptions()){
+		this->loadInternal(f, options, nullptr, 0);
+	}
+	
+	/**
+	 * @brief Load image from file band by band.
+	 * Decoded rows are passed to the listener in bands of given height as soon as they are decoded,
+	 * or as soon as they are resampled if the loading options require resampling, so the whole image is never kept in memory.
+	 * @param f - file to load image from.
+	 * @param listener - listener to pass the bands to.
+	 * @param bandHeight - maximum number of rows in a band.
+	 * @param options - loading options.
+	 */
+	static void loadInBands(const papki::File& f, BandListener& listener, unsigned bandHeight, const LoadOptions& options = LoadOptions());
+	
+	/**
+	 * @brief Read image dimensions.
+	 * Only the image header is decoded.
+	 * It will try to determine the file type from file name.
+	 * @param f - file to read image dimensions from.
+	 * @return Dimensions of the full size image.
+	 */
+	static kolme::Vec2ui readDim(const papki::File& f);
+
+private:
+	void loadInternal(const papki::File& f, const LoadOptions& options, BandListener* listener, unsigned bandHeight);
+	
+	void loadPNG(const papki::File& f, const LoadOptions& options, BandListener* listener, unsigned bandHeight);
+	
+	void loadJPG(const papki::File& f, const LoadOptions& options, BandListener* listener, unsigned bandHeight);
 };
 
 
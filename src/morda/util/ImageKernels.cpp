@@ -0,0 +1,444 @@
+#include "ImageKernels.hpp"
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <utki/debug.hpp>
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#	define M_MORDA_IMAGE_KERNELS_AVX2
+#	define M_MORDA_IMAGE_KERNELS_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define M_MORDA_IMAGE_KERNELS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	include <arm_neon.h>
+#	define M_MORDA_IMAGE_KERNELS_NEON
+#endif
+
+
+using namespace morda;
+
+
+
+namespace{
+
+//exact rounded division by 255 of a value not greater than 255 * 255
+std::uint8_t div255(unsigned x){
+	x += 128;
+	return std::uint8_t((x + (x >> 8)) >> 8);
+}
+
+}
+
+
+
+void imageKernels::scalar::copyChannel(std::uint8_t* dst, unsigned dstNumChannels, const std::uint8_t* src, unsigned srcNumChannels, size_t numPixels){
+	for(; numPixels != 0; --numPixels, dst += dstNumChannels, src += srcNumChannels){
+		*dst = *src;
+	}
+}
+
+
+
+void imageKernels::scalar::maxChannel(std::uint8_t* dst, unsigned dstNumChannels, const std::uint8_t* src, unsigned srcNumChannels, size_t numPixels){
+	for(; numPixels != 0; --numPixels, dst += dstNumChannels, src += srcNumChannels){
+		if(*src > *dst){
+			*dst = *src;
+		}
+	}
+}
+
+
+
+void imageKernels::scalar::flipVertical(std::uint8_t* buf, size_t stride, size_t numRows){
+	for(size_t i = 0; i < numRows / 2; ++i){
+		std::uint8_t* a = buf + stride * i;
+		std::uint8_t* b = buf + stride * (numRows - i - 1);
+		for(size_t j = 0; j != stride; ++j){
+			std::swap(a[j], b[j]);
+		}
+	}
+}
+
+
+
+void imageKernels::scalar::premultiplyAlpha(std::uint8_t* buf, unsigned numChannels, size_t numPixels){
+	if(numChannels != 2 && numChannels != 4){
+		return;
+	}
+	
+	unsigned alpha = numChannels - 1;
+	
+	for(; numPixels != 0; --numPixels, buf += numChannels){
+		unsigned a = buf[alpha];
+		for(unsigned c = 0; c != alpha; ++c){
+			buf[c] = div255(buf[c] * a);
+		}
+	}
+}
+
+
+
+void imageKernels::scalar::swapRedBlue(std::uint8_t* buf, unsigned numChannels, size_t numPixels){
+	if(numChannels < 3){
+		return;
+	}
+	
+	for(; numPixels != 0; --numPixels, buf += numChannels){
+		std::swap(buf[0], buf[2]);
+	}
+}
+
+
+
+void imageKernels::scalar::addWeighted(float* acc, const float* src, float weight, size_t num){
+	for(; num != 0; --num, ++acc, ++src){
+		*acc += *src * weight;
+	}
+}
+
+
+
+void imageKernels::scalar::floatsToBytes(std::uint8_t* dst, const float* src, size_t num){
+	for(; num != 0; --num, ++dst, ++src){
+		float v = std::min(std::max(*src, 0.0f), 255.0f);
+		*dst = std::uint8_t(std::nearbyint(v));
+	}
+}
+
+
+
+void imageKernels::copyChannel(std::uint8_t* dst, unsigned dstNumChannels, const std::uint8_t* src, unsigned srcNumChannels, size_t numPixels){
+	if(dstNumChannels == 1 && srcNumChannels == 1){
+		memcpy(dst, src, numPixels);
+		return;
+	}
+
+#if defined(M_MORDA_IMAGE_KERNELS_SSE2)
+	//the font glyph case: grey channel to one of the channels of grey-alpha image
+	if(dstNumChannels == 2 && srcNumChannels == 1){
+		//mask selects the byte pointed to by 'dst' and every second byte after it, i.e. the destination channel
+		const __m128i mask = _mm_set1_epi16(0x00ff);
+
+#	if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+		const __m256i mask256 = _mm256_set1_epi16(0x00ff);
+		for(; numPixels >= 32 + 1; numPixels -= 32, dst += 64, src += 32){
+			__m256i s = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)), 0xd8);
+			__m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst));
+			__m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + 32));
+			d0 = _mm256_or_si256(_mm256_and_si256(mask256, _mm256_unpacklo_epi8(s, s)), _mm256_andnot_si256(mask256, d0));
+			d1 = _mm256_or_si256(_mm256_and_si256(mask256, _mm256_unpackhi_epi8(s, s)), _mm256_andnot_si256(mask256, d1));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), d0);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), d1);
+		}
+#	endif
+		
+		//'numPixels' pixels span 2 * numPixels - 1 bytes from 'dst', so keep one extra pixel to not touch memory past the last one
+		for(; numPixels >= 16 + 1; numPixels -= 16, dst += 32, src += 16){
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+			__m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + 16));
+			d0 = _mm_or_si128(_mm_and_si128(mask, _mm_unpacklo_epi8(s, s)), _mm_andnot_si128(mask, d0));
+			d1 = _mm_or_si128(_mm_and_si128(mask, _mm_unpackhi_epi8(s, s)), _mm_andnot_si128(mask, d1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), d0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), d1);
+		}
+	}
+#elif defined(M_MORDA_IMAGE_KERNELS_NEON)
+	if(dstNumChannels == 2 && srcNumChannels == 1){
+		for(; numPixels >= 16 + 1; numPixels -= 16, dst += 32, src += 16){
+			uint8x16x2_t d = vld2q_u8(dst);
+			d.val[0] = vld1q_u8(src);
+			vst2q_u8(dst, d);
+		}
+	}
+#endif
+	
+	scalar::copyChannel(dst, dstNumChannels, src, srcNumChannels, numPixels);
+}
+
+
+
+void imageKernels::maxChannel(std::uint8_t* dst, unsigned dstNumChannels, const std::uint8_t* src, unsigned srcNumChannels, size_t numPixels){
+#if defined(M_MORDA_IMAGE_KERNELS_SSE2)
+	if(dstNumChannels == 1 && srcNumChannels == 1){
+#	if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+		for(; numPixels >= 32; numPixels -= 32, dst += 32, src += 32){
+			__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+			__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_max_epu8(s, d));
+		}
+#	endif
+		for(; numPixels >= 16; numPixels -= 16, dst += 16, src += 16){
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_max_epu8(s, d));
+		}
+	}else if(dstNumChannels == 2 && srcNumChannels == 1){
+		//source bytes are spread to every second byte, zeros in between do not change the other channel of destination pixels
+		const __m128i mask = _mm_set1_epi16(0x00ff);
+
+#	if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+		const __m256i mask256 = _mm256_set1_epi16(0x00ff);
+		for(; numPixels >= 32 + 1; numPixels -= 32, dst += 64, src += 32){
+			__m256i s = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)), 0xd8);
+			__m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst));
+			__m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + 32));
+			d0 = _mm256_max_epu8(d0, _mm256_and_si256(mask256, _mm256_unpacklo_epi8(s, s)));
+			d1 = _mm256_max_epu8(d1, _mm256_and_si256(mask256, _mm256_unpackhi_epi8(s, s)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), d0);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), d1);
+		}
+#	endif
+		
+		for(; numPixels >= 16 + 1; numPixels -= 16, dst += 32, src += 16){
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+			__m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + 16));
+			d0 = _mm_max_epu8(d0, _mm_and_si128(mask, _mm_unpacklo_epi8(s, s)));
+			d1 = _mm_max_epu8(d1, _mm_and_si128(mask, _mm_unpackhi_epi8(s, s)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), d0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), d1);
+		}
+	}
+#elif defined(M_MORDA_IMAGE_KERNELS_NEON)
+	if(dstNumChannels == 1 && srcNumChannels == 1){
+		for(; numPixels >= 16; numPixels -= 16, dst += 16, src += 16){
+			vst1q_u8(dst, vmaxq_u8(vld1q_u8(dst), vld1q_u8(src)));
+		}
+	}else if(dstNumChannels == 2 && srcNumChannels == 1){
+		for(; numPixels >= 16 + 1; numPixels -= 16, dst += 32, src += 16){
+			uint8x16x2_t d = vld2q_u8(dst);
+			d.val[0] = vmaxq_u8(d.val[0], vld1q_u8(src));
+			vst2q_u8(dst, d);
+		}
+	}
+#endif
+	
+	scalar::maxChannel(dst, dstNumChannels, src, srcNumChannels, numPixels);
+}
+
+
+
+void imageKernels::flipVertical(std::uint8_t* buf, size_t stride, size_t numRows){
+	for(size_t i = 0; i < numRows / 2; ++i){
+		std::uint8_t* a = buf + stride * i;
+		std::uint8_t* b = buf + stride * (numRows - i - 1);
+		size_t n = stride;
+
+#if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+		for(; n >= 32; n -= 32, a += 32, b += 32){
+			__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+			__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(a), vb);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(b), va);
+		}
+#endif
+#if defined(M_MORDA_IMAGE_KERNELS_SSE2)
+		for(; n >= 16; n -= 16, a += 16, b += 16){
+			__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+			__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(a), vb);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(b), va);
+		}
+#elif defined(M_MORDA_IMAGE_KERNELS_NEON)
+		for(; n >= 16; n -= 16, a += 16, b += 16){
+			uint8x16_t va = vld1q_u8(a);
+			uint8x16_t vb = vld1q_u8(b);
+			vst1q_u8(a, vb);
+			vst1q_u8(b, va);
+		}
+#endif
+		
+		for(; n != 0; --n, ++a, ++b){
+			std::swap(*a, *b);
+		}
+	}
+}
+
+
+
+#if defined(M_MORDA_IMAGE_KERNELS_SSE2)
+namespace{
+//premultiply two RGBA pixels unpacked to 16 bit values
+__m128i premultiply2(__m128i p){
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(p, a), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+}
+#endif
+
+#if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+namespace{
+__m256i premultiply2(__m256i p){
+	__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m256i x = _mm256_add_epi16(_mm256_mullo_epi16(p, a), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+}
+#endif
+
+
+
+void imageKernels::premultiplyAlpha(std::uint8_t* buf, unsigned numChannels, size_t numPixels){
+	if(numChannels == 4){
+#if defined(M_MORDA_IMAGE_KERNELS_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+
+#	if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+		const __m256i zero256 = _mm256_setzero_si256();
+		const __m256i alphaMask256 = _mm256_set1_epi32(int(0xff000000));
+		for(; numPixels >= 8; numPixels -= 8, buf += 32){
+			__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf));
+			__m256i lo = premultiply2(_mm256_unpacklo_epi8(p, zero256));
+			__m256i hi = premultiply2(_mm256_unpackhi_epi8(p, zero256));
+			__m256i r = _mm256_or_si256(_mm256_andnot_si256(alphaMask256, _mm256_packus_epi16(lo, hi)), _mm256_and_si256(alphaMask256, p));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(buf), r);
+		}
+#	endif
+		
+		for(; numPixels >= 4; numPixels -= 4, buf += 16){
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+			__m128i lo = premultiply2(_mm_unpacklo_epi8(p, zero));
+			__m128i hi = premultiply2(_mm_unpackhi_epi8(p, zero));
+			__m128i r = _mm_or_si128(_mm_andnot_si128(alphaMask, _mm_packus_epi16(lo, hi)), _mm_and_si128(alphaMask, p));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(buf), r);
+		}
+#elif defined(M_MORDA_IMAGE_KERNELS_NEON)
+		for(; numPixels >= 16; numPixels -= 16, buf += 64){
+			uint8x16x4_t p = vld4q_u8(buf);
+			for(unsigned c = 0; c != 3; ++c){
+				uint16x8_t lo = vmull_u8(vget_low_u8(p.val[c]), vget_low_u8(p.val[3]));
+				uint16x8_t hi = vmull_u8(vget_high_u8(p.val[c]), vget_high_u8(p.val[3]));
+				lo = vaddq_u16(lo, vrshrq_n_u16(lo, 8));
+				hi = vaddq_u16(hi, vrshrq_n_u16(hi, 8));
+				p.val[c] = vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8));
+			}
+			vst4q_u8(buf, p);
+		}
+#endif
+	}
+	
+	scalar::premultiplyAlpha(buf, numChannels, numPixels);
+}
+
+
+
+void imageKernels::swapRedBlue(std::uint8_t* buf, unsigned numChannels, size_t numPixels){
+	if(numChannels == 4){
+#if defined(M_MORDA_IMAGE_KERNELS_SSE2)
+		//pixel as little endian 32 bit value is 0xAABBGGRR
+		const __m128i keepMask = _mm_set1_epi32(int(0xff00ff00));
+		const __m128i lowMask = _mm_set1_epi32(0x000000ff);
+
+#	if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+		const __m256i keepMask256 = _mm256_set1_epi32(int(0xff00ff00));
+		const __m256i lowMask256 = _mm256_set1_epi32(0x000000ff);
+		for(; numPixels >= 8; numPixels -= 8, buf += 32){
+			__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf));
+			__m256i r = _mm256_or_si256(
+					_mm256_and_si256(p, keepMask256),
+					_mm256_or_si256(
+							_mm256_and_si256(_mm256_srli_epi32(p, 16), lowMask256),
+							_mm256_slli_epi32(_mm256_and_si256(p, lowMask256), 16)
+						)
+				);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(buf), r);
+		}
+#	endif
+		
+		for(; numPixels >= 4; numPixels -= 4, buf += 16){
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+			__m128i r = _mm_or_si128(
+					_mm_and_si128(p, keepMask),
+					_mm_or_si128(
+							_mm_and_si128(_mm_srli_epi32(p, 16), lowMask),
+							_mm_slli_epi32(_mm_and_si128(p, lowMask), 16)
+						)
+				);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(buf), r);
+		}
+#elif defined(M_MORDA_IMAGE_KERNELS_NEON)
+		for(; numPixels >= 16; numPixels -= 16, buf += 64){
+			uint8x16x4_t p = vld4q_u8(buf);
+			std::swap(p.val[0], p.val[2]);
+			vst4q_u8(buf, p);
+		}
+#endif
+	}
+#if defined(M_MORDA_IMAGE_KERNELS_NEON)
+	else if(numChannels == 3){
+		for(; numPixels >= 16; numPixels -= 16, buf += 48){
+			uint8x16x3_t p = vld3q_u8(buf);
+			std::swap(p.val[0], p.val[2]);
+			vst3q_u8(buf, p);
+		}
+	}
+#endif
+	
+	scalar::swapRedBlue(buf, numChannels, numPixels);
+}
+
+
+
+void imageKernels::addWeighted(float* acc, const float* src, float weight, size_t num){
+#if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+	const __m256 w256 = _mm256_set1_ps(weight);
+	for(; num >= 8; num -= 8, acc += 8, src += 8){
+		_mm256_storeu_ps(acc, _mm256_add_ps(_mm256_loadu_ps(acc), _mm256_mul_ps(_mm256_loadu_ps(src), w256)));
+	}
+#endif
+#if defined(M_MORDA_IMAGE_KERNELS_SSE2)
+	const __m128 w = _mm_set1_ps(weight);
+	for(; num >= 4; num -= 4, acc += 4, src += 4){
+		_mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc), _mm_mul_ps(_mm_loadu_ps(src), w)));
+	}
+#elif defined(M_MORDA_IMAGE_KERNELS_NEON)
+	const float32x4_t w = vdupq_n_f32(weight);
+	for(; num >= 4; num -= 4, acc += 4, src += 4){
+		vst1q_f32(acc, vaddq_f32(vld1q_f32(acc), vmulq_f32(vld1q_f32(src), w)));
+	}
+#endif
+	
+	scalar::addWeighted(acc, src, weight, num);
+}
+
+
+
+void imageKernels::floatsToBytes(std::uint8_t* dst, const float* src, size_t num){
+	//conversions round to nearest even, same as std::nearbyint() in default rounding mode,
+	//saturating packs do the clamping
+#if defined(M_MORDA_IMAGE_KERNELS_AVX2)
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	for(; num >= 32; num -= 32, dst += 32, src += 32){
+		__m256i a = _mm256_cvtps_epi32(_mm256_loadu_ps(src));
+		__m256i b = _mm256_cvtps_epi32(_mm256_loadu_ps(src + 8));
+		__m256i c = _mm256_cvtps_epi32(_mm256_loadu_ps(src + 16));
+		__m256i d = _mm256_cvtps_epi32(_mm256_loadu_ps(src + 24));
+		__m256i r = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permutevar8x32_epi32(r, order));
+	}
+#endif
+#if defined(M_MORDA_IMAGE_KERNELS_SSE2)
+	for(; num >= 16; num -= 16, dst += 16, src += 16){
+		__m128i a = _mm_cvtps_epi32(_mm_loadu_ps(src));
+		__m128i b = _mm_cvtps_epi32(_mm_loadu_ps(src + 4));
+		__m128i c = _mm_cvtps_epi32(_mm_loadu_ps(src + 8));
+		__m128i d = _mm_cvtps_epi32(_mm_loadu_ps(src + 12));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+	}
+#elif defined(M_MORDA_IMAGE_KERNELS_NEON) && defined(__aarch64__)
+	for(; num >= 8; num -= 8, dst += 8, src += 8){
+		uint16x4_t a = vqmovun_s32(vcvtnq_s32_f32(vld1q_f32(src)));
+		uint16x4_t b = vqmovun_s32(vcvtnq_s32_f32(vld1q_f32(src + 4)));
+		vst1_u8(dst, vqmovn_u16(vcombine_u16(a, b)));
+	}
+#endif
+	
+	scalar::floatsToBytes(dst, src, num);
+}
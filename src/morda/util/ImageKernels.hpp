@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+
+namespace morda{
+
+/**
+ * @brief Pixel processing kernels.
+ * Low level routines operating on raw 8 bit per channel pixel data, used by Image and by texture loading code.
+ * The kernels are vectorized with SSE2, AVX2 or NEON, depending on which of these instruction sets
+ * the library is compiled for (e.g. AVX2 is used when compiled with -mavx2 or -march=native),
+ * with plain C++ code used for the rest of the data and for other platforms.
+ * Plain C++ versions of all kernels are also available from morda::imageKernels::scalar namespace,
+ * these are mostly useful for testing and benchmarking.
+ */
+namespace imageKernels{
+
+/**
+ * @brief Copy one channel of pixels.
+ * @param dst - pointer to the channel of the first destination pixel.
+ * @param dstNumChannels - number of channels in destination pixels.
+ * @param src - pointer to the channel of the first source pixel.
+ * @param srcNumChannels - number of channels in source pixels.
+ * @param numPixels - number of pixels to process.
+ */
+void copyChannel(std::uint8_t* dst, unsigned dstNumChannels, const std::uint8_t* src, unsigned srcNumChannels, size_t numPixels);
+
+/**
+ * @brief Set one channel of pixels to maximum of it and a channel of other pixels.
+ * @param dst - pointer to the channel of the first destination pixel.
+ * @param dstNumChannels - number of channels in destination pixels.
+ * @param src - pointer to the channel of the first source pixel.
+ * @param srcNumChannels - number of channels in source pixels.
+ * @param numPixels - number of pixels to process.
+ */
+void maxChannel(std::uint8_t* dst, unsigned dstNumChannels, const std::uint8_t* src, unsigned srcNumChannels, size_t numPixels);
+
+/**
+ * @brief Flip rows of pixels vertically in place.
+ * @param buf - pointer to pixel data.
+ * @param stride - number of bytes per row.
+ * @param numRows - number of rows.
+ */
+void flipVertical(std::uint8_t* buf, size_t stride, size_t numRows);
+
+/**
+ * @brief Premultiply color channels by alpha.
+ * Alpha channel is the last one. Pixels without alpha channel are left untouched.
+ * @param buf - pointer to pixel data.
+ * @param numChannels - number of channels per pixel.
+ * @param numPixels - number of pixels to process.
+ */
+void premultiplyAlpha(std::uint8_t* buf, unsigned numChannels, size_t numPixels);
+
+/**
+ * @brief Swap red and blue channels.
+ * Converts RGB to BGR, RGBA to BGRA, and vice versa. Grey pixels are left untouched.
+ * @param buf - pointer to pixel data.
+ * @param numChannels - number of channels per pixel.
+ * @param numPixels - number of pixels to process.
+ */
+void swapRedBlue(std::uint8_t* buf, unsigned numChannels, size_t numPixels);
+
+/**
+ * @brief Add weighted values to accumulator.
+ * Computes acc[i] += src[i] * weight for each value.
+ * @param acc - accumulator values.
+ * @param src - values to add.
+ * @param weight - weight to multiply added values by.
+ * @param num - number of values.
+ */
+void addWeighted(float* acc, const float* src, float weight, size_t num);
+
+/**
+ * @brief Convert floating point values to bytes.
+ * Values are rounded to nearest integer and clamped to [0, 255] range.
+ * @param dst - destination bytes.
+ * @param src - values to convert.
+ * @param num - number of values.
+ */
+void floatsToBytes(std::uint8_t* dst, const float* src, size_t num);
+
+/**
+ * @brief Plain C++ versions of the kernels.
+ */
+namespace scalar{
+
+void copyChannel(std::uint8_t* dst, unsigned dstNumChannels, const std::uint8_t* src, unsigned srcNumChannels, size_t numPixels);
+
+void maxChannel(std::uint8_t* dst, unsigned dstNumChannels, const std::uint8_t* src, unsigned srcNumChannels, size_t numPixels);
+
+void flipVertical(std::uint8_t* buf, size_t stride, size_t numRows);
+
+void premultiplyAlpha(std::uint8_t* buf, unsigned numChannels, size_t numPixels);
+
+void swapRedBlue(std::uint8_t* buf, unsigned numChannels, size_t numPixels);
+
+void addWeighted(float* acc, const float* src, float weight, size_t num);
+
+void floatsToBytes(std::uint8_t* dst, const float* src, size_t num);
+
+}
+
+}
+
+}
@@ -0,0 +1,148 @@
+#include "MappedFile.hpp"
+
+#include <utki/debug.hpp>
+
+#include <papki/FSFile.hpp>
+
+#if M_OS == M_OS_WINDOWS
+#	include <utki/windows.hpp>
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#include "RootDirFile.hpp"
+#include "ZipFile.hpp"
+
+
+using namespace morda;
+
+
+
+namespace{
+const papki::File& underlyingFile(const papki::File& fi){
+	const papki::File* f = &fi;
+	while(auto r = dynamic_cast<const RootDirFile*>(f)){
+		f = &r->base();
+	}
+	return *f;
+}
+}
+	
+
+
+MappedFile::MappedFile(const papki::File& fi){
+	ASSERT(!fi.isOpened())
+	
+	auto& f = underlyingFile(fi);
+	
+	if(dynamic_cast<const papki::FSFile*>(&f) && this->map(f.path())){
+		return;
+	}
+	
+	if(auto z = dynamic_cast<const ZipFile*>(&f)){
+		auto data = z->storedData(this->archive);
+		if(this->archive){
+			this->data_v = data.begin();
+			this->size_v = data.size();
+			return;
+		}
+	}
+	
+	this->loaded = fi.loadWholeFileIntoMemory();
+	this->data_v = this->loaded.data();
+	this->size_v = this->loaded.size();
+}
+
+
+
+std::shared_ptr<const MappedFile> MappedFile::mapOnly(const papki::File& fi){
+	ASSERT(!fi.isOpened())
+	
+	auto& f = underlyingFile(fi);
+	
+	if(!dynamic_cast<const papki::FSFile*>(&f)){
+		return nullptr;
+	}
+	
+	std::shared_ptr<MappedFile> ret(new MappedFile());
+	if(!ret->map(f.path())){
+		return nullptr;
+	}
+	return ret;
+}
+
+
+
+MappedFile::~MappedFile()noexcept{
+	if(!this->mapping){
+		return;
+	}
+
+#if M_OS == M_OS_WINDOWS
+	UnmapViewOfFile(this->mapping);
+	CloseHandle(this->mappingHandle);
+#else
+	munmap(this->mapping, this->size_v);
+#endif
+}
+
+
+
+bool MappedFile::map(const std::string& path){
+	//empty files cannot be mapped, these are loaded as usual
+#if M_OS == M_OS_WINDOWS
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE){
+		return false;
+	}
+	
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart == 0){
+		CloseHandle(file);
+		return false;
+	}
+	
+	//mapping keeps the file open, so the file handle is not needed anymore
+	HANDLE mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if(!mappingHandle){
+		return false;
+	}
+	
+	void* p = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if(!p){
+		CloseHandle(mappingHandle);
+		return false;
+	}
+	
+	this->mappingHandle = mappingHandle;
+	this->size_v = size_t(size.QuadPart);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0){
+		return false;
+	}
+	
+	struct stat st;
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0){
+		close(fd);
+		return false;
+	}
+	
+	//mapping stays valid after the file descriptor is closed
+	void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED){
+		return false;
+	}
+	
+	this->size_v = size_t(st.st_size);
+#endif
+	
+	this->mapping = p;
+	this->data_v = reinterpret_cast<const std::uint8_t*>(p);
+	return true;
+}
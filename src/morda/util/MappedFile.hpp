@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include <utki/config.hpp>
+#include <utki/Buf.hpp>
+
+#include <papki/File.hpp>
+
+
+namespace morda{
+
+/**
+ * @brief Read-only view of whole file contents.
+ * Files on local file system are memory-mapped, so their contents are not copied
+ * and memory pages are shared between processes mapping the same file.
+ * Uncompressed entries of memory-mapped ZIP archives (see ZipFile) are used right from the archive mapping.
+ * Files which cannot be mapped, e.g. compressed files inside ZIP archives, are loaded to memory.
+ * Files wrapped by RootDirFile are mapped through the file they wrap.
+ */
+class MappedFile{
+	const std::uint8_t* data_v = nullptr;
+	size_t size_v = 0;
+	
+	//contents of the file which cannot be mapped
+	std::vector<std::uint8_t> loaded;
+	
+	void* mapping = nullptr;
+
+#if M_OS == M_OS_WINDOWS
+	void* mappingHandle = nullptr;
+#endif
+	
+	//mapping of ZIP archive, when the file is an uncompressed entry of the archive
+	std::shared_ptr<const MappedFile> archive;
+	
+	MappedFile(){}
+	
+	bool map(const std::string& path);
+
+public:
+	/**
+	 * @brief Map file.
+	 * @param fi - file to map, it should not be opened.
+	 */
+	MappedFile(const papki::File& fi);
+	
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	
+	~MappedFile()noexcept;
+	
+	/**
+	 * @brief Map file without falling back to loading it.
+	 * @param fi - file to map, it should not be opened.
+	 * @return Mapped file.
+	 * @return nullptr if the file cannot be memory-mapped.
+	 */
+	static std::shared_ptr<const MappedFile> mapOnly(const papki::File& fi);
+	
+	/**
+	 * @brief Get pointer to file contents.
+	 * @return Pointer to the first byte of the file.
+	 */
+	const std::uint8_t* data()const noexcept{
+		return this->data_v;
+	}
+	
+	/**
+	 * @brief Get file size.
+	 * @return Size of the file in bytes.
+	 */
+	size_t size()const noexcept{
+		return this->size_v;
+	}
+	
+	/**
+	 * @brief Get file contents.
+	 * @return Buffer wrapping file contents.
+	 */
+	const utki::Buf<std::uint8_t> buf()const noexcept{
+		return utki::Buf<std::uint8_t>(const_cast<std::uint8_t*>(this->data_v), this->size_v);
+	}
+	
+	/**
+	 * @brief Check if file is memory-mapped.
+	 * @return true if file contents are mapped to memory.
+	 * @return false if file contents are loaded to memory.
+	 */
+	bool isMapped()const noexcept{
+		return this->mapping != nullptr || this->archive;
+	}
+};
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+
+#include <utki/debug.hpp>
+#include <papki/File.hpp>
+
+
+namespace morda{
+
+/**
+ * @brief File interface with paths relative to a root directory.
+ * Same as papki::RootDirFile, but it gives access to the wrapped file, this allows
+ * MappedFile to map files of resource packs directly. Only reading is supported.
+ */
+class RootDirFile : public papki::File{
+	std::unique_ptr<const papki::File> baseFile;
+	
+	std::string rootDir;
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param baseFile - file interface to wrap.
+	 * @param rootDir - root directory, it is prepended to paths of this file interface to get paths of the wrapped one.
+	 */
+	RootDirFile(std::unique_ptr<const papki::File> baseFile, const std::string& rootDir) :
+			baseFile(std::move(baseFile)),
+			rootDir(rootDir)
+	{}
+	
+	/**
+	 * @brief Get wrapped file.
+	 * @return Wrapped file interface with path set to the full path of this file.
+	 */
+	const papki::File& base()const{
+		if(!this->baseFile->isOpened()){
+			this->baseFile->setPath(this->rootDir + this->path());
+		}
+		return *this->baseFile;
+	}
+	
+	void openInternal(papki::File::E_Mode mode) override{
+		if(mode != papki::File::E_Mode::READ){
+			throw papki::Exc("RootDirFile::openInternal(): illegal mode requested, only READ is supported");
+		}
+		this->base().open(mode);
+	}
+	
+	void closeInternal()const noexcept override{
+		this->baseFile->close();
+	}
+	
+	size_t readInternal(utki::Buf<std::uint8_t> buf)const override{
+		return this->baseFile->read(buf);
+	}
+	
+	size_t seekForwardInternal(size_t numBytesToSeek)const override{
+		return this->baseFile->seekForward(numBytesToSeek);
+	}
+	
+	size_t seekBackwardInternal(size_t numBytesToSeek)const override{
+		return this->baseFile->seekBackward(numBytesToSeek);
+	}
+	
+	void rewindInternal()const override{
+		this->baseFile->rewind();
+	}
+	
+	bool exists()const override{
+		return this->base().exists();
+	}
+	
+	std::vector<std::string> listDirContents(size_t maxEntries = 0)const override{
+		return this->base().listDirContents(maxEntries);
+	}
+	
+	std::unique_ptr<papki::File> spawn()override{
+		return utki::makeUnique<RootDirFile>(this->baseFile->spawn(), this->rootDir);
+	}
+};
+
+}
@@ -0,0 +1,609 @@
+#include "TextBuffer.hpp"
+
+#include <utki/debug.hpp>
+
+#include <algorithm>
+
+
+using namespace morda;
+
+
+
+namespace{
+
+//Maximal size of a piece, pieces are split at most this number of bytes from their beginning.
+//Loaded text is also cut to pieces of this size, so that splitting a piece is cheap.
+const size_t maxPieceBytes_c = 4096;
+
+bool isContinuationByte(char c)noexcept{
+	return (std::uint8_t(c) & 0xc0) == 0x80;
+}
+
+//returns byte offset of the given character in the UTF-8 string
+size_t charToByteOffset(const char* p, size_t bytes, size_t charIndex)noexcept{
+	size_t i = 0;
+	for(; i != bytes; ++i){
+		if(isContinuationByte(p[i])){
+			continue;
+		}
+		if(charIndex == 0){
+			break;
+		}
+		--charIndex;
+	}
+	return i;
+}
+
+void countCharsAndNewlines(const char* p, size_t bytes, size_t& chars, size_t& newlines)noexcept{
+	chars = 0;
+	newlines = 0;
+	for(auto e = p + bytes; p != e; ++p){
+		if(!isContinuationByte(*p)){
+			++chars;
+		}
+		if(*p == '\n'){
+			++newlines;
+		}
+	}
+}
+
+void appendUtf32(const char* p, size_t bytes, std::u32string& out){
+	for(auto e = p + bytes; p != e;){
+		std::uint8_t b = std::uint8_t(*p++);
+		char32_t c;
+		unsigned num;
+		if(b < 0x80){
+			c = b;
+			num = 0;
+		}else if((b & 0xe0) == 0xc0){
+			c = b & 0x1f;
+			num = 1;
+		}else if((b & 0xf0) == 0xe0){
+			c = b & 0x0f;
+			num = 2;
+		}else{
+			c = b & 0x07;
+			num = 3;
+		}
+		for(; num != 0 && p != e && isContinuationByte(*p); --num, ++p){
+			c = (c << 6) | (std::uint8_t(*p) & 0x3f);
+		}
+		out.push_back(c);
+	}
+}
+
+std::string toUtf8(const std::u32string& str){
+	std::string ret;
+	ret.reserve(str.size());
+	for(auto c : str){
+		if(c < 0x80){
+			ret.push_back(char(c));
+		}else if(c < 0x800){
+			ret.push_back(char(0xc0 | (c >> 6)));
+			ret.push_back(char(0x80 | (c & 0x3f)));
+		}else if(c < 0x10000){
+			ret.push_back(char(0xe0 | (c >> 12)));
+			ret.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+			ret.push_back(char(0x80 | (c & 0x3f)));
+		}else{
+			ret.push_back(char(0xf0 | (c >> 18)));
+			ret.push_back(char(0x80 | ((c >> 12) & 0x3f)));
+			ret.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+			ret.push_back(char(0x80 | (c & 0x3f)));
+		}
+	}
+	return ret;
+}
+
+size_t countNewlines(const std::u32string& str)noexcept{
+	return std::count(str.begin(), str.end(), char32_t('\n'));
+}
+
+}
+
+
+
+void TextBuffer::Node::update()noexcept{
+	this->totalChars = this->chars;
+	this->totalNewlines = this->newlines;
+	if(this->left){
+		this->totalChars += this->left->totalChars;
+		this->totalNewlines += this->left->totalNewlines;
+	}
+	if(this->right){
+		this->totalChars += this->right->totalChars;
+		this->totalNewlines += this->right->totalNewlines;
+	}
+}
+
+
+
+TextBuffer::~TextBuffer()noexcept{}
+
+
+
+std::unique_ptr<TextBuffer::Node> TextBuffer::makeNode(bool isAdded, size_t start, size_t bytes){
+	std::unique_ptr<Node> ret(new Node());
+	
+	//xorshift
+	this->seed ^= this->seed << 13;
+	this->seed ^= this->seed >> 17;
+	this->seed ^= this->seed << 5;
+	ret->priority = this->seed;
+	
+	ret->isAdded = isAdded;
+	ret->start = start;
+	ret->bytes = bytes;
+	countCharsAndNewlines(this->data(*ret), bytes, ret->chars, ret->newlines);
+	ret->update();
+	return ret;
+}
+
+
+
+std::unique_ptr<TextBuffer::Node> TextBuffer::makePieces(bool isAdded, size_t start, size_t bytes){
+	const char* p = (isAdded ? this->added : this->original).data();
+	
+	std::unique_ptr<Node> ret;
+	
+	for(size_t end = start + bytes; start != end;){
+		size_t e = std::min(start + maxPieceBytes_c, end);
+		
+		//do not cut characters
+		while(e != end && isContinuationByte(p[e])){
+			++e;
+		}
+		
+		ret = merge(std::move(ret), this->makeNode(isAdded, start, e - start));
+		start = e;
+	}
+	
+	return ret;
+}
+
+
+
+std::unique_ptr<TextBuffer::Node> TextBuffer::merge(std::unique_ptr<Node> l, std::unique_ptr<Node> r){
+	if(!l){
+		return r;
+	}
+	if(!r){
+		return l;
+	}
+	
+	if(l->priority > r->priority){
+		l->right = merge(std::move(l->right), std::move(r));
+		l->update();
+		return l;
+	}else{
+		r->left = merge(std::move(l), std::move(r->left));
+		r->update();
+		return r;
+	}
+}
+
+
+
+void TextBuffer::split(std::unique_ptr<Node> t, size_t chars, std::unique_ptr<Node>& l, std::unique_ptr<Node>& r){
+	if(!t){
+		l.reset();
+		r.reset();
+		return;
+	}
+	
+	size_t leftChars = t->left ? t->left->totalChars : 0;
+	
+	if(chars <= leftChars){
+		std::unique_ptr<Node> ll;
+		this->split(std::move(t->left), chars, ll, t->left);
+		t->update();
+		r = std::move(t);
+		l = std::move(ll);
+		return;
+	}
+	
+	if(chars >= leftChars + t->chars){
+		std::unique_ptr<Node> rr;
+		this->split(std::move(t->right), chars - leftChars - t->chars, t->right, rr);
+		t->update();
+		l = std::move(t);
+		r = std::move(rr);
+		return;
+	}
+	
+	//split the piece itself
+	size_t k = chars - leftChars;
+	size_t offset = charToByteOffset(this->data(*t), t->bytes, k);
+	
+	auto tail = this->makeNode(t->isAdded, t->start + offset, t->bytes - offset);
+	
+	t->bytes = offset;
+	t->chars = k;
+	t->newlines -= tail->newlines;
+	
+	r = merge(std::move(tail), std::move(t->right));
+	t->update();
+	l = std::move(t);
+}
+
+
+
+void TextBuffer::append(const Node* n, size_t pos, size_t len, std::u32string& out)const{
+	for(; n && len != 0;){
+		size_t leftChars = n->left ? n->left->totalChars : 0;
+		
+		if(pos < leftChars){
+			size_t l = std::min(len, leftChars - pos);
+			this->append(n->left.get(), pos, l, out);
+			pos += l;
+			len -= l;
+			continue;
+		}
+		
+		if(pos < leftChars + n->chars){
+			size_t k = pos - leftChars;
+			size_t l = std::min(len, n->chars - k);
+			
+			const char* p = this->data(*n);
+			size_t b = charToByteOffset(p, n->bytes, k);
+			size_t e = b + charToByteOffset(p + b, n->bytes - b, l);
+			appendUtf32(p + b, e - b, out);
+			
+			pos += l;
+			len -= l;
+		}
+		
+		pos -= leftChars + n->chars;
+		n = n->right.get();
+	}
+}
+
+
+
+void TextBuffer::appendUtf8(const Node* n, std::string& out)const{
+	for(; n; n = n->right.get()){
+		this->appendUtf8(n->left.get(), out);
+		out.append(this->data(*n), n->bytes);
+	}
+}
+
+
+
+void TextBuffer::setText(std::string utf8){
+	size_t oldNumLines = this->numLines();
+	
+	this->root.reset();
+	this->added.clear();
+	this->original = std::move(utf8);
+	
+	this->root = this->makePieces(false, 0, this->original.size());
+	
+	this->undoStack.clear();
+	this->redoStack.clear();
+	this->breakUndo = true;
+	
+	if(this->changed){
+		this->changed(*this, 0, oldNumLines - 1, this->numLines() - 1);
+	}
+}
+
+
+
+std::string TextBuffer::text()const{
+	std::string ret;
+	this->appendUtf8(this->root.get(), ret);
+	return ret;
+}
+
+
+
+size_t TextBuffer::lineBegin(size_t line)const noexcept{
+	if(line == 0){
+		return 0;
+	}
+	
+	if(line >= this->numLines()){
+		return this->size();
+	}
+	
+	//find the line-th line break
+	size_t ret = 0;
+	for(const Node* n = this->root.get(); n;){
+		size_t leftChars = n->left ? n->left->totalChars : 0;
+		size_t leftNewlines = n->left ? n->left->totalNewlines : 0;
+		
+		if(line <= leftNewlines){
+			n = n->left.get();
+			continue;
+		}
+		
+		line -= leftNewlines;
+		ret += leftChars;
+		
+		if(line <= n->newlines){
+			const char* p = this->data(*n);
+			for(auto e = p + n->bytes; p != e; ++p){
+				if(!isContinuationByte(*p)){
+					++ret;
+				}
+				if(*p == '\n'){
+					--line;
+					if(line == 0){
+						return ret;
+					}
+				}
+			}
+			ASSERT(false)
+		}
+		
+		line -= n->newlines;
+		ret += n->chars;
+		n = n->right.get();
+	}
+	
+	ASSERT(false)
+	return ret;
+}
+
+
+
+size_t TextBuffer::lineOf(size_t pos)const noexcept{
+	size_t ret = 0;
+	
+	for(const Node* n = this->root.get(); n && pos != 0;){
+		size_t leftChars = n->left ? n->left->totalChars : 0;
+		
+		if(pos <= leftChars){
+			n = n->left.get();
+			continue;
+		}
+		
+		if(n->left){
+			ret += n->left->totalNewlines;
+		}
+		pos -= leftChars;
+		
+		if(pos <= n->chars){
+			const char* p = this->data(*n);
+			size_t e = charToByteOffset(p, n->bytes, pos);
+			ret += std::count(p, p + e, '\n');
+			break;
+		}
+		
+		ret += n->newlines;
+		pos -= n->chars;
+		n = n->right.get();
+	}
+	
+	return ret;
+}
+
+
+
+std::u32string TextBuffer::substr(size_t pos, size_t len)const{
+	utki::clampTop(pos, this->size());
+	utki::clampTop(len, this->size() - pos);
+	
+	std::u32string ret;
+	ret.reserve(len);
+	this->append(this->root.get(), pos, len, ret);
+	return ret;
+}
+
+
+
+void TextBuffer::insertInternal(size_t pos, const std::u32string& text){
+	ASSERT(pos <= this->size())
+	
+	if(text.size() == 0){
+		return;
+	}
+	
+	size_t line = this->lineOf(pos);
+	size_t numNewlines = countNewlines(text);
+	
+	auto utf8 = toUtf8(text);
+	
+	std::unique_ptr<Node> l, r;
+	this->split(std::move(this->root), pos, l, r);
+	
+	Node* last = l.get();
+	for(; last && last->right; last = last->right.get()){}
+	
+	if(last && last->isAdded && last->start + last->bytes == this->added.size() && last->bytes + utf8.size() <= maxPieceBytes_c){
+		//typing, extend the last added piece
+		this->added.append(utf8);
+		
+		for(Node* n = l.get(); n; n = n->right.get()){
+			n->totalChars += text.size();
+			n->totalNewlines += numNewlines;
+		}
+		last->bytes += utf8.size();
+		last->chars += text.size();
+		last->newlines += numNewlines;
+	}else{
+		size_t start = this->added.size();
+		this->added.append(utf8);
+		l = merge(std::move(l), this->makePieces(true, start, utf8.size()));
+	}
+	
+	this->root = merge(std::move(l), std::move(r));
+	
+	if(this->changed){
+		this->changed(*this, line, 0, numNewlines);
+	}
+}
+
+
+
+std::u32string TextBuffer::eraseInternal(size_t pos, size_t len){
+	std::u32string ret;
+	
+	if(len == 0){
+		return ret;
+	}
+	
+	size_t line = this->lineOf(pos);
+	
+	std::unique_ptr<Node> a, b, c;
+	this->split(std::move(this->root), pos, a, b);
+	this->split(std::move(b), len, b, c);
+	
+	this->append(b.get(), 0, len, ret);
+	size_t numNewlines = b ? b->totalNewlines : 0;
+	b.reset();
+	
+	this->root = merge(std::move(a), std::move(c));
+	
+	if(this->changed){
+		this->changed(*this, line, numNewlines, 0);
+	}
+	
+	return ret;
+}
+
+
+
+void TextBuffer::record(bool isInsertion, size_t pos, const std::u32string& text){
+	this->redoStack.clear();
+	
+	if(this->undoLimit_v == 0){
+		return;
+	}
+	
+	//merge typing or deleting of characters within a line into one undo step
+	if(!this->breakUndo && this->undoStack.size() != 0 && countNewlines(text) == 0){
+		auto& prev = this->undoStack.back();
+		if(prev.isInsertion == isInsertion){
+			if(isInsertion){
+				if(prev.pos + prev.text.size() == pos){
+					prev.text.append(text);
+					return;
+				}
+			}else{
+				if(pos + text.size() == prev.pos){
+					//backspace
+					prev.text.insert(0, text);
+					prev.pos = pos;
+					return;
+				}else if(pos == prev.pos){
+					//delete
+					prev.text.append(text);
+					return;
+				}
+			}
+		}
+	}
+	
+	Edit e;
+	e.isInsertion = isInsertion;
+	e.pos = pos;
+	e.text = text;
+	this->undoStack.push_back(std::move(e));
+	
+	if(this->undoStack.size() > this->undoLimit_v){
+		this->undoStack.erase(this->undoStack.begin());
+	}
+	
+	this->breakUndo = countNewlines(text) != 0;
+}
+
+
+
+void TextBuffer::insert(size_t pos, const std::u32string& text){
+	utki::clampTop(pos, this->size());
+	
+	if(text.size() == 0){
+		return;
+	}
+	
+	this->insertInternal(pos, text);
+	this->record(true, pos, text);
+}
+
+
+
+void TextBuffer::erase(size_t pos, size_t len){
+	utki::clampTop(pos, this->size());
+	utki::clampTop(len, this->size() - pos);
+	
+	if(len == 0){
+		return;
+	}
+	
+	auto text = this->eraseInternal(pos, len);
+	this->record(false, pos, text);
+}
+
+
+
+void TextBuffer::replace(size_t pos, size_t len, const std::u32string& text){
+	utki::clampTop(pos, this->size());
+	utki::clampTop(len, this->size() - pos);
+	
+	auto old = this->substr(pos, len);
+	
+	size_t prefix = 0;
+	for(; prefix != old.size() && prefix != text.size() && old[prefix] == text[prefix]; ++prefix){}
+	
+	size_t suffix = 0;
+	for(;
+			suffix != old.size() - prefix && suffix != text.size() - prefix
+					&& old[old.size() - 1 - suffix] == text[text.size() - 1 - suffix];
+			++suffix
+		)
+	{}
+	
+	this->erase(pos + prefix, old.size() - prefix - suffix);
+	this->insert(pos + prefix, text.substr(prefix, text.size() - prefix - suffix));
+}
+
+
+
+void TextBuffer::undo(){
+	if(this->undoStack.size() == 0){
+		return;
+	}
+	
+	auto e = std::move(this->undoStack.back());
+	this->undoStack.pop_back();
+	
+	if(e.isInsertion){
+		this->eraseInternal(e.pos, e.text.size());
+	}else{
+		this->insertInternal(e.pos, e.text);
+	}
+	
+	this->redoStack.push_back(std::move(e));
+	this->breakUndo = true;
+}
+
+
+
+void TextBuffer::redo(){
+	if(this->redoStack.size() == 0){
+		return;
+	}
+	
+	auto e = std::move(this->redoStack.back());
+	this->redoStack.pop_back();
+	
+	if(e.isInsertion){
+		this->insertInternal(e.pos, e.text);
+	}else{
+		this->eraseInternal(e.pos, e.text.size());
+	}
+	
+	this->undoStack.push_back(std::move(e));
+	this->breakUndo = true;
+}
+
+
+
+void TextBuffer::setUndoLimit(size_t limit){
+	this->undoLimit_v = limit;
+	
+	if(this->undoStack.size() > limit){
+		this->undoStack.erase(this->undoStack.begin(), this->undoStack.begin() + (this->undoStack.size() - limit));
+	}
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace morda{
+
+/**
+ * @brief Editable text buffer.
+ * Text is stored in UTF-8 as a piece table: original text and an append-only buffer of added text,
+ * with the sequence of pieces referring to them kept in a balanced tree (treap).
+ * Each tree node holds numbers of characters and line breaks in its subtree, so that
+ * edits and lookups by character index or by line number take O(log n) time.
+ * All positions are in unicode characters (code points).
+ * Buffer keeps history of edits for undo/redo.
+ */
+class TextBuffer{
+	struct Node{
+		std::unique_ptr<Node> left;
+		std::unique_ptr<Node> right;
+		
+		std::uint32_t priority;
+		
+		//piece
+		bool isAdded;
+		size_t start;
+		size_t bytes;
+		size_t chars;
+		size_t newlines;
+		
+		//totals of the subtree including this node
+		size_t totalChars;
+		size_t totalNewlines;
+		
+		void update()noexcept;
+	};
+	
+	std::string original;
+	std::string added;
+	
+	std::unique_ptr<Node> root;
+	
+	std::uint32_t seed = 0x9e3779b9;
+	
+	struct Edit{
+		bool isInsertion;
+		size_t pos;
+		std::u32string text;
+	};
+	
+	std::vector<Edit> undoStack;
+	std::vector<Edit> redoStack;
+	size_t undoLimit_v = 1000;
+	bool breakUndo = true;
+	
+	std::unique_ptr<Node> makeNode(bool isAdded, size_t start, size_t bytes);
+	
+	std::unique_ptr<Node> makePieces(bool isAdded, size_t start, size_t bytes);
+	
+	const char* data(const Node& n)const noexcept{
+		return (n.isAdded ? this->added : this->original).data() + n.start;
+	}
+	
+	static std::unique_ptr<Node> merge(std::unique_ptr<Node> l, std::unique_ptr<Node> r);
+	
+	void split(std::unique_ptr<Node> t, size_t chars, std::unique_ptr<Node>& l, std::unique_ptr<Node>& r);
+	
+	void append(const Node* n, size_t pos, size_t len, std::u32string& out)const;
+	
+	void appendUtf8(const Node* n, std::string& out)const;
+	
+	void insertInternal(size_t pos, const std::u32string& text);
+	
+	std::u32string eraseInternal(size_t pos, size_t len);
+	
+	void record(bool isInsertion, size_t pos, const std::u32string& text);
+public:
+	TextBuffer(){}
+	
+	/**
+	 * @brief Constructor.
+	 * @param utf8 - initial text in UTF-8.
+	 */
+	TextBuffer(std::string utf8){
+		this->setText(std::move(utf8));
+	}
+	
+	TextBuffer(const TextBuffer&) = delete;
+	TextBuffer& operator=(const TextBuffer&) = delete;
+	
+	~TextBuffer()noexcept;
+	
+	/**
+	 * @brief Replace whole text.
+	 * Clears undo history.
+	 * @param utf8 - new text in UTF-8.
+	 */
+	void setText(std::string utf8);
+	
+	/**
+	 * @brief Get whole text.
+	 * @return Text in UTF-8.
+	 */
+	std::string text()const;
+	
+	/**
+	 * @brief Get number of characters.
+	 * @return Number of characters in the buffer.
+	 */
+	size_t size()const noexcept{
+		return this->root ? this->root->totalChars : 0;
+	}
+	
+	/**
+	 * @brief Get number of lines.
+	 * Lines are separated by '\n' character, so there is always at least one line.
+	 * @return Number of lines.
+	 */
+	size_t numLines()const noexcept{
+		return (this->root ? this->root->totalNewlines : 0) + 1;
+	}
+	
+	/**
+	 * @brief Get position of line beginning.
+	 * @param line - line number.
+	 * @return Index of the first character of the line.
+	 */
+	size_t lineBegin(size_t line)const noexcept;
+	
+	/**
+	 * @brief Get position of line end.
+	 * @param line - line number.
+	 * @return Index of the line break character ending the line, or size() for the last line.
+	 */
+	size_t lineEnd(size_t line)const noexcept{
+		if(line + 1 >= this->numLines()){
+			return this->size();
+		}
+		return this->lineBegin(line + 1) - 1;
+	}
+	
+	/**
+	 * @brief Get line number by character position.
+	 * @param pos - character position.
+	 * @return Number of the line the character belongs to.
+	 */
+	size_t lineOf(size_t pos)const noexcept;
+	
+	/**
+	 * @brief Get part of the text.
+	 * @param pos - index of the first character.
+	 * @param len - number of characters.
+	 * @return Requested part of the text.
+	 */
+	std::u32string substr(size_t pos, size_t len)const;
+	
+	/**
+	 * @brief Get line text.
+	 * @param line - line number.
+	 * @return Text of the line without the line break.
+	 */
+	std::u32string line(size_t line)const{
+		auto b = this->lineBegin(line);
+		return this->substr(b, this->lineEnd(line) - b);
+	}
+	
+	/**
+	 * @brief Insert text.
+	 * @param pos - position to insert at.
+	 * @param text - text to insert.
+	 */
+	void insert(size_t pos, const std::u32string& text);
+	
+	/**
+	 * @brief Erase text.
+	 * @param pos - index of the first character to erase.
+	 * @param len - number of characters to erase.
+	 */
+	void erase(size_t pos, size_t len);
+	
+	/**
+	 * @brief Replace part of the text.
+	 * Only the differing part of the old and new text is actually replaced.
+	 * @param pos - index of the first character to replace.
+	 * @param len - number of characters to replace.
+	 * @param text - text to replace with.
+	 */
+	void replace(size_t pos, size_t len, const std::u32string& text);
+	
+	/**
+	 * @brief Check if there are edits to undo.
+	 * @return true if undo() will do something.
+	 */
+	bool canUndo()const noexcept{
+		return this->undoStack.size() != 0;
+	}
+	
+	/**
+	 * @brief Check if there are undone edits to redo.
+	 * @return true if redo() will do something.
+	 */
+	bool canRedo()const noexcept{
+		return this->redoStack.size() != 0;
+	}
+	
+	/**
+	 * @brief Undo last edit.
+	 * Consecutive typing or deletion of characters is undone as one edit.
+	 */
+	void undo();
+	
+	/**
+	 * @brief Redo last undone edit.
+	 */
+	void redo();
+	
+	/**
+	 * @brief Start new undo step.
+	 * Next edit will not be merged with the previous one in undo history.
+	 */
+	void breakUndoStep()noexcept{
+		this->breakUndo = true;
+	}
+	
+	/**
+	 * @brief Set maximum number of undo steps.
+	 * @param limit - maximum number of undo steps to keep.
+	 */
+	void setUndoLimit(size_t limit);
+	
+	/**
+	 * @brief Text changed signal.
+	 * Emitted after every change of the text.
+	 * The 'line' line and 'numRemoved' lines after it were replaced by the 'line' line and 'numInserted' lines after it.
+	 */
+	std::function<void(TextBuffer& buffer, size_t line, size_t numRemoved, size_t numInserted)> changed;
+};
+
+}
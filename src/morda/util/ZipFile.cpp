@@ -1,75 +1,383 @@
 #include "ZipFile.hpp"
 
+#include <utki/Shared.hpp>
+
 #include "unzip/unzip.h"
 
 #include <sstream>
-#include <papki/FSFile.hpp>
+#include <array>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <list>
+#include <mutex>
+
+#include "MappedFile.hpp"
+#include "../ThreadPool.hpp"
 
 
 using namespace morda;
 
 
 
+//Archive file stream for unzip. Memory-mapped archive is read right from memory.
+struct ZipFile::Stream{
+	papki::File* file;
+	const MappedFile* mapped;
+	
+	size_t pos = 0;
+	
+	//size of not mapped archive file is found out when it is needed
+	size_t size;
+	
+	bool canSeekBackward = true;
+	
+	Stream(papki::File* file, const MappedFile* mapped) :
+			file(file),
+			mapped(mapped),
+			size(mapped ? mapped->size() : size_t(-1))
+	{}
+	
+	void seekTo(size_t target){
+		ASSERT(!this->mapped)
+		
+		if(target >= this->pos){
+			this->pos += this->file->seekForward(target - this->pos);
+			return;
+		}
+		
+		if(this->canSeekBackward){
+			try{
+				this->pos -= this->file->seekBackward(this->pos - target);
+				return;
+			}catch(papki::Exc&){
+				//file interface does not support seeking backward
+				this->canSeekBackward = false;
+			}
+		}
+		
+		this->file->rewind();
+		this->pos = this->file->seekForward(target);
+	}
+	
+	static voidpf ZCALLBACK open(voidpf opaque, const char* filename, int mode){
+		Stream* s = reinterpret_cast<Stream*>(opaque);
+		
+		switch(mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER){
+			case ZLIB_FILEFUNC_MODE_READ:
+				if(!s->mapped){
+					s->file->open(papki::File::E_Mode::READ);
+				}
+				break;
+			default:
+				throw papki::Exc("UnzipOpen(): tried opening zip file something else than READ. Only READ is supported.");
+		}
+		
+		s->pos = 0;
+		return s;
+	}
+	
+	static int ZCALLBACK close(voidpf opaque, voidpf stream){
+		Stream* s = reinterpret_cast<Stream*>(stream);
+		if(!s->mapped){
+			s->file->close();
+		}
+		return 0;
+	}
+	
+	static uLong ZCALLBACK read(voidpf opaque, voidpf stream, void* buf, uLong size){
+		Stream* s = reinterpret_cast<Stream*>(stream);
+		
+		size_t n;
+		if(s->mapped){
+			n = std::min(size_t(size), s->size - s->pos);
+			memcpy(buf, s->mapped->data() + s->pos, n);
+		}else{
+			n = s->file->read(utki::Buf<std::uint8_t>(reinterpret_cast<std::uint8_t*>(buf), size));
+		}
+		s->pos += n;
+		return uLong(n);
+	}
+	
+	static uLong ZCALLBACK write(voidpf opaque, voidpf stream, const void* buf, uLong size){
+		ASSERT_INFO(false, "Writing ZIP files is not supported")
+		return 0;
+	}
+	
+	static int ZCALLBACK error(voidpf opaque, voidpf stream){
+		return 0;//no error
+	}
+	
+	static long ZCALLBACK seek(voidpf  opaque, voidpf stream, uLong offset, int origin){
+		Stream* s = reinterpret_cast<Stream*>(stream);
+		
+		//Assume that offset can only be positive, since its type is unsigned
+		
+		size_t target;
+		switch(origin){
+			case ZLIB_FILEFUNC_SEEK_CUR:
+				target = s->pos + offset;
+				break;
+			case ZLIB_FILEFUNC_SEEK_END:
+				if(s->size == size_t(-1)){
+					ASSERT(!s->mapped)
+					s->pos += s->file->seekForward(size_t(-1));
+					s->size = s->pos;
+				}
+				target = s->size + offset;
+				break;
+			case ZLIB_FILEFUNC_SEEK_SET:
+				target = offset;
+				break;
+			default:
+				return -1;
+		}
+		
+		if(s->mapped){
+			if(target > s->size){
+				return -1;
+			}
+			s->pos = target;
+			return 0;
+		}
+		
+		s->seekTo(target);
+		return s->pos == target ? 0 : -1;
+	}
+	
+	static long ZCALLBACK tell(voidpf opaque, voidpf stream){
+		Stream* s = reinterpret_cast<Stream*>(stream);
+		return long(s->pos);
+	}
+};
+
+
+
+//Index of the archive central directory.
+struct ZipFile::Index{
+	struct Entry{
+		unz_file_pos pos;
+		
+		uLong compressionMethod;
+		size_t compressedSize;
+		size_t size;
+		uLong crc;
+		
+		//data of the file in memory-mapped archive, it is compressed unless the compression method is 0
+		const std::uint8_t* data = nullptr;
+		
+		bool isStored()const noexcept{
+			return this->data && this->compressionMethod == 0;
+		}
+		
+		bool isDeflated()const noexcept{
+			return this->data && this->compressionMethod == Z_DEFLATED;
+		}
+	};
+	
+	//file names in the order of the central directory
+	std::vector<std::string> names;
+	
+	std::unordered_map<std::string, Entry> entries;
+};
+
+
+
 namespace{
+const size_t defaultCacheSize_c = 4 * 1024 * 1024;
+}
+
+
 
-voidpf ZCALLBACK UnzipOpen(voidpf opaque, const char* filename, int mode){
-	papki::File* f = reinterpret_cast<papki::File*>(opaque);
+//Cache of decompressed files, keeps most recently used files.
+struct ZipFile::Cache{
+	typedef std::shared_ptr<const std::vector<std::uint8_t>> T_Data;
 	
-	switch(mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER){
-		case ZLIB_FILEFUNC_MODE_READ:
-			f->open(papki::File::E_Mode::READ);
-			break;
-		default:
-			throw papki::Exc("UnzipOpen(): tried opening zip file something else than READ. Only READ is supported.");
+	std::mutex mutex;
+	
+	size_t capacity = defaultCacheSize_c;
+	size_t size = 0;
+	
+	//most recently used files go first
+	std::list<std::pair<std::string, T_Data>> files;
+	
+	std::unordered_map<std::string, decltype(files)::iterator> map;
+	
+	void shrink(){
+		while(this->size > this->capacity){
+			ASSERT(this->files.size() != 0)
+			this->size -= this->files.back().second->size();
+			this->map.erase(this->files.back().first);
+			this->files.pop_back();
+		}
 	}
 	
-	return f;
-}
+	T_Data get(const std::string& path){
+		std::lock_guard<std::mutex> lock(this->mutex);
+		
+		auto i = this->map.find(path);
+		if(i == this->map.end()){
+			return nullptr;
+		}
+		
+		this->files.splice(this->files.begin(), this->files, i->second);
+		return i->second->second;
+	}
+	
+	void put(const std::string& path, T_Data data){
+		std::lock_guard<std::mutex> lock(this->mutex);
+		
+		//empty files are not cached, since there is nothing to decompress
+		if(data->size() == 0 || data->size() > this->capacity || this->map.find(path) != this->map.end()){
+			return;
+		}
+		
+		this->files.push_front(std::make_pair(path, std::move(data)));
+		this->map[path] = this->files.begin();
+		this->size += this->files.front().second->size();
+		
+		this->shrink();
+	}
+	
+	bool fits(size_t size){
+		std::lock_guard<std::mutex> lock(this->mutex);
+		return size <= this->capacity;
+	}
+};
 
-int ZCALLBACK UnzipClose(voidpf opaque, voidpf stream){
-	papki::File* f = reinterpret_cast<papki::File*>(stream);
-	f->close();
-	return 0;
-}
 
-uLong ZCALLBACK UnzipRead(voidpf opaque, voidpf stream, void* buf, uLong size){
-	papki::File* f = reinterpret_cast<papki::File*>(stream);
-	return uLong(f->read(utki::Buf<std::uint8_t>(reinterpret_cast<std::uint8_t*>(buf), size)));
-}
 
-uLong ZCALLBACK UnzipWrite(voidpf opaque, voidpf stream, const void* buf, uLong size){
-	ASSERT_INFO(false, "Writing ZIP files is not supported")
-	return 0;
+//Raw inflate of compressed file right from the archive mapping.
+struct ZipFile::Inflater{
+	const Index::Entry& entry;
+	
+	z_stream zs;
+	
+	uLong crc = crc32(0, Z_NULL, 0);
+	
+	bool finished = false;
+	
+	Inflater(const Index::Entry& entry) :
+			entry(entry)
+	{
+		ASSERT(entry.isDeflated())
+		
+		memset(&this->zs, 0, sizeof(this->zs));
+		this->zs.next_in = const_cast<Bytef*>(entry.data);
+		this->zs.avail_in = uInt(entry.compressedSize);
+		
+		//negative window bits means raw deflate data without zlib header
+		if(inflateInit2(&this->zs, -MAX_WBITS) != Z_OK){
+			throw papki::Exc("ZipFile::Inflater::Inflater(): inflateInit2() failed");
+		}
+	}
+	
+	~Inflater()noexcept{
+		inflateEnd(&this->zs);
+	}
+	
+	size_t read(utki::Buf<std::uint8_t> buf){
+		if(this->finished || buf.size() == 0){
+			return 0;
+		}
+		
+		this->zs.next_out = buf.begin();
+		this->zs.avail_out = uInt(std::min(buf.size(), size_t(uInt(-1))));
+		uInt availOut = this->zs.avail_out;
+		
+		//all compressed data is available, so inflate() does not stop until output buffer is full or data ends,
+		//though it may return without output after inflating empty block
+		int ret;
+		do{
+			ret = inflate(&this->zs, Z_NO_FLUSH);
+		}while(ret == Z_OK && this->zs.avail_out == availOut);
+		
+		size_t numBytesRead = availOut - this->zs.avail_out;
+		this->crc = crc32(this->crc, buf.begin(), uInt(numBytesRead));
+		
+		switch(ret){
+			case Z_OK:
+				break;
+			case Z_STREAM_END:
+				this->finished = true;
+				if(this->zs.total_out != this->entry.size || this->crc != this->entry.crc){
+					throw papki::Exc("ZipFile::Inflater::read(): inflated data does not match file size or CRC");
+				}
+				break;
+			default:
+				throw papki::Exc("ZipFile::Inflater::read(): inflate() failed, compressed data is corrupted");
+		}
+		
+		return numBytesRead;
+	}
+	
+	std::vector<std::uint8_t> readAll(){
+		std::vector<std::uint8_t> ret(this->entry.size);
+		
+		size_t numBytesRead = 0;
+		while(numBytesRead != ret.size()){
+			size_t n = this->read(utki::Buf<std::uint8_t>(&ret[numBytesRead], ret.size() - numBytesRead));
+			if(n == 0){
+				throw papki::Exc("ZipFile::Inflater::readAll(): inflated data is shorter than file size");
+			}
+			numBytesRead += n;
+		}
+		
+		//make sure the data ends where expected and check CRC
+		std::array<std::uint8_t, 1> extra;
+		if(this->read(utki::wrapBuf(extra)) != 0){
+			throw papki::Exc("ZipFile::Inflater::readAll(): inflated data is longer than file size");
+		}
+		ASSERT(this->finished)
+		
+		return ret;
+	}
+};
+
+
+
+namespace{
+
+std::uint32_t readLe16(const std::uint8_t* p){
+	return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8);
 }
 
-int ZCALLBACK UnzipError(voidpf opaque, voidpf stream){
-	return 0;//no error
+std::uint32_t readLe32(const std::uint8_t* p){
+	return readLe16(p) | (readLe16(p + 2) << 16);
 }
 
-long ZCALLBACK UnzipSeek(voidpf  opaque, voidpf stream, uLong offset, int origin){
-	papki::File* f = reinterpret_cast<papki::File*>(stream);
+const std::uint32_t centralHeaderSignature_c = 0x02014b50;
+const size_t centralHeaderSize_c = 46;
+const size_t centralHeaderLocalOffsetPos_c = 42;
+
+const std::uint32_t localHeaderSignature_c = 0x04034b50;
+const size_t localHeaderSize_c = 30;
+const size_t localHeaderNameLengthPos_c = 26;
+const size_t localHeaderExtraLengthPos_c = 28;
+
+//Find data of file in memory-mapped archive.
+//Returns nullptr if the headers are not where they are expected to be, e.g. if there is data prepended to the archive.
+const std::uint8_t* findEntryData(const MappedFile& archive, size_t centralHeaderOffset, size_t compressedSize){
+	const std::uint8_t* d = archive.data();
 	
-	//Assume that offset can only be positive, since its type is unsigned
+	if(centralHeaderOffset + centralHeaderSize_c > archive.size() || readLe32(d + centralHeaderOffset) != centralHeaderSignature_c){
+		return nullptr;
+	}
 	
-	switch(origin){
-		case ZLIB_FILEFUNC_SEEK_CUR:
-			f->seekForward(offset);
-			return 0;
-		case ZLIB_FILEFUNC_SEEK_END:
-			f->seekForward(size_t(-1));
-			return 0;
-		case ZLIB_FILEFUNC_SEEK_SET:
-			f->rewind();
-			f->seekForward(offset);
-			return 0;
-		default:
-			return -1;
+	size_t localHeaderOffset = readLe32(d + centralHeaderOffset + centralHeaderLocalOffsetPos_c);
+	if(localHeaderOffset + localHeaderSize_c > archive.size() || readLe32(d + localHeaderOffset) != localHeaderSignature_c){
+		return nullptr;
 	}
-}
 
-long ZCALLBACK UnzipTell(voidpf opaque, voidpf stream){
-	papki::File* f = reinterpret_cast<papki::File*>(stream);
-	return long(f->curPos());
+	size_t dataOffset = localHeaderOffset + localHeaderSize_c
+			+ readLe16(d + localHeaderOffset + localHeaderNameLengthPos_c)
+			+ readLe16(d + localHeaderOffset + localHeaderExtraLengthPos_c);
+	if(dataOffset + compressedSize > archive.size()){
+		return nullptr;
+	}
+
+	return d + dataOffset;
 }
 
 }
@@ -79,17 +387,51 @@ long ZCALLBACK UnzipTell(voidpf opaque, voidpf stream){
 
 ZipFile::ZipFile(std::unique_ptr<papki::File> zipFile, const std::string& path) :
 		papki::File(path),
-		zipFile(std::move(zipFile))
+		zipFile(std::move(zipFile)),
+		cache(utki::makeShared<Cache>())
+{
+	this->archive = MappedFile::mapOnly(*this->zipFile);
+	
+	this->openArchive();
+	
+	try{
+		this->buildIndex();
+	}catch(...){
+		unzClose(this->handle);
+		throw;
+	}
+}
+
+
+
+ZipFile::ZipFile(
+		std::unique_ptr<papki::File> zipFile,
+		std::shared_ptr<const Index> index,
+		std::shared_ptr<const MappedFile> archive,
+		std::shared_ptr<Cache> cache
+	) :
+		zipFile(std::move(zipFile)),
+		index(std::move(index)),
+		archive(std::move(archive)),
+		cache(std::move(cache))
 {
+	this->openArchive();
+}
+
+
+
+void ZipFile::openArchive(){
+	this->stream = utki::makeUnique<Stream>(this->zipFile.get(), this->archive.get());
+	
 	zlib_filefunc_def ff;
-	ff.opaque = this->zipFile.operator->();
-	ff.zopen_file = &UnzipOpen;
-	ff.zclose_file = &UnzipClose;
-	ff.zread_file = &UnzipRead;
-	ff.zwrite_file = &UnzipWrite;
-	ff.zseek_file = &UnzipSeek;
-	ff.zerror_file = &UnzipError;
-	ff.ztell_file = &UnzipTell;
+	ff.opaque = this->stream.get();
+	ff.zopen_file = &Stream::open;
+	ff.zclose_file = &Stream::close;
+	ff.zread_file = &Stream::read;
+	ff.zwrite_file = &Stream::write;
+	ff.zseek_file = &Stream::seek;
+	ff.zerror_file = &Stream::error;
+	ff.ztell_file = &Stream::tell;
 	
 	this->handle = unzOpen2(this->zipFile->path().c_str(), &ff);
 
@@ -100,6 +442,66 @@ ZipFile::ZipFile(std::unique_ptr<papki::File> zipFile, const std::string& path)
 
 
 
+void ZipFile::buildIndex(){
+	auto index = utki::makeShared<Index>();
+	
+	//file name length is stored in 16 bits
+	std::vector<char> fileNameBuf(0x10000);
+	
+	int ret = unzGoToFirstFile(this->handle);
+	
+	for(; ret == UNZ_OK; ret = unzGoToNextFile(this->handle)){
+		unz_file_info info;
+		
+		if(unzGetCurrentFileInfo(
+				this->handle,
+				&info,
+				&*fileNameBuf.begin(),
+				uLong(fileNameBuf.size()),
+				NULL,
+				0,
+				NULL,
+				0
+			) != UNZ_OK)
+		{
+			throw papki::Exc("ZipFile::buildIndex(): unzGetCurrentFileInfo() failed.");
+		}
+		
+		fileNameBuf[std::min(size_t(info.size_filename), fileNameBuf.size() - 1)] = 0;
+		
+		Index::Entry e;
+		if(unzGetFilePos(this->handle, &e.pos) != UNZ_OK){
+			throw papki::Exc("ZipFile::buildIndex(): unzGetFilePos() failed.");
+		}
+		
+		e.compressionMethod = info.compression_method;
+		e.compressedSize = info.compressed_size;
+		e.size = info.uncompressed_size;
+		e.crc = info.crc;
+		
+		//not encrypted files are read right from the memory-mapped archive,
+		//uncompressed files are read by their size, which is only bounds-checked as the compressed size, so they have to be equal
+		if(this->archive && (info.flag & 1) == 0 && (e.compressionMethod != 0 || e.size == e.compressedSize)){
+			e.data = findEntryData(*this->archive, e.pos.pos_in_zip_directory, e.compressedSize);
+		}
+		
+		std::string fn(&*fileNameBuf.begin());
+		
+		//if there are several files with the same name, the first one is used, as unzLocateFile() does
+		if(index->entries.insert(std::make_pair(fn, e)).second){
+			index->names.push_back(std::move(fn));
+		}
+	}
+	
+	if(ret != UNZ_END_OF_LIST_OF_FILE){
+		throw papki::Exc("ZipFile::buildIndex(): unzGoToNextFile() failed.");
+	}
+	
+	this->index = std::move(index);
+}
+
+
+
 ZipFile::~ZipFile()noexcept{
 	this->close();//make sure there is no file opened inside zip file
 
@@ -110,23 +512,50 @@ ZipFile::~ZipFile()noexcept{
 
 
 
+std::unique_ptr<papki::File> ZipFile::spawn(){
+	std::unique_ptr<papki::File> zf = this->zipFile->spawn();
+	zf->setPath(this->zipFile->path());
+	
+	//spawned file interface shares the index, the mapping of the archive and the cache
+	return std::unique_ptr<papki::File>(new ZipFile(std::move(zf), this->index, this->archive, this->cache));
+}
+
+
+
 void ZipFile::openInternal(E_Mode mode) {
 	if(mode != File::E_Mode::READ){
 		throw papki::Exc("illegal mode requested, only READ supported inside ZIP file");
 	}
 
-	if(unzLocateFile(this->handle, this->path().c_str(), 0) != UNZ_OK){
+	auto i = this->index->entries.find(this->path());
+	if(i == this->index->entries.end()){
 		std::stringstream ss;
 		ss << "ZipFile::OpenInternal(): file not found: " << this->path();
 		throw papki::Exc(ss.str());
 	}
 
-	{
-		unz_file_info zipFileInfo;
+	if(i->second.isStored()){
+		this->storedPos = i->second.data;
+		this->storedEnd = i->second.data + i->second.size;
+		return;
+	}
+	
+	this->cached = this->cache->get(this->path());
+	if(this->cached){
+		this->storedPos = this->cached->data();
+		this->storedEnd = this->cached->data() + this->cached->size();
+		return;
+	}
+	
+	if(i->second.isDeflated()){
+		this->inflater = utki::makeUnique<Inflater>(i->second);
+		return;
+	}
 
-		if(unzGetCurrentFileInfo(this->handle, &zipFileInfo, 0, 0, 0, 0, 0, 0) != UNZ_OK){
-			throw papki::Exc("failed obtaining file info");
-		}
+	//unzGoToFilePos() takes non-const pointer
+	unz_file_pos pos = i->second.pos;
+	if(unzGoToFilePos(this->handle, &pos) != UNZ_OK){
+		throw papki::Exc("failed locating file");
 	}
 
 	if(unzOpenCurrentFile(this->handle) != UNZ_OK){
@@ -135,6 +564,18 @@ void ZipFile::openInternal(E_Mode mode) {
 }
 
 void ZipFile::closeInternal()const noexcept{
+	if(this->storedPos){
+		this->storedPos = nullptr;
+		this->storedEnd = nullptr;
+		this->cached.reset();
+		return;
+	}
+	
+	if(this->inflater){
+		this->inflater.reset();
+		return;
+	}
+	
 	if(unzCloseCurrentFile(this->handle) == UNZ_CRCERROR){
 		TRACE(<< "[WARNING] ZipFile::Close(): CRC is not good" << std::endl)
 		ASSERT(false)
@@ -142,6 +583,17 @@ void ZipFile::closeInternal()const noexcept{
 }
 
 size_t ZipFile::readInternal(utki::Buf<std::uint8_t> buf)const{
+	if(this->storedPos){
+		size_t n = std::min(buf.size(), size_t(this->storedEnd - this->storedPos));
+		memcpy(buf.begin(), this->storedPos, n);
+		this->storedPos += n;
+		return n;
+	}
+	
+	if(this->inflater){
+		return this->inflater->read(buf);
+	}
+	
 	ASSERT(buf.size() <= unsigned(-1))
 	int numBytesRead = unzReadCurrentFile(this->handle, buf.begin(), unsigned(buf.size()));
 	if(numBytesRead < 0){
@@ -166,7 +618,85 @@ bool ZipFile::exists()const{
 		return true;
 	}
 	
-	return unzLocateFile(this->handle, this->path().c_str(), 0) == UNZ_OK;
+	return this->index->entries.find(this->path()) != this->index->entries.end();
+}
+
+
+
+const utki::Buf<std::uint8_t> ZipFile::storedData(std::shared_ptr<const MappedFile>& archive)const{
+	archive.reset();
+	
+	auto i = this->index->entries.find(this->path());
+	if(i == this->index->entries.end() || !i->second.isStored()){
+		return utki::Buf<std::uint8_t>();
+	}
+	
+	archive = this->archive;
+	return utki::Buf<std::uint8_t>(const_cast<std::uint8_t*>(i->second.data), i->second.size);
+}
+
+
+
+void ZipFile::preload(const std::vector<std::string>& paths, ThreadPool* pool){
+	std::vector<const Index::Entry*> entries;
+	entries.reserve(paths.size());
+	
+	for(auto& p : paths){
+		auto i = this->index->entries.find(p);
+		if(i == this->index->entries.end()){
+			std::stringstream ss;
+			ss << "ZipFile::preload(): file not found: " << p;
+			throw papki::Exc(ss.str());
+		}
+		
+		if(i->second.isStored() || i->second.size == 0 || !this->cache->fits(i->second.size)){
+			entries.push_back(nullptr);
+		}else{
+			entries.push_back(&i->second);
+		}
+	}
+	
+	//Files which cannot be inflated right from the mapping are read through spawned file interfaces,
+	//each group of files is read through its own file interface, so there is one unzip handle per thread.
+	size_t numGroups = std::min(paths.size(), pool ? pool->size() + 1 : 1);
+	
+	auto readGroup = [this, &paths, &entries, numGroups](size_t group){
+		std::unique_ptr<papki::File> fi;
+		
+		for(size_t i = group; i < paths.size(); i += numGroups){
+			auto e = entries[i];
+			if(!e){
+				continue;
+			}
+			
+			Cache::T_Data data;
+			if(e->isDeflated()){
+				data = utki::makeShared<std::vector<std::uint8_t>>(Inflater(*e).readAll());
+			}else{
+				if(!fi){
+					fi = this->spawn();
+				}
+				fi->setPath(paths[i]);
+				data = utki::makeShared<std::vector<std::uint8_t>>(fi->loadWholeFileIntoMemory());
+			}
+			
+			this->cache->put(paths[i], std::move(data));
+		}
+	};
+	
+	if(pool){
+		pool->parallelFor(numGroups, readGroup);
+	}else if(numGroups != 0){
+		readGroup(0);
+	}
+}
+
+
+
+void ZipFile::setCacheSize(size_t size){
+	std::lock_guard<std::mutex> lock(this->cache->mutex);
+	this->cache->capacity = size;
+	this->cache->shrink();
 }
 
 
@@ -186,68 +716,35 @@ std::vector<std::string> ZipFile::listDirContents(size_t maxEntries)const{
 	std::vector<std::string> files;
 
 	//for every file, check if it is in the current directory
-	{
-		//move to first file
-		int ret = unzGoToFirstFile(this->handle);
-
-		if(ret != UNZ_OK){
-			throw papki::Exc("ZipFile::ListDirContents(): unzGoToFirstFile() failed.");
+	for(auto& fn : this->index->names){
+		if(fn.size() <= this->path().size()){
+			continue;
 		}
 
-		do{
-			std::array<char, 255> fileNameBuf;
-
-			if(unzGetCurrentFileInfo(
-					this->handle,
-					NULL,
-					&*fileNameBuf.begin(),
-					uLong(fileNameBuf.size()),
-					NULL,
-					0,
-					NULL,
-					0
-				) != UNZ_OK)
-			{
-				throw papki::Exc("ZipFile::ListDirContents(): unzGetCurrentFileInfo() failed.");
-			}
-
-			fileNameBuf[fileNameBuf.size() - 1] = 0;//null-terminate, just to be on a safe side
-
-			std::string fn(&*fileNameBuf.begin());//filename
-
-			if(fn.size() <= this->path().size()){
-				continue;
-			}
-
-			//check if full file path starts with the this->Path() string
-			if(fn.compare(0, this->path().size(), this->path()) != 0){
-				continue;
-			}
-
-			ASSERT(fn.size() > this->path().size())
-			std::string subfn(fn, this->path().size(), fn.size() - this->path().size());//subfilename
+		//check if full file path starts with the this->Path() string
+		if(fn.compare(0, this->path().size(), this->path()) != 0){
+			continue;
+		}
 
-			size_t slashPos = subfn.find_first_of('/');
+		ASSERT(fn.size() > this->path().size())
+		std::string subfn(fn, this->path().size(), fn.size() - this->path().size());//subfilename
 
-			//check if file is listed
-			if(slashPos == std::string::npos){
-				files.push_back(subfn);
-				continue;
-			}
+		size_t slashPos = subfn.find_first_of('/');
 
-			//if we get here then we need to add a directory
-			ASSERT(subfn.size() >= slashPos + 1)
-			files.push_back(
-					std::string(subfn, 0, slashPos + 1)
-				);
+		//check if file is listed
+		if(slashPos == std::string::npos){
+			files.push_back(subfn);
+			continue;
+		}
 
-			if(files.size() == maxEntries){
-				break;
-			}
-		}while((ret = unzGoToNextFile(this->handle)) == UNZ_OK);
+		//if we get here then we need to add a directory
+		ASSERT(subfn.size() >= slashPos + 1)
+		files.push_back(
+				std::string(subfn, 0, slashPos + 1)
+			);
 
-		if(ret != UNZ_END_OF_LIST_OF_FILE && ret != UNZ_OK){
-			throw papki::Exc("ZipFile::ListDirContents(): unzGoToNextFile() failed.");
+		if(files.size() == maxEntries){
+			break;
 		}
 	}
 
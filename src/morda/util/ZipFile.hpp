@@ -4,17 +4,60 @@
 #include <papki/File.hpp>
 
 #include <memory>
+#include <vector>
 
 
 namespace morda{
 
+class MappedFile;
+class ThreadPool;
+
 /**
- * @brief Undocumented.
+ * @brief File interface to files inside ZIP archive.
+ * Central directory of the archive is read once to a hash index, which is shared by all
+ * file interfaces spawned from this one, so opening a file inside the archive does not scan the directory.
+ * If the archive file can be memory-mapped (see MappedFile::mapOnly()), the archive is read from memory,
+ * uncompressed files are read right from the mapping and compressed files are inflated right from the mapping, bypassing unzip.
+ * Decompressed files can be kept in a cache, see preload().
  */
 class ZipFile : public papki::File{
 	std::unique_ptr<papki::File> zipFile;
 	
+	struct Index;
+	std::shared_ptr<const Index> index;
+	
+	std::shared_ptr<const MappedFile> archive;
+	
+	struct Cache;
+	std::shared_ptr<Cache> cache;
+	
+	struct Stream;
+	std::unique_ptr<Stream> stream;
+	
 	void* handle = nullptr;
+	
+	//currently opened file which is read right from memory, i.e. from the archive mapping or from the cache
+	mutable const std::uint8_t* storedPos = nullptr;
+	mutable const std::uint8_t* storedEnd = nullptr;
+	
+	//keeps contents of currently opened file taken from the cache
+	mutable std::shared_ptr<const std::vector<std::uint8_t>> cached;
+	
+	//currently opened compressed file which is inflated right from the archive mapping
+	struct Inflater;
+	mutable std::unique_ptr<Inflater> inflater;
+	
+	ZipFile(
+			std::unique_ptr<papki::File> zipFile,
+			std::shared_ptr<const Index> index,
+			std::shared_ptr<const MappedFile> archive,
+			std::shared_ptr<Cache> cache
+		);
+	
+	void openArchive();
+	
+	void buildIndex();
+
 public:
 	ZipFile(std::unique_ptr<papki::File> zipFile, const std::string& path = std::string());
 
@@ -27,11 +70,36 @@ public:
 	bool exists() const override;
 	std::vector<std::string> listDirContents(size_t maxEntries = 0)const override;
 	
-	std::unique_ptr<papki::File> spawn()override{
-		std::unique_ptr<papki::File> zf = this->zipFile->spawn();
-		zf->setPath(this->zipFile->path());
-		return utki::makeUnique<ZipFile>(std::move(zf));
-	}
+	std::unique_ptr<papki::File> spawn()override;
+	
+	/**
+	 * @brief Get contents of uncompressed file right from the archive mapping.
+	 * @param archive - receives the archive mapping, which should be kept alive while the contents are used.
+	 *                  It is set to nullptr if the contents are not available.
+	 * @return Contents of the file at the path of this file interface.
+	 *         Empty buffer if the file is compressed, not found or the archive is not memory-mapped.
+	 */
+	const utki::Buf<std::uint8_t> storedData(std::shared_ptr<const MappedFile>& archive)const;
+	
+	/**
+	 * @brief Decompress files to the cache.
+	 * Files are decompressed concurrently. Compressed files of memory-mapped archive are inflated
+	 * right from the mapping, files of other archives are read through file interfaces spawned from this one.
+	 * Decompressed files are put to the cache, which is shared by all file interfaces spawned from this one,
+	 * so opening these files later does not decompress them again.
+	 * The cache keeps most recently used files, so preloading more than the cache size evicts files preloaded earlier.
+	 * Uncompressed files of memory-mapped archive and files which do not fit into the cache are skipped.
+	 * @param paths - paths of files inside the archive.
+	 * @param pool - thread pool to decompress files in parallel, nullptr to do all the work on calling thread.
+	 */
+	void preload(const std::vector<std::string>& paths, ThreadPool* pool = nullptr);
+	
+	/**
+	 * @brief Set size of the cache of decompressed files.
+	 * The cache is shared by all file interfaces spawned from this one. By default the cache size is 4 megabytes.
+	 * @param size - maximum total size of cached files in bytes, 0 disables caching.
+	 */
+	void setCacheSize(size_t size);
 };
 
 
@@ -3,9 +3,14 @@
 #include <utki/debug.hpp>
 #include <utki/config.hpp>
 
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+
 #include "../Morda.hpp"
 
 #include "Image.hpp"
+#include "Etc.hpp"
 
 using namespace morda;
 
@@ -174,6 +179,48 @@ const stob::Node* morda::getProperty(const stob::Node* chain, const char* proper
 
 
 
+std::shared_ptr<const stob::Node> morda::internChain(const stob::Node* chain){
+	if(!chain){
+		return nullptr;
+	}
+	
+	static std::mutex mutex;
+	
+	//chains are keyed by their string representation
+	static std::unordered_map<std::string, std::weak_ptr<const stob::Node>> chains;
+	
+	//number of chains at which the chains which are not referenced anymore are removed from the map
+	static size_t purgeSize = 64;
+	
+	std::string key = chain->chainToString();
+	
+	std::lock_guard<std::mutex> lock(mutex);
+	
+	auto& weak = chains[key];
+	if(auto ret = weak.lock()){
+		return ret;
+	}
+	
+	std::shared_ptr<const stob::Node> ret = chain->cloneChain();
+	weak = ret;
+	
+	if(chains.size() >= purgeSize){
+		for(auto i = chains.begin(); i != chains.end();){
+			if(i->second.expired()){
+				i = chains.erase(i);
+			}else{
+				++i;
+			}
+		}
+		//next purge when the number of chains doubles, so that purging takes amortized constant time
+		purgeSize = std::max(2 * chains.size(), size_t(64));
+	}
+	
+	return ret;
+}
+
+
+
 morda::Texture2D::TexType_e morda::numChannelsToTexType(unsigned numChannels){
 	switch(numChannels){
 		default:
@@ -193,16 +240,56 @@ morda::Texture2D::TexType_e morda::numChannelsToTexType(unsigned numChannels){
 	}
 }
 
-std::shared_ptr<Texture2D> morda::loadTexture(const papki::File& fi){
-	Image image(fi);
-//	TRACE(<< "ResTexture::Load(): image loaded" << std::endl)
-	image.flipVertical();	
+namespace{
+//number of image rows to upload to texture at once
+const unsigned textureUploadBandHeight_c = 64;
+
+class TextureUploader : public Image::BandListener{
+public:
+	std::shared_ptr<Texture2D> tex;
+	kolme::Vec2ui dim;
 	
-	return morda::inst().renderer().factory->createTexture2D(
-			numChannelsToTexType(image.numChannels()),
-			image.dim(),
-			image.buf()
-		);
+	void onBegin(kolme::Vec2ui dim, Image::ColorDepth_e colorDepth)override{
+		this->dim = dim;
+		this->tex = morda::inst().renderer().factory->createTexture2D(
+				numChannelsToTexType(unsigned(colorDepth)),
+				dim,
+				utki::Buf<std::uint8_t>()
+			);
+	}
+	
+	void onBand(Image& band, unsigned firstRow)override{
+		ASSERT(this->tex)
+		
+		//texture rows go from bottom to top
+		band.flipVertical();
+		this->tex->updateRegion(
+				kolme::Rectangle<unsigned>(0, this->dim.y - firstRow - band.dim().y, band.dim().x, band.dim().y),
+				band.buf()
+			);
+	}
+};
+}
+
+std::shared_ptr<Texture2D> morda::loadTexture(const papki::File& fi, const Image::LoadOptions& options){
+	if(fi.ext() == "ktx"){
+		auto image = etc::loadKtx(fi);
+		auto& factory = morda::inst().renderer().factory;
+		if(factory->isSupported(image.type)){
+			return factory->createTexture2D(image.type, image.dim, utki::wrapBuf(image.data));
+		}
+		
+		//render backend cannot sample compressed textures, decompress on CPU,
+		//KTX data rows are in texture order already, so no flipping is needed
+		Image im = etc::decode(image, &morda::inst().threadPool());
+		return factory->createTexture2D(numChannelsToTexType(im.numChannels()), im.dim(), im.buf());
+	}
+	
+	TextureUploader uploader;
+	Image::loadInBands(fi, uploader, textureUploadBandHeight_c, options);
+//	TRACE(<< "ResTexture::Load(): image loaded" << std::endl)
+	ASSERT(uploader.tex)
+	return std::move(uploader.tex);
 }
 
 
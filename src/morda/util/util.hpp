@@ -14,6 +14,8 @@
 #include "../render/Texture2D.hpp"
 #include "../render/RenderFactory.hpp"
 
+#include "Image.hpp"
+
 namespace morda{
 
 
@@ -114,12 +116,29 @@ std::tuple<std::unique_ptr<stob::Node>, stob::Node*> resolveIncludes(papki::File
  */
 const stob::Node* getProperty(const stob::Node* chain, const char* property);
 
+/**
+ * @brief Get shared immutable copy of STOB chain.
+ * Equal chains share the same copy, so, for example, widgets having the same layout
+ * parameters keep one copy of those instead of each widget keeping its own clone.
+ * Copies are kept while they are referenced.
+ * This function is thread-safe.
+ * @param chain - STOB chain to get a copy of.
+ * @return Shared copy of the chain.
+ * @return nullptr if nullptr is passed.
+ */
+std::shared_ptr<const stob::Node> internChain(const stob::Node* chain);
+
 /**
  * @brief Load texture from file.
+ * The image is uploaded to the texture in bands as it is decoded, so the whole
+ * decoded image is not kept in memory.
+ * KTX files with ETC2 compressed data (see etc::saveKtx()) are uploaded as compressed textures
+ * if render backend supports those, and are decompressed on CPU otherwise.
  * @param fi - file to load texture from.
+ * @param options - image loading options, ignored for KTX files.
  * @return Loaded texture.
  */
-std::shared_ptr<Texture2D> loadTexture(const papki::File& fi);
+std::shared_ptr<Texture2D> loadTexture(const papki::File& fi, const Image::LoadOptions& options = Image::LoadOptions());
 
 
 /**
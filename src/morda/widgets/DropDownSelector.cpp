@@ -223,9 +223,12 @@ std::shared_ptr<Widget> DropDownSelector::wrapItem(std::shared_ptr<Widget>&& w,
 			if(!oc){
 				throw Exc("No Overlay found in ancestors of DropDownSelector");
 			}
-			morda::Morda::inst().postToUiThread_ts([oc](){
-				oc->hideContextMenu();
-			});
+			morda::Morda::inst().postToUiQueue_ts(
+					[oc](){
+						oc->hideContextMenu();
+					},
+					UiQueue::Priority_e::INPUT
+				);
 		}
 
 		return true;
@@ -2,6 +2,8 @@
 
 #include "../Morda.hpp"
 
+#include <chrono>
+
 
 
 using namespace morda;
@@ -85,6 +87,10 @@ void List::setItemsProvider(std::shared_ptr<ItemsProvider> provider){
 	this->provider = std::move(provider);
 	if(this->provider){
 		this->provider->list = this;
+		
+		//the whole list is rebuilt anyway
+		this->provider->pendingChanges.clear();
+		this->provider->dataSetChangePending = false;
 	}
 	this->handleDataSetChanged();
 }
@@ -96,19 +102,7 @@ real List::scrollFactor()const noexcept{
 		return 0;
 	}
 	
-	if(this->children().size() == 0){
-		return 0;
-	}
-	
-	ASSERT(this->provider->count() >= this->numTailItems)
-	
-	size_t length = this->provider->count() - this->numTailItems;
-	
-	if(length == 0){
-		return 0;
-	}
-	
-	if(this->numTailItems == 0){
+	if(this->extents.size() != this->provider->count() || this->posIndex >= this->extents.size()){
 		return 0;
 	}
 	
@@ -119,14 +113,15 @@ real List::scrollFactor()const noexcept{
 		d = this->rect().d.x;
 	}
 	
-	ASSERT(this->numTailItems != 0)
-	d = (d + this->firstTailItemOffset) / this->numTailItems;
+	double maxPos = this->extents.total() - double(d);
 	
-	if(d <= 0){
+	if(maxPos <= 0){
 		return 0;
 	}
 	
-	return (real(this->posIndex) * d + this->posOffset) / (real(length) * d + this->firstTailItemOffset);
+	double pos = this->extents.offset(this->posIndex) + double(this->posOffset);
+	
+	return utki::clampedRange(real(pos / maxPos), real(0), real(1));
 }
 
 
@@ -135,33 +130,39 @@ void List::setScrollPosAsFactor(real factor){
 		return;
 	}
 	
+	this->resetExtentsIfNeeded();
+	
 	if(this->numTailItems == 0){
 		this->updateTailItemsInfo();
 	}
 	
-	this->posIndex = size_t(factor * real(this->provider->count() - this->numTailItems));
+	real d;
+	if(this->isVertical()){
+		d = this->rect().d.y;
+	}else{
+		d = this->rect().d.x;
+	}
+	
+	double maxPos = this->extents.total() - double(d);
+	if(maxPos <= 0){
+		//all items fit, or no items are measured, so offsets cannot be estimated
+		this->posIndex = 0;
+		this->posOffset = 0;
+		this->updateChildrenList();
+		return;
+	}
+	
+	double itemOffset;
+	this->posIndex = this->extents.indexAt(double(factor) * maxPos, itemOffset);
 	
 //	TRACE(<< "List::setScrollPosAsFactor(): this->posIndex = " << this->posIndex << std::endl)
 	
-	if(this->provider->count() != this->numTailItems){
-		real intFactor = real(this->posIndex) / real(this->provider->count() - this->numTailItems);
-
-		if(this->children().size() != 0){
-			real d;
-			if(this->isVertical()){
-				d = this->rect().d.y;
-			}else{
-				d = this->rect().d.x;
-			}
-			d = (d + this->firstTailItemOffset) / this->numTailItems;
-			
-			this->posOffset = ::round(d * (factor - intFactor) * real(this->provider->count() - this->numTailItems) + factor * this->firstTailItemOffset);
-		}else{
-			this->posOffset = 0;
-		}
+	if(this->posIndex < this->provider->count()){
+		this->posOffset = ::round(real(itemOffset));
 	}else{
-		ASSERT(this->posIndex == 0)
-		this->posOffset = ::round(factor * this->firstTailItemOffset);
+		//beyond the end, will be corrected to tail items position
+		this->posIndex = this->firstTailItemIndex;
+		this->posOffset = this->firstTailItemOffset;
 	}
 	
 	this->updateChildrenList();
@@ -171,6 +172,8 @@ bool List::arrangeWidget(std::shared_ptr<Widget>& w, real& pos, bool added, size
 	auto& lp = this->getLayoutParamsDuringLayoutAs<LayoutParams>(*w);
 		
 	Vec2r dim = this->dimForWidget(*w, lp);
+	
+	this->extents.set(index, this->isVertical() ? dim.y : dim.x);
 
 	w->resize(dim);
 
@@ -190,14 +193,10 @@ bool List::arrangeWidget(std::shared_ptr<Widget>& w, real& pos, bool added, size
 			this->posOffset -= w->rect().d.y;
 			if(added){
 				auto widget = this->remove(*w);
-				if(this->provider){
-					this->provider->recycle(index, widget);
-				}
+				this->recycleItemWidget(index, std::move(widget));
 				++this->addedIndex;
 			}else{
-				if(this->provider){
-					this->provider->recycle(index, w);
-				}
+				this->recycleItemWidget(index, w);
 			}
 		}
 
@@ -220,14 +219,10 @@ bool List::arrangeWidget(std::shared_ptr<Widget>& w, real& pos, bool added, size
 			this->posOffset -= w->rect().d.x;
 			if(added){
 				auto widget = this->remove(*w);
-				if(this->provider){
-					this->provider->recycle(index, widget);
-				}
+				this->recycleItemWidget(index, std::move(widget));
 				++this->addedIndex;
 			}else{
-				if(this->provider){
-					this->provider->recycle(index, w);
-				}
+				this->recycleItemWidget(index, w);
 			}
 		}
 
@@ -246,9 +241,12 @@ void List::updateChildrenList(){
 		
 		this->removeAll();
 		this->addedIndex = size_t(-1);
+		this->prefetched.clear();
 		return;
 	}
 	
+	this->resetExtentsIfNeeded();
+	
 	if(this->numTailItems == 0){
 		this->updateTailItemsInfo();
 	}
@@ -275,9 +273,7 @@ void List::updateChildrenList(){
 	//remove widgets from top
 	for(; this->children().size() != 0 && this->addedIndex < this->posIndex; ++this->addedIndex){
 		auto w = (*this->children().begin())->removeFromParent();
-		if(this->provider){
-			this->provider->recycle(this->addedIndex, w);
-		}
+		this->recycleItemWidget(this->addedIndex, std::move(w));
 	}
 	
 	auto iter = this->children().begin();
@@ -293,7 +289,7 @@ void List::updateChildrenList(){
 			++iterIndex;
 			isAdded = true;
 		}else{
-			w = this->provider->getWidget(index);
+			w = this->getItemWidget(index);
 			isAdded = false;
 		}
 		
@@ -315,20 +311,51 @@ void List::updateChildrenList(){
 				break;
 			}
 			auto w = this->remove(i);
-			if(this->provider){
-				this->provider->recycle(iterIndex, w);
-			}
+			this->recycleItemWidget(iterIndex, std::move(w));
 		}
 		auto w = this->remove(iter);
-		if(this->provider){
-			this->provider->recycle(oldIterIndex, w);
-		}
+		this->recycleItemWidget(oldIterIndex, std::move(w));
 	}
 	
+	this->updatePrefetch();
+}
+
+
+
+
+real List::measureItem(Widget& w, size_t index){
+	auto& lp = this->getLayoutParamsDuringLayoutAs<LayoutParams>(w);
+	
+	Vec2r d = this->dimForWidget(w, lp);
+	
+	real ret = this->isVertical() ? d.y : d.x;
+	
+	this->extents.set(index, ret);
+	
+	return ret;
 }
 
 
 
+void List::resetExtentsIfNeeded(){
+	if(!this->provider){
+		this->extents.reset(0);
+		return;
+	}
+	
+	//extents along the list direction may depend on the transverse dimension, e.g. in case of word wrapping
+	real transDim = this->isVertical() ? this->rect().d.x : this->rect().d.y;
+	
+	if(this->extents.size() != this->provider->count() || this->extentsTransDim != transDim){
+		this->extents.reset(this->provider->count());
+		this->extentsTransDim = transDim;
+		
+		//tail items info relies on the extents
+		this->numTailItems = 0;
+	}
+}
+
+
 
 void List::updateTailItemsInfo(){
 	this->numTailItems = 0;
@@ -337,6 +364,8 @@ void List::updateTailItemsInfo(){
 		return;
 	}
 	
+	this->resetExtentsIfNeeded();
+	
 	real dim;
 	
 	if(this->isVertical()){
@@ -351,18 +380,17 @@ void List::updateTailItemsInfo(){
 	for(size_t i = this->provider->count(); i != 0 && dim > 0; --i){
 		++this->numTailItems;
 		
+		if(this->extents.isMeasured(i - 1)){
+			dim -= this->extents.extent(i - 1);
+			continue;
+		}
+		
 		auto w = this->provider->getWidget(i - 1);
 		ASSERT(w)
 		
-		auto& lp = this->getLayoutParamsDuringLayoutAs<LayoutParams>(*w);
+		dim -= this->measureItem(*w, i - 1);
 		
-		Vec2r d = this->dimForWidget(*w, lp);
-		
-		if(this->isVertical()){
-			dim -= d.y;
-		}else{
-			dim -= d.x;
-		}
+		this->provider->recycle(i - 1, std::move(w));
 	}
 	
 	this->firstTailItemIndex = this->provider->count() - this->numTailItems;
@@ -379,6 +407,8 @@ void List::scrollBy(real delta) {
 		return;
 	}
 	
+	this->resetExtentsIfNeeded();
+	
 	unsigned longIndex;
 //	unsigned transIndex;
 	
@@ -414,15 +444,14 @@ void List::scrollBy(real delta) {
 					<< " this->children().size() = " << this->children().size()
 				)
 			for(; this->posIndex < this->firstTailItemIndex;){
-				auto w = this->provider->getWidget(this->posIndex);
-				auto& lp = this->getLayoutParamsDuringLayoutAs<LayoutParams>(*w);
-				Vec2r d = this->dimForWidget(*w, lp);
+				auto w = this->getItemWidget(this->posIndex);
+				real d = this->measureItem(*w, this->posIndex);
 				this->add(w); //this is just optimization, to avoid creating same widget twice
-				if(d[longIndex] > delta){
+				if(d > delta){
 					this->posOffset = delta;
 					break;
 				}
-				delta -= d[longIndex];
+				delta -= d;
 				ASSERT(this->posOffset == 0)
 				++this->posIndex;
 			}
@@ -438,16 +467,15 @@ void List::scrollBy(real delta) {
 			for(; this->posIndex > 0;){
 				ASSERT(this->addedIndex == this->posIndex)
 				--this->posIndex;
-				auto w = this->provider->getWidget(this->posIndex);
-				auto& lp = this->getLayoutParamsDuringLayoutAs<LayoutParams>(*w);
-				Vec2r d = this->dimForWidget(*w, lp);
+				auto w = this->getItemWidget(this->posIndex);
+				real d = this->measureItem(*w, this->posIndex);
 				this->add(w, this->children().begin()); //this is just optimization, to avoid creating same widget twice
 				--this->addedIndex;
-				if(d[longIndex] > delta){
-					this->posOffset = d[longIndex] - delta;
+				if(d > delta){
+					this->posOffset = d - delta;
 					break;
 				}
-				delta -= d[longIndex];
+				delta -= d;
 			}
 		}
 	}
@@ -483,20 +511,479 @@ morda::Vec2r List::measure(const morda::Vec2r& quotum) const {
 	return ret;
 }
 
+size_t List::indexOf(const Widget& w)const noexcept{
+	size_t index = this->addedIndex;
+	for(auto& c : this->children()){
+		if(c.get() == &w){
+			return index;
+		}
+		++index;
+	}
+	return size_t(-1);
+}
+
+
+
+std::shared_ptr<Widget> List::getItemWidget(size_t index){
+	ASSERT(this->provider)
+	
+	auto i = this->prefetched.find(index);
+	if(i != this->prefetched.end()){
+		auto ret = std::move(i->second);
+		this->prefetched.erase(i);
+		return ret;
+	}
+	
+	return this->provider->getWidget(index);
+}
+
+
+
+void List::recycleItemWidget(size_t index, std::shared_ptr<Widget> w){
+	if(!this->provider){
+		return;
+	}
+	
+	if(this->prefetchBefore != 0 || this->prefetchAfter != 0){
+		size_t begin, end;
+		this->getPrefetchRange(begin, end);
+		if(begin <= index && index < end){
+			//still within prefetch window, keep it
+			this->prefetched[index] = std::move(w);
+			return;
+		}
+	}
+	
+	this->provider->recycle(index, std::move(w));
+}
+
+
+
+void List::getPrefetchRange(size_t& begin, size_t& end)const{
+	ASSERT(this->provider)
+	
+	size_t visibleEnd = this->children().size() == 0 ? this->posIndex : this->addedIndex + this->children().size();
+	
+	begin = this->posIndex > this->prefetchBefore ? this->posIndex - this->prefetchBefore : 0;
+	end = std::min(visibleEnd + this->prefetchAfter, this->provider->count());
+}
+
+
+
+void List::setPrefetch(size_t before, size_t after, std::uint32_t budgetMs){
+	this->prefetchBefore = before;
+	this->prefetchAfter = after;
+	this->prefetchBudget = budgetMs;
+	
+	this->updatePrefetch();
+}
+
+
+
+void List::updatePrefetch(){
+	if(!this->provider){
+		this->prefetched.clear();
+		return;
+	}
+	
+	size_t begin, end;
+	this->getPrefetchRange(begin, end);
+	
+	//recycle widgets which went out of prefetch window
+	for(auto i = this->prefetched.begin(); i != this->prefetched.end();){
+		if(begin <= i->first && i->first < end){
+			++i;
+			continue;
+		}
+		this->provider->recycle(i->first, std::move(i->second));
+		i = this->prefetched.erase(i);
+	}
+	
+	if(this->prefetchBefore == 0 && this->prefetchAfter == 0){
+		return;
+	}
+	
+	if(begin != this->hintedBegin || end != this->hintedEnd){
+		this->hintedBegin = begin;
+		this->hintedEnd = end;
+		this->provider->prefetchHint(begin, end);
+	}
+	
+	if(!this->isUpdating() && this->prefetched.size() + this->children().size() < end - begin){
+		this->startUpdating(0);
+	}
+}
+
+
+
+void List::update(std::uint32_t dt){
+	if(!this->provider || this->extents.size() != this->provider->count()){
+		//will be restarted after the list is updated
+		this->stopUpdating();
+		return;
+	}
+	
+	typedef std::chrono::steady_clock Clock;
+	auto deadline = Clock::now() + std::chrono::milliseconds(this->prefetchBudget);
+	
+	size_t begin, end;
+	this->getPrefetchRange(begin, end);
+	
+	size_t visibleBegin = this->children().size() == 0 ? this->posIndex : this->addedIndex;
+	size_t visibleEnd = this->children().size() == 0 ? this->posIndex : this->addedIndex + this->children().size();
+	
+	//prepare items after the visible ones first, then the ones before, closest first
+	std::vector<size_t> indices;
+	for(size_t i = visibleEnd; i < end; ++i){
+		indices.push_back(i);
+	}
+	for(size_t i = visibleBegin; i > begin; --i){
+		indices.push_back(i - 1);
+	}
+	
+	for(auto i : indices){
+		if(this->prefetched.find(i) != this->prefetched.end()){
+			continue;
+		}
+		
+		if(Clock::now() >= deadline){
+			return;
+		}
+		
+		auto w = this->provider->getWidget(i);
+		ASSERT(w)
+		this->measureItem(*w, i);
+		this->prefetched[i] = std::move(w);
+	}
+	
+	//everything is prepared
+	this->stopUpdating();
+}
+
+
+
+std::shared_ptr<Widget> List::ItemsProvider::takeRecycled(unsigned type){
+	auto i = this->recycled.find(type);
+	if(i == this->recycled.end() || i->second.size() == 0){
+		return nullptr;
+	}
+	
+	auto ret = std::move(i->second.back());
+	i->second.pop_back();
+	return ret;
+}
+
+
+
+void List::ItemsProvider::putRecycled(unsigned type, std::shared_ptr<Widget> w){
+	ASSERT(w)
+	ASSERT(!w->parent())
+	
+	//keep enough widgets to fill the list twice
+	size_t maxSize = 32;
+	if(this->list){
+		utki::clampBottom(maxSize, this->list->visibleCount() * 2);
+	}
+	
+	auto& v = this->recycled[type];
+	if(v.size() >= maxSize){
+		return;
+	}
+	v.push_back(std::move(w));
+}
+
+
+
 void List::ItemsProvider::notifyDataSetChanged() {
 	if (!this->list) {
 		return;
 	}
 	
-	Morda::inst().postToUiThread_ts(
-		[this](){
-			this->list->handleDataSetChanged();
-		}
+	//full rebuild makes any item changes irrelevant
+	this->pendingChanges.clear();
+	this->dataSetChangePending = true;
+	
+	if(this->changesPosted){
+		return;
+	}
+	this->changesPosted = true;
+	
+	auto p = this->sharedFromThis(this);
+	Morda::inst().postToUiQueue_ts(
+		[p](){
+			p->changesPosted = false;
+			if(p->list){
+				p->list->handleItemsChanged();
+			}
+		},
+		UiQueue::Priority_e::LAYOUT
 	);
 }
 
+
+
+void List::ItemsProvider::postChange(Change::Type_e type, size_t index, size_t num, size_t to){
+	if(!this->list || num == 0){
+		return;
+	}
+	
+	if(!this->dataSetChangePending){
+		Change c;
+		c.type = type;
+		c.index = index;
+		c.num = num;
+		c.to = to;
+		this->pendingChanges.push_back(c);
+	}
+	
+	if(this->changesPosted){
+		return;
+	}
+	this->changesPosted = true;
+	
+	auto p = this->sharedFromThis(this);
+	Morda::inst().postToUiQueue_ts(
+		[p](){
+			p->changesPosted = false;
+			if(p->list){
+				p->list->handleItemsChanged();
+			}
+		},
+		UiQueue::Priority_e::LAYOUT
+	);
+}
+
+
+
+void List::ItemsProvider::notifyItemsInserted(size_t index, size_t num){
+	this->postChange(Change::Type_e::INSERTED, index, num);
+}
+
+
+
+void List::ItemsProvider::notifyItemsRemoved(size_t index, size_t num){
+	this->postChange(Change::Type_e::REMOVED, index, num);
+}
+
+
+
+void List::ItemsProvider::notifyItemsChanged(size_t index, size_t num){
+	this->postChange(Change::Type_e::CHANGED, index, num);
+}
+
+
+
+void List::ItemsProvider::notifyItemsMoved(size_t from, size_t to, size_t num){
+	if(from == to){
+		return;
+	}
+	this->postChange(Change::Type_e::MOVED, from, num, to);
+}
+
+
+
+void List::handleItemsChanged(){
+	ASSERT(this->provider)
+	
+	if(this->provider->dataSetChangePending){
+		this->provider->dataSetChangePending = false;
+		this->provider->pendingChanges.clear();
+		this->handleDataSetChanged();
+		return;
+	}
+	
+	if(this->provider->pendingChanges.size() == 0){
+		return;
+	}
+	
+	//extents table might have not been initialized yet, in that case just rebuild
+	bool rebuild = this->extents.size() == 0 && this->children().size() == 0;
+	
+	decltype(this->provider->pendingChanges) changes;
+	std::swap(changes, this->provider->pendingChanges);
+	
+	if(!rebuild){
+		for(auto& c : changes){
+			if(!this->applyChange(c)){
+				//notifications do not match the data model, the rest of the changes cannot be applied
+				TRACE(<< "List::handleItemsChanged(): item notification does not match the list, rebuilding" << std::endl)
+				rebuild = true;
+				break;
+			}
+		}
+		
+		if(!rebuild && this->extents.size() != this->provider->count()){
+			//notifications do not match the data model
+			TRACE(<< "List::handleItemsChanged(): item notifications do not match number of items, rebuilding" << std::endl)
+			rebuild = true;
+		}
+	}
+	
+	if(rebuild){
+		this->handleDataSetChanged();
+		return;
+	}
+	
+	this->numTailItems = 0; //means that it needs to be recomputed
+	this->hintedBegin = 0;
+	this->hintedEnd = 0;
+	
+	this->updateChildrenList();
+	
+	if (this->dataSetChanged) {
+		this->dataSetChanged(*this);
+	}
+}
+
+
+
+void List::remapItemWidgets(size_t first, const std::function<size_t(size_t)>& map){
+	//remap prefetched widgets
+	{
+		decltype(this->prefetched) remapped;
+		for(auto& p : this->prefetched){
+			size_t i = p.first < first ? p.first : map(p.first);
+			if(i != size_t(-1)){
+				remapped[i] = std::move(p.second);
+			}else{
+				this->provider->recycleDropped(std::move(p.second));
+			}
+		}
+		std::swap(remapped, this->prefetched);
+	}
+	
+	//Children before the first affected item are kept in place. The rest are detached
+	//and kept as prefetched, so that they are picked up again when the children list is updated.
+	size_t index = this->addedIndex;
+	for(auto i = this->children().begin(); i != this->children().end(); ++index){
+		if(index < first){
+			++i;
+			continue;
+		}
+		
+		auto w = this->remove(i++);
+		size_t newIndex = map(index);
+		if(newIndex != size_t(-1)){
+			this->prefetched[newIndex] = std::move(w);
+		}else{
+			this->provider->recycleDropped(std::move(w));
+		}
+	}
+	
+	if(this->children().size() == 0){
+		this->addedIndex = size_t(-1);
+	}
+}
+
+
+
+bool List::applyChange(const ItemsProvider::Change& c){
+	typedef ItemsProvider::Change::Type_e Type_e;
+	
+	switch(c.type){
+		case Type_e::INSERTED:
+			if(c.index > this->extents.size()){
+				//notification does not match the data model, list will be rebuilt
+				return false;
+			}
+			this->extents.insert(c.index, c.num);
+			this->remapItemWidgets(
+					c.index,
+					[&c](size_t i){
+						return i + c.num;
+					}
+				);
+			//keep the first visible item in place, unless new items are inserted right before its beginning
+			if(c.index < this->posIndex || (c.index == this->posIndex && this->posOffset > 0)){
+				this->posIndex += c.num;
+			}
+			break;
+		case Type_e::REMOVED:
+			if(c.index + c.num > this->extents.size()){
+				return false;
+			}
+			this->extents.erase(c.index, c.num);
+			this->remapItemWidgets(
+					c.index,
+					[&c](size_t i){
+						if(i < c.index + c.num){
+							return size_t(-1);
+						}
+						return i - c.num;
+					}
+				);
+			if(c.index + c.num <= this->posIndex){
+				this->posIndex -= c.num;
+			}else if(c.index <= this->posIndex){
+				//first visible item was removed, next one takes its place
+				this->posIndex = c.index;
+				this->posOffset = 0;
+			}
+			break;
+		case Type_e::CHANGED:
+			if(c.index + c.num > this->extents.size()){
+				return false;
+			}
+			for(size_t i = c.index; i != c.index + c.num; ++i){
+				this->extents.invalidate(i);
+			}
+			this->remapItemWidgets(
+					c.index,
+					[&c](size_t i){
+						if(i < c.index + c.num){
+							return size_t(-1);
+						}
+						return i;
+					}
+				);
+			if(c.index <= this->posIndex && this->posIndex < c.index + c.num){
+				//extent of the first visible item might have changed
+				this->posOffset = 0;
+			}
+			break;
+		case Type_e::MOVED:
+			if(c.index + c.num > this->extents.size() || c.to + c.num > this->extents.size()){
+				return false;
+			}
+			{
+				this->extents.move(c.index, c.to, c.num);
+				
+				auto map = [&c](size_t i){
+					if(c.index <= i && i < c.index + c.num){
+						return c.to + (i - c.index);
+					}
+					if(i >= c.index + c.num){
+						i -= c.num;
+					}
+					if(i >= c.to){
+						i += c.num;
+					}
+					return i;
+				};
+				
+				this->remapItemWidgets(std::min(c.index, c.to), map);
+				
+				if(c.index <= this->posIndex && this->posIndex < c.index + c.num){
+					//first visible item was moved away, keep the scroll position
+					this->posOffset = 0;
+				}else{
+					this->posIndex = map(this->posIndex);
+				}
+			}
+			break;
+	}
+	return true;
+}
+
 void List::handleDataSetChanged() {
 	this->numTailItems = 0; //means that it needs to be recomputed
+	
+	this->extents.reset(this->provider ? this->provider->count() : 0);
+	
+	//item indices are not valid anymore
+	this->prefetched.clear();
+	this->hintedBegin = 0;
+	this->hintedEnd = 0;
 
 	this->removeAll();
 	this->addedIndex = size_t(-1);
@@ -3,6 +3,14 @@
 #include "core/Widget.hpp"
 #include "core/container/Container.hpp"
 
+#include "../util/ExtentTable.hpp"
+
+#include "../Updateable.hpp"
+
+#include <map>
+#include <vector>
+#include <functional>
+
 namespace morda{
 
 /**
@@ -13,7 +21,8 @@ class List :
 		//NOTE: order of virtual public and private declarations here matters for clang due to some bug,
 		//      see http://stackoverflow.com/questions/42427145/clang-cannot-cast-to-private-base-while-there-is-a-public-virtual-inheritance
 		virtual public Widget,
-		private Container
+		private Container,
+		private Updateable
 {
 	//index of the first item added to container as child
 	size_t addedIndex = size_t(-1);
@@ -24,6 +33,23 @@ class List :
 	size_t numTailItems = 0;//Zero means that number of tail items has to be recomputed
 	size_t firstTailItemIndex = 0;
 	real firstTailItemOffset = real(0);
+	
+	//extents of items along the list direction
+	ExtentTable extents;
+	
+	//transverse dimension the extents were measured for
+	real extentsTransDim = real(-1);
+	
+	size_t prefetchBefore = 0;
+	size_t prefetchAfter = 0;
+	std::uint32_t prefetchBudget = 2;
+	
+	//widgets prepared for items which are not visible, by item index
+	std::map<size_t, std::shared_ptr<Widget>> prefetched;
+	
+	//last prefetch range the provider was notified about
+	size_t hintedBegin = 0;
+	size_t hintedEnd = 0;
 
 	const bool isVertical_v;
 	
@@ -41,8 +67,48 @@ public:
 		friend class List;
 		
 		List* list = nullptr;
+		
+		struct Change{
+			enum class Type_e{
+				INSERTED,
+				REMOVED,
+				CHANGED,
+				MOVED
+			} type;
+			size_t index;
+			size_t num;
+			size_t to;
+		};
+		
+		//changes accumulated since the last time they were applied to the list
+		std::vector<Change> pendingChanges;
+		bool dataSetChangePending = false;
+		bool changesPosted = false;
+		
+		void postChange(Change::Type_e type, size_t index, size_t num, size_t to = 0);
+		
+		//recycled widgets by item type
+		std::map<unsigned, std::vector<std::shared_ptr<Widget>>> recycled;
 	protected:
 		ItemsProvider(){}
+		
+		/**
+		 * @brief Take widget from recycle pool.
+		 * Call this function from getWidget() to reuse a previously recycled widget instead of creating a new one.
+		 * Widgets get to the pool only if the provider puts them there with putRecycled(), e.g. from recycle().
+		 * @param type - item type of the widget to take, see itemType().
+		 * @return Recycled widget of the requested type.
+		 * @return nullptr if there are no recycled widgets of the requested type.
+		 */
+		std::shared_ptr<Widget> takeRecycled(unsigned type);
+		
+		/**
+		 * @brief Put widget to recycle pool.
+		 * Number of widgets kept in recycle pool is limited, excess widgets are dropped.
+		 * @param type - item type of the widget.
+		 * @param w - widget to put to recycle pool.
+		 */
+		void putRecycled(unsigned type, std::shared_ptr<Widget> w);
 	public:
 		/**
 		 * @brief Get total number of items in the list.
@@ -57,14 +123,89 @@ public:
 		 */
 		virtual std::shared_ptr<Widget> getWidget(size_t index) = 0;
 		
+		/**
+		 * @brief Get item type.
+		 * Widgets of items of the same type are interchangeable, i.e. widget of one item can be
+		 * reused for another item of the same type.
+		 * @param index - index of the item.
+		 * @return Type of the item.
+		 */
+		virtual unsigned itemType(size_t index)const noexcept{
+			return 0;
+		}
+		
 		/**
 		 * @brief Recycle widget of item.
+		 * Called when the widget of an item is not needed by the list anymore.
+		 * Default implementation drops the widget. Providers which reuse widgets can put the widget
+		 * to recycle pool with putRecycled(), so that it can be later obtained with takeRecycled()
+		 * from within getWidget().
 		 * @param index - index of item to recycle widget of.
 		 * @param w - widget to recycle.
 		 */
 		virtual void recycle(size_t index, std::shared_ptr<Widget> w){}
 		
+		/**
+		 * @brief Recycle widget of removed or changed item.
+		 * Called for widgets of items which were removed or changed. Such item is not present in
+		 * the model anymore, so the widget cannot be recycled by item index.
+		 * Default implementation drops the widget.
+		 * @param w - widget to recycle.
+		 */
+		virtual void recycleDropped(std::shared_ptr<Widget> w){}
+		
+		/**
+		 * @brief Prefetch hint.
+		 * Called when the range of items the list is going to request widgets for changes.
+		 * The range includes visible items and items within the prefetch window, see List::setPrefetch().
+		 * Data-backed providers can use it to load data for the whole range in one go.
+		 * @param begin - index of the first item in the range.
+		 * @param end - index of the item after the last one in the range.
+		 */
+		virtual void prefetchHint(size_t begin, size_t end){}
+		
+		/**
+		 * @brief Notify list that whole data set has changed.
+		 * All widgets of the list will be recreated.
+		 */
 		void notifyDataSetChanged();
+		
+		/**
+		 * @brief Notify list that items were inserted.
+		 * Only the widgets of affected items are updated, scroll position stays on the same item.
+		 * Notifications made within one UI update are applied to the list at once.
+		 * Item notifications should be called from UI thread, right after the data model was changed.
+		 * @param index - index of the first inserted item.
+		 * @param num - number of inserted items.
+		 */
+		void notifyItemsInserted(size_t index, size_t num = 1);
+		
+		/**
+		 * @brief Notify list that items were removed.
+		 * See notifyItemsInserted() for details.
+		 * @param index - index of the first removed item, before removal.
+		 * @param num - number of removed items.
+		 */
+		void notifyItemsRemoved(size_t index, size_t num = 1);
+		
+		/**
+		 * @brief Notify list that items have changed.
+		 * Widgets of the changed items will be recreated.
+		 * See notifyItemsInserted() for details.
+		 * @param index - index of the first changed item.
+		 * @param num - number of changed items.
+		 */
+		void notifyItemsChanged(size_t index, size_t num = 1);
+		
+		/**
+		 * @brief Notify list that items were moved.
+		 * Widgets of the moved items are kept.
+		 * See notifyItemsInserted() for details.
+		 * @param from - index of the first moved item before the move.
+		 * @param to - index of the first moved item after the move.
+		 * @param num - number of moved items.
+		 */
+		void notifyItemsMoved(size_t from, size_t to, size_t num = 1);
 	};
 	
 	void setItemsProvider(std::shared_ptr<ItemsProvider> provider = nullptr);
@@ -86,6 +227,14 @@ public:
 		return this->children().size();
 	}
 	
+	/**
+	 * @brief Get index of the item shown by the widget.
+	 * @param w - widget to get item index for.
+	 * @return Index of the item if the widget is currently visible in the list.
+	 * @return size_t(-1) otherwise.
+	 */
+	size_t indexOf(const Widget& w)const noexcept;
+	
 	/**
 	 * @brief Set scroll position as factor from [0:1].
 	 * @param factor - factor of the scroll position to set.
@@ -104,6 +253,19 @@ public:
 	 */
 	void scrollBy(real delta);
 	
+	/**
+	 * @brief Set prefetch window.
+	 * Widgets for items which are close to the visible ones are prepared in advance, so that
+	 * they do not need to be created at the moment they become visible. Preparation is done
+	 * in small portions on each UI update, within the given time budget.
+	 * Widgets of items which went out of sight but are still within the prefetch window are
+	 * kept instead of being recycled.
+	 * @param before - number of items before the first visible item to prepare.
+	 * @param after - number of items after the last visible item to prepare.
+	 * @param budgetMs - maximum time in milliseconds to spend on preparing items per UI update.
+	 */
+	void setPrefetch(size_t before, size_t after, std::uint32_t budgetMs = 2);
+	
 	/**
 	 * @brief Data set changed signal.
 	 * Emitted when list widget contents have actually been updated due to change in provider's model data set.
@@ -119,7 +281,29 @@ private:
 	
 	void updateTailItemsInfo();
 	
+	real measureItem(Widget& w, size_t index);
+	
+	void resetExtentsIfNeeded();
+	
+	std::shared_ptr<Widget> getItemWidget(size_t index);
+	
+	void recycleItemWidget(size_t index, std::shared_ptr<Widget> w);
+	
+	void getPrefetchRange(size_t& begin, size_t& end)const;
+	
+	void updatePrefetch();
+	
+	void update(std::uint32_t dt)override;
+	
 	void handleDataSetChanged();
+	
+	void handleItemsChanged();
+	
+	//remaps or drops widgets of items starting from the given one, mapping returns size_t(-1) for dropped items
+	void remapItemWidgets(size_t first, const std::function<size_t(size_t)>& map);
+	
+	//returns false if the change does not match the list, in that case the list needs to be rebuilt
+	bool applyChange(const ItemsProvider::Change& c);
 };
 
 
@@ -4,25 +4,46 @@
 using namespace morda;
 
 size_t TextInputArea::LinesProvider::count() const noexcept{
-	auto ret = this->tia.lines.size();
-	if(ret == 0){
-		return 1;
-	}
-	return ret;
+	return this->tia.buffer_v.numLines();
 }
 
 std::shared_ptr<Widget> TextInputArea::LinesProvider::getWidget(size_t index) {
-	auto ret = utki::makeShared<TextInputLine>();
-	
-	if(this->tia.lines.size() != 0){
-		ASSERT(index < this->tia.lines.size())
-		ret->setText(std::u32string(this->tia.lines[index]));
+	auto ret = std::dynamic_pointer_cast<LineWidget>(this->takeRecycled(this->itemType(index)));
+	if(ret){
+		//disconnect from previous line before changing text
+		ret->textChanged = nullptr;
+		ret->clear();
 	}else{
-		ASSERT(index == 0)
+		ret = utki::makeShared<LineWidget>(this->tia);
 	}
-	ret->textChanged = [this, index](SingleLineTextWidget& w){
-		ASSERT(index < this->tia.lines.size())
-		this->tia.lines[index] = w.text();
+	
+	ASSERT(index < this->tia.buffer_v.numLines())
+	ret->setText(this->tia.buffer_v.line(index));
+	
+	if(index == this->tia.restoreFocusLine){
+		this->tia.restoreFocusLine = size_t(-1);
+		
+		//focuses the widget
+		ret->setCursorIndex(this->tia.restoreCursorIndex);
+	}
+	
+	//line index is not captured, because line widgets are reused for other lines when lines are inserted or removed above
+	ret->textChanged = [this](SingleLineTextWidget& w){
+		size_t index = this->tia.indexOf(w);
+		if(index == size_t(-1)){
+			return;
+		}
+		
+		auto& buf = this->tia.buffer_v;
+		ASSERT(index < buf.numLines())
+		
+		auto begin = buf.lineBegin(index);
+		
+		this->tia.lineEditing = true;
+		utki::ScopeExit scopeExit([this](){
+			this->tia.lineEditing = false;
+		});
+		buf.replace(begin, buf.lineEnd(index) - begin, w.text());
 	};
 	
 	return ret;
@@ -30,9 +51,114 @@ std::shared_ptr<Widget> TextInputArea::LinesProvider::getWidget(size_t index) {
 
 
 
+void TextInputArea::LineWidget::onFocusChanged(){
+	this->TextInputLine::onFocusChanged();
+	
+	if(this->isFocused()){
+		this->tia.focusedLine = this->sharedFromThis(this);
+	}else if(this->tia.focusedLine.lock().get() == this){
+		this->tia.focusedLine.reset();
+	}
+}
+
+
+
 TextInputArea::TextInputArea(const stob::Node* chain) :
 		Widget(chain),
 		List(true, nullptr)
 {
+	this->buffer_v.changed = [this](TextBuffer&, size_t line, size_t numRemoved, size_t numInserted){
+		this->handleBufferChanged(line, numRemoved, numInserted);
+	};
 	
-}
\ No newline at end of file
+	this->linesProvider = utki::makeShared<LinesProvider>(*this);
+	this->setItemsProvider(this->linesProvider);
+	
+	this->dataSetChanged = [this](List&){
+		if(this->restoreFocusLine == size_t(-1)){
+			return;
+		}
+		
+		//the line is not visible, so its widget was not recreated
+		this->restoreFocusLine = size_t(-1);
+		if(auto f = this->focusedLine.lock()){
+			if(this->indexOf(*f) == size_t(-1)){
+				f->unfocus();
+			}
+		}
+	};
+}
+
+
+
+void TextInputArea::handleBufferChanged(size_t line, size_t numRemoved, size_t numInserted){
+	if(this->lineEditing && numRemoved == 0 && numInserted == 0){
+		//line widget already shows the new text
+		return;
+	}
+	
+	if(this->restoreFocusLine != size_t(-1)){
+		//list has not been updated since the previous change, follow the line to restore focus in
+		if(this->restoreFocusLine > line + numRemoved){
+			this->restoreFocusLine = this->restoreFocusLine + numInserted - numRemoved;
+		}else if(this->restoreFocusLine > line + numInserted){
+			this->restoreFocusLine = line + numInserted;
+		}
+	}else if(auto f = this->focusedLine.lock()){
+		//widgets of changed and removed lines are dropped, the focused one included
+		size_t index = this->indexOf(*f);
+		if(index != size_t(-1) && line <= index && index <= line + numRemoved){
+			this->restoreFocusLine = std::min(index, line + numInserted);
+			this->restoreCursorIndex = f->cursorIndex();
+		}
+	}
+	
+	auto& p = *this->linesProvider;
+	
+	p.notifyItemsChanged(line);
+	
+	if(numRemoved > numInserted){
+		p.notifyItemsRemoved(line + 1 + numInserted, numRemoved - numInserted);
+	}else if(numInserted > numRemoved){
+		p.notifyItemsInserted(line + 1 + numRemoved, numInserted - numRemoved);
+	}
+	
+	size_t numChanged = std::min(numRemoved, numInserted);
+	if(numChanged != 0){
+		p.notifyItemsChanged(line + 1, numChanged);
+	}
+}
+
+
+
+bool TextInputArea::onKey(bool isDown, Key_e keyCode){
+	switch(keyCode){
+		case Key_e::LEFT_CONTROL:
+		case Key_e::RIGHT_CONTROL:
+			this->ctrlPressed = isDown;
+			break;
+		case Key_e::LEFT_SHIFT:
+		case Key_e::RIGHT_SHIFT:
+			this->shiftPressed = isDown;
+			break;
+		case Key_e::Z:
+			if(isDown && this->ctrlPressed){
+				if(this->shiftPressed){
+					this->buffer_v.redo();
+				}else{
+					this->buffer_v.undo();
+				}
+				return true;
+			}
+			break;
+		case Key_e::Y:
+			if(isDown && this->ctrlPressed){
+				this->buffer_v.redo();
+				return true;
+			}
+			break;
+		default:
+			break;
+	}
+	return false;
+}
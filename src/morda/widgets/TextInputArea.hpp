@@ -3,6 +3,8 @@
 #include "TextInputLine.hpp"
 #include "List.hpp"
 
+#include "../util/TextBuffer.hpp"
+
 namespace morda{
 
 class TextInputArea :
@@ -19,9 +21,45 @@ class TextInputArea :
 		size_t count() const noexcept override;
 
 		std::shared_ptr<Widget> getWidget(size_t index) override;
+		
+		//all lines are of the same type, so widgets are reused for any lines
+		void recycle(size_t index, std::shared_ptr<Widget> w) override{
+			this->putRecycled(0, std::move(w));
+		}
+		
+		void recycleDropped(std::shared_ptr<Widget> w) override{
+			this->putRecycled(0, std::move(w));
+		}
+	};
+	
+	std::shared_ptr<LinesProvider> linesProvider;
+	
+	//line widget which lets the text area know which line is focused
+	class LineWidget : public TextInputLine{
+		TextInputArea& tia;
+	public:
+		LineWidget(TextInputArea& tia) :
+				Widget(nullptr),
+				TextInputLine(nullptr),
+				tia(tia)
+		{}
+		
+		void onFocusChanged()override;
 	};
 	
-	std::vector<std::u32string> lines{std::u32string()};
+	std::weak_ptr<LineWidget> focusedLine;
+	
+	//widget of the focused line is recreated when the line changes, so focus and cursor are restored in the new widget
+	size_t restoreFocusLine = size_t(-1);
+	size_t restoreCursorIndex = 0;
+	
+	TextBuffer buffer_v;
+	
+	//true while the buffer is being changed by a line widget
+	bool lineEditing = false;
+	
+	bool ctrlPressed = false;
+	bool shiftPressed = false;
 	
 public:
 	TextInputArea(const stob::Node* chain = nullptr);
@@ -29,9 +67,35 @@ public:
 	TextInputArea(const TextInputArea&) = delete;
 	TextInputArea& operator=(const TextInputArea&) = delete;
 	
+	/**
+	 * @brief Get text buffer.
+	 * The buffer can be edited directly, the widget is updated accordingly.
+	 * @return Text buffer of the widget.
+	 */
+	TextBuffer& buffer()noexcept{
+		return this->buffer_v;
+	}
+	
+	/**
+	 * @brief Set text.
+	 * @param text - text in UTF-8.
+	 */
+	void setText(std::string text){
+		this->buffer_v.setText(std::move(text));
+	}
+	
+	/**
+	 * @brief Get text.
+	 * @return Text in UTF-8.
+	 */
+	std::string text()const{
+		return this->buffer_v.text();
+	}
+	
+	bool onKey(bool isDown, Key_e keyCode)override;
 	
 private:
-
+	void handleBufferChanged(size_t line, size_t numRemoved, size_t numInserted);
 };
 
 }
@@ -3,6 +3,8 @@
 #include "../Morda.hpp"
 #include "../util/util.hpp"
 
+#include <algorithm>
+
 
 
 #if M_OS == M_OS_WINDOWS
@@ -36,10 +38,10 @@ TextInputLine::TextInputLine(const stob::Node* chain) :
 
 void TextInputLine::render(const morda::Matr4r& matrix) const{
 	//render selection
-	if(this->cursorIndex != this->selectionStartIndex){
+	if(this->cursorIndex_v != this->selectionStartIndex){
 		morda::Matr4r matr(matrix);
 		matr.translate(
-				this->selectionStartIndex < this->cursorIndex ? this->selectionStartPos : this->cursorPos,
+				this->selectionStartIndex < this->cursorIndex_v ? this->selectionStartPos : this->cursorPos,
 				0
 			);
 		matr.scale(Vec2r(std::abs(this->cursorPos - this->selectionStartPos), this->rect().d.y));
@@ -52,11 +54,10 @@ void TextInputLine::render(const morda::Matr4r& matrix) const{
 		morda::Matr4r matr(matrix);
 		matr.translate(-this->textBoundingBox().p.x + this->xOffset, -this->font().boundingBox().p.y);
 		
-		ASSERT(this->firstVisibleCharIndex <= this->text().size())
 		this->font().renderString(
 				matr,
 				morda::colorToVec4f(this->color()),
-				this->text().substr(this->firstVisibleCharIndex, this->text().size() - this->firstVisibleCharIndex)
+				this->visibleText
 			);
 	}
 	
@@ -113,12 +114,12 @@ Vec2r TextInputLine::measure(const morda::Vec2r& quotum)const noexcept{
 }
 
 void TextInputLine::setCursorIndex(size_t index, bool selection){
-	this->cursorIndex = index;
+	this->cursorIndex_v = index;
 	
-	utki::clampTop(this->cursorIndex, this->text().size());
+	utki::clampTop(this->cursorIndex_v, this->text().size());
 	
 	if(!selection){
-		this->selectionStartIndex = this->cursorIndex;
+		this->selectionStartIndex = this->cursorIndex_v;
 	}
 	
 	utki::ScopeExit scopeExit([this](){
@@ -132,43 +133,64 @@ void TextInputLine::setCursorIndex(size_t index, bool selection){
 	
 //	TRACE(<< "selectionStartIndex = " << this->selectionStartIndex << std::endl)
 	
-	if(this->cursorIndex <= this->firstVisibleCharIndex){
-		this->firstVisibleCharIndex = this->cursorIndex;
+	if(this->cursorIndex_v <= this->firstVisibleCharIndex){
+		this->firstVisibleCharIndex = this->cursorIndex_v;
 		this->xOffset = 0;
 		this->cursorPos = 0;
+		this->updateVisibleText();
 		return;
 	}
 	
 	ASSERT(this->firstVisibleCharIndex <= this->text().size())
-	ASSERT(this->cursorIndex > this->firstVisibleCharIndex)
-	this->cursorPos = this->font().stringAdvance(
-			std::u32string(this->text(), this->firstVisibleCharIndex, this->cursorIndex - this->firstVisibleCharIndex)
-		) + this->xOffset;
+	ASSERT(this->cursorIndex_v > this->firstVisibleCharIndex)
+	this->cursorPos = this->advance(this->firstVisibleCharIndex, this->cursorIndex_v) + this->xOffset;
 	
 	ASSERT(this->cursorPos >= 0)
 	
 	if(this->cursorPos > this->rect().d.x - cursorWidth_c * morda::inst().units.dotsPerPt()){
 		this->cursorPos = this->rect().d.x - cursorWidth_c * morda::inst().units.dotsPerPt();
 		
-		this->xOffset = this->cursorPos;//start from rightmost cursor position
-		this->firstVisibleCharIndex = this->cursorIndex;
+		//find the last character which starts not after the left edge when cursor is at rightmost position
+		auto& a = this->advances();
+		auto i = std::upper_bound(a.begin(), a.begin() + this->cursorIndex_v + 1, a[this->cursorIndex_v] - this->cursorPos);
+		ASSERT(i != a.begin())
+		--i;
 		
-		//calculate advance backwards
-		for(auto i = this->text().rbegin() + (this->text().size() - this->cursorIndex);
-				this->xOffset > 0;
-				++i
-			)
-		{
-			ASSERT(i != this->text().rend())
-			this->xOffset -= this->font().charAdvance(*i);
-			ASSERT(this->firstVisibleCharIndex > 0)
-			--this->firstVisibleCharIndex;
-		}
+		this->firstVisibleCharIndex = size_t(i - a.begin());
+		this->xOffset = this->cursorPos - (a[this->cursorIndex_v] - *i);
+		
+		this->updateVisibleText();
 	}
 }
 
 
 
+void TextInputLine::updateVisibleText(){
+	utki::clampTop(this->firstVisibleCharIndex, this->text().size());
+	
+	//find the first character which starts out of the widget
+	auto& a = this->advances();
+	auto end = std::lower_bound(
+			a.begin() + this->firstVisibleCharIndex,
+			a.end() - 1,
+			this->rect().d.x - this->xOffset + a[this->firstVisibleCharIndex]
+		);
+	
+	this->visibleText.assign(
+			this->text().begin() + this->firstVisibleCharIndex,
+			this->text().begin() + (end - a.begin())
+		);
+}
+
+
+
+void TextInputLine::onTextChanged(){
+	this->updateVisibleText();
+	this->SingleLineTextWidget::onTextChanged();
+}
+
+
+
 real TextInputLine::indexToPos(size_t index){
 	ASSERT(this->firstVisibleCharIndex <= this->text().size())
 	
@@ -178,45 +200,34 @@ real TextInputLine::indexToPos(size_t index){
 	
 	utki::clampTop(index, this->text().size());
 	
-	real ret = this->xOffset;
+	real ret = this->xOffset + this->advance(this->firstVisibleCharIndex, index);
 	
-	for(auto i = this->text().begin() + this->firstVisibleCharIndex;
-			i != this->text().end() && index != this->firstVisibleCharIndex;
-			++i, --index
-		)
-	{
-		ret += this->font().charAdvance(*i);
-		if(ret >= this->rect().d.x){
-			ret = this->rect().d.x;
-			break;
-		}
-	}
+	utki::clampTop(ret, this->rect().d.x);
 	
 	return ret;
 }
 
 
 size_t TextInputLine::posToIndex(real pos){
-	size_t index = this->firstVisibleCharIndex;
-	real p = this->xOffset;
+	auto& a = this->advances();
 	
-	for(auto i = this->text().begin() + this->firstVisibleCharIndex; i != this->text().end(); ++i){
-		real w = this->font().charAdvance(*i);
-		
-		if(pos < p + w){
-			if(pos < p + w / 2){
-				break;
-			}
-			p += w;
-			++index;
-			break;
-		}
-		
-		p += w;
-		++index;
+	ASSERT(this->firstVisibleCharIndex < a.size())
+	
+	real p = pos - this->xOffset + a[this->firstVisibleCharIndex];
+	
+	//find the character under the position
+	auto end = std::upper_bound(a.begin() + this->firstVisibleCharIndex + 1, a.end(), p);
+	if(end == a.end()){
+		return this->text().size();
 	}
 	
-	return index;
+	auto begin = end - 1;
+	
+	//closest character boundary
+	if(p < *begin + (*end - *begin) / 2){
+		return size_t(begin - a.begin());
+	}
+	return size_t(end - a.begin());
 }
 
 
@@ -236,6 +247,7 @@ void TextInputLine::onFocusChanged(){
 
 void TextInputLine::onResize(){
 	this->selectionStartPos = this->indexToPos(this->selectionStartIndex);
+	this->updateVisibleText();
 }
 
 
@@ -266,12 +278,12 @@ void TextInputLine::onCharacterInput(const std::u32string& unicode, Key_e key){
 		case Key_e::ENTER:
 			break;
 		case Key_e::RIGHT:
-			if(this->cursorIndex != this->text().size()){
+			if(this->cursorIndex_v != this->text().size()){
 				size_t newIndex;
 				if(this->ctrlPressed){
 					bool spaceSkipped = false;
-					newIndex = this->cursorIndex;
-					for(auto i = this->text().begin() + this->cursorIndex; i != this->text().end(); ++i, ++newIndex){
+					newIndex = this->cursorIndex_v;
+					for(auto i = this->text().begin() + this->cursorIndex_v; i != this->text().end(); ++i, ++newIndex){
 						if(*i == std::uint32_t(' ')){
 							if(spaceSkipped){
 								break;
@@ -282,18 +294,18 @@ void TextInputLine::onCharacterInput(const std::u32string& unicode, Key_e key){
 					}
 
 				}else{
-					newIndex = this->cursorIndex + 1;
+					newIndex = this->cursorIndex_v + 1;
 				}
 				this->setCursorIndex(newIndex, this->shiftPressed);
 			}
 			break;
 		case Key_e::LEFT:
-			if(this->cursorIndex != 0){
+			if(this->cursorIndex_v != 0){
 				size_t newIndex;
 				if(this->ctrlPressed){
 					bool spaceSkipped = false;
-					newIndex = this->cursorIndex;
-					for(auto i = this->text().rbegin() + (this->text().size() - this->cursorIndex);
+					newIndex = this->cursorIndex_v;
+					for(auto i = this->text().rbegin() + (this->text().size() - this->cursorIndex_v);
 							i != this->text().rend();
 							++i, --newIndex
 						)
@@ -307,7 +319,7 @@ void TextInputLine::onCharacterInput(const std::u32string& unicode, Key_e key){
 						}
 					}
 				}else{
-					newIndex = this->cursorIndex - 1;
+					newIndex = this->cursorIndex_v - 1;
 				}
 				this->setCursorIndex(newIndex, this->shiftPressed);
 			}
@@ -322,11 +334,11 @@ void TextInputLine::onCharacterInput(const std::u32string& unicode, Key_e key){
 			if(this->thereIsSelection()){
 				this->setCursorIndex(this->deleteSelection());
 			}else{
-				if(this->cursorIndex != 0){
+				if(this->cursorIndex_v != 0){
 					auto t = this->clear();
-					t.erase(t.begin() + (this->cursorIndex - 1));
+					t.erase(t.begin() + (this->cursorIndex_v - 1));
 					this->setText(std::move(t));
-					this->setCursorIndex(this->cursorIndex - 1);
+					this->setCursorIndex(this->cursorIndex_v - 1);
 				}
 			}
 			break;
@@ -334,9 +346,9 @@ void TextInputLine::onCharacterInput(const std::u32string& unicode, Key_e key){
 			if(this->thereIsSelection()){
 				this->setCursorIndex(this->deleteSelection());
 			}else{
-				if(this->cursorIndex < this->text().size()){
+				if(this->cursorIndex_v < this->text().size()){
 					auto t = this->clear();
-					t.erase(t.begin() + this->cursorIndex);
+					t.erase(t.begin() + this->cursorIndex_v);
 					this->setText(std::move(t));
 				}
 			}
@@ -355,14 +367,14 @@ void TextInputLine::onCharacterInput(const std::u32string& unicode, Key_e key){
 		default:
 			if(unicode.size() != 0){
 				if(this->thereIsSelection()){
-					this->cursorIndex = this->deleteSelection();
+					this->cursorIndex_v = this->deleteSelection();
 				}
 				
 				auto t = this->clear();
-				t.insert(t.begin() + this->cursorIndex, unicode.begin(), unicode.end());
+				t.insert(t.begin() + this->cursorIndex_v, unicode.begin(), unicode.end());
 				this->setText(std::move(t));
 				
-				this->setCursorIndex(this->cursorIndex + unicode.size());
+				this->setCursorIndex(this->cursorIndex_v + unicode.size());
 			}
 			
 			break;
@@ -374,15 +386,15 @@ void TextInputLine::onCharacterInput(const std::u32string& unicode, Key_e key){
 
 
 size_t TextInputLine::deleteSelection(){
-	ASSERT(this->cursorIndex != this->selectionStartIndex)
+	ASSERT(this->cursorIndex_v != this->selectionStartIndex)
 	
 	size_t start, end;
-	if(this->cursorIndex < this->selectionStartIndex){
-		start = this->cursorIndex;
+	if(this->cursorIndex_v < this->selectionStartIndex){
+		start = this->cursorIndex_v;
 		end = this->selectionStartIndex;
 	}else{
 		start = this->selectionStartIndex;
-		end = this->cursorIndex;
+		end = this->cursorIndex_v;
 	}
 	
 	auto t = this->clear();
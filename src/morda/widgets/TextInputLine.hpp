@@ -20,9 +20,12 @@ class TextInputLine :
 	size_t firstVisibleCharIndex = 0;
 	real xOffset = 0;
 	
+	//part of the text which fits into the widget, starting from first visible character
+	std::u32string visibleText;
+	
 	real cursorPos;
 	
-	size_t cursorIndex = 0;
+	size_t cursorIndex_v = 0;
 	
 	real selectionStartPos;
 	
@@ -60,12 +63,24 @@ public:
 	void update(std::uint32_t dt)override;
 	
 	void onCharacterInput(const std::u32string& unicode, Key_e key)override;
+	
+	void onTextChanged()override;
 
 	void setCursorIndex(size_t index, bool selection = false);
 	
+	/**
+	 * @brief Get cursor position.
+	 * @return Index of the character the cursor is before.
+	 */
+	size_t cursorIndex()const noexcept{
+		return this->cursorIndex_v;
+	}
+	
 private:
 	void updateCursorPosBasedOnIndex();
 	
+	void updateVisibleText();
+	
 	void startCursorBlinking();
 	
 	size_t posToIndex(real pos);
@@ -73,7 +88,7 @@ private:
 	real indexToPos(size_t index);
 	
 	bool thereIsSelection()const noexcept{
-		return this->cursorIndex != this->selectionStartIndex;
+		return this->cursorIndex_v != this->selectionStartIndex;
 	}
 	
 	//returns new cursor index
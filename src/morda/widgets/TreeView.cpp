@@ -1,5 +1,7 @@
 #include "TreeView.hpp"
 
+#include <algorithm>
+
 #include "../Morda.hpp"
 
 
@@ -33,9 +35,14 @@ void TreeView::setItemsProvider(std::shared_ptr<ItemsProvider> provider){
 }
 
 void TreeView::ItemsProvider::notifyDataSetChanged() {
+	//cancel all pending loadings
+	decltype(this->loadings) canceled;
+	std::swap(canceled, this->loadings);
+	for(auto& l : canceled){
+		this->cancelLoading(l.second, l.first);
+	}
+	
 	this->visibleTree.removeAll();
-	this->iterIndex = 0;
-	this->iter = this->visibleTree.begin();
 	this->List::ItemsProvider::notifyDataSetChanged();
 }
 
@@ -44,44 +51,51 @@ size_t TreeView::ItemsProvider::count() const noexcept{
 	if(this->visibleTree.size() == 0){
 		auto size = this->count(std::vector<size_t>());
 		this->visibleTree.resetChildren(size);
-		this->iter = this->visibleTree.begin();
-		this->iterIndex = 0;
 	}
 	return this->visibleTree.size();
 }
 
 
 std::shared_ptr<Widget> TreeView::ItemsProvider::getWidget(size_t index){
-	auto i = this->iterForIndex(index);
+	auto& i = this->iterForIndex(index);
 	
 //	TRACE(<< "i.path() = " << (*i).numChildren() << std::endl)
 	
+	if(i.isPlaceholder()){
+		this->placeholderPath.assign(i.path().begin(), i.path().end() - 1);
+		return this->getPlaceholderWidget(this->placeholderPath);
+	}
+	
 	return this->getWidget(i.path(), (*i).numChildren() == 0);
 }
 
 void TreeView::ItemsProvider::recycle(size_t index, std::shared_ptr<Widget> w){
-	auto i = this->iterForIndex(index);
+	if(index >= this->visibleTree.size()){
+		//item is not in the tree anymore
+		return;
+	}
+	
+	auto& i = this->iterForIndex(index);
+	
+	if(i.isPlaceholder()){
+		return;
+	}
 	
 	this->recycle(i.path(), std::move(w));
 }
 
-const decltype(TreeView::ItemsProvider::iter)& TreeView::ItemsProvider::iterForIndex(size_t index) const {
-	if(this->iter == this->visibleTree.end()){
-		this->iter = this->visibleTree.begin();
-		this->iterIndex = 0;
+std::shared_ptr<Widget> TreeView::ItemsProvider::getPlaceholderWidget(const std::vector<size_t>& path){
+	if(!this->placeholderDesc){
+		this->placeholderDesc = stob::parse("TextLabel{text{\"...\"}}");
 	}
+	return Morda::inst().inflater.inflate(*this->placeholderDesc);
+}
+
+const decltype(TreeView::ItemsProvider::iter)& TreeView::ItemsProvider::iterForIndex(size_t index) const {
+	this->visibleTree.posAt(index, this->iter);
 	
 	ASSERT(this->iter.path().size() != 0)
 	
-	if(index != this->iterIndex){
-		if(index > this->iterIndex){
-			this->iter += index - this->iterIndex;
-		}else{ ASSERT(index < this->iterIndex)
-			this->iter -= this->iterIndex - index;
-		}
-		this->iterIndex = index;
-	}
-	
 	return this->iter;
 }
 
@@ -89,88 +103,323 @@ void TreeView::ItemsProvider::collapse(const std::vector<size_t>& path) {
 	auto i = this->visibleTree.pos(path);
 	ASSERT(i != this->visibleTree.end())
 	
-	if(this->iter > i){
-		auto pnext = path;
-		++pnext.back();
-		
-		if(this->iter.path() < pnext){
-			while(this->iter != i){
-				--this->iter;
-				--this->iterIndex;
-			}
-		}else{
-			this->iterIndex -= (*i).size();
-		}
-	}
+	size_t index = this->visibleTree.indexOf(path);
+	size_t numRemoved = (*i).size();
+	
+	//children being loaded might be pending too
+	(*i).setPending(false);
+	this->cancelLoadings(path);
 	
 	this->visibleTree.removeAll(i);
 	
-	this->List::ItemsProvider::notifyDataSetChanged();
+	this->List::ItemsProvider::notifyItemsRemoved(index + 1, numRemoved);
+	
+	//collapsed state of the item has changed
+	this->List::ItemsProvider::notifyItemsChanged(index);
 }
 
 void TreeView::ItemsProvider::uncollapse(const std::vector<size_t>& path) {
-	auto s = this->count(path);
+	auto i = this->visibleTree.pos(path);
+	ASSERT(i != this->visibleTree.end())
+	
+	if((*i).isPending()){
+		//already loading
+		return;
+	}
+	
+	ASSERT((*i).numChildren() == 0)
+	
+	size_t index = this->visibleTree.indexOf(path);
+	
+	//Loading is registered and placeholder is added before the loading is started,
+	//because the provider may deliver the children right from loadChildrenAsync().
+	unsigned token = this->nextLoadingToken++;
+	this->loadings[token] = path;
+	(*i).setPending(true);
+	this->visibleTree.resetChildren(i, 1);
+	
+	this->startingLoadingToken = token;
+	bool isAsync;
+	try{
+		isAsync = this->loadChildrenAsync(path, token);
+	}catch(...){
+		this->startingLoadingToken = 0;
+		this->loadings.erase(token);
+		i = this->visibleTree.pos(path);
+		(*i).setPending(false);
+		this->visibleTree.removeAll(i);
+		throw;
+	}
+	this->startingLoadingToken = 0;
+	
+	i = this->visibleTree.pos(path);
+	
+	if(isAsync){
+		//collapsed state of the item has changed
+		this->List::ItemsProvider::notifyItemsChanged(index);
+		
+		//children delivered so far and placeholder, if loading is not finished yet
+		if((*i).size() != 0){
+			this->List::ItemsProvider::notifyItemsInserted(index + 1, (*i).size());
+		}
+		return;
+	}
+	
+	this->loadings.erase(token);
+	(*i).setPending(false);
+	this->visibleTree.removeAll(i);
+	
+	size_t s = this->count(path);
 //	TRACE(<< "TreeView::ItemsProvider::uncollapse(): s = " << s << std::endl)
 	if(s == 0){
 		return;
 	}
 	
+	this->visibleTree.resetChildren(i, s);
+	
+	//collapsed state of the item has changed
+	this->List::ItemsProvider::notifyItemsChanged(index);
+	
+	this->List::ItemsProvider::notifyItemsInserted(index + 1, s);
+}
+
+void TreeView::ItemsProvider::notifyChildrenLoaded(unsigned token, size_t num, bool finished){
+	auto l = this->loadings.find(token);
+	if(l == this->loadings.end()){
+		//loading was canceled
+		return;
+	}
+	
+	const std::vector<size_t>& path = l->second;
+	
 	auto i = this->visibleTree.pos(path);
-	ASSERT(i != this->visibleTree.end())
+	ASSERT(i && i.depth() == path.size() && (*i).isPending())
 	
-	ASSERT((*i).numChildren() == 0)
+	ASSERT((*i).numChildren() != 0)
+	
+	//insert loaded children before the placeholder
+	auto placeholder = i;
+	placeholder.descent((*i).numChildren() - 1);
+	
+	size_t placeholderIndex = this->visibleTree.indexOf(placeholder.path());
 	
-	if(this->iter > i){
-		this->iterIndex += s;
+	//list is notified about children delivered from within loadChildrenAsync() after it returns
+	bool notify = token != this->startingLoadingToken;
+	
+	if(num != 0){
+		this->visibleTree.add(placeholder, num);
+		if(notify){
+			this->List::ItemsProvider::notifyItemsInserted(placeholderIndex, num);
+		}
+		placeholderIndex += num;
 	}
 	
-	this->visibleTree.resetChildren(i, s);
+	if(!finished){
+		return;
+	}
 	
-	this->List::ItemsProvider::notifyDataSetChanged();
+	(*i).setPending(false);
+	
+	auto p = this->visibleTree.pos(path);
+	p.descent((*p).numChildren() - 1);
+	this->visibleTree.remove(p);
+	
+	if(notify){
+		this->List::ItemsProvider::notifyItemsRemoved(placeholderIndex);
+		
+		if((*i).numChildren() == 0){
+			//node has no children, it is shown as collapsed now
+			this->List::ItemsProvider::notifyItemsChanged(this->visibleTree.indexOf(path));
+		}
+	}
+	
+	this->loadings.erase(l);
+}
+
+void TreeView::ItemsProvider::cancelLoadings(const std::vector<size_t>& path){
+	for(auto i = this->loadings.begin(); i != this->loadings.end();){
+		auto& p = i->second;
+		if(p.size() < path.size() || !std::equal(path.begin(), path.end(), p.begin())){
+			++i;
+			continue;
+		}
+		
+		unsigned token = i->first;
+		auto canceledPath = std::move(p);
+		i = this->loadings.erase(i);
+		
+		this->cancelLoading(canceledPath, token);
+	}
 }
 
 void TreeView::ItemsProvider::notifyItemAdded(const std::vector<size_t>& path) {
+	//nodes after the added one, and their descendants, are shifted
+	for(auto& l : this->loadings){
+		auto& p = l.second;
+		if(p.size() >= path.size() && std::equal(path.begin(), path.end() - 1, p.begin()) && p[path.size() - 1] >= path.back()){
+			++p[path.size() - 1];
+		}
+	}
+	
 	auto i = this->visibleTree.pos(path);
 	if(!i || i.path().back() > i.parent().numChildren()){
 		return;
 	}
 	
 	if(i.parent().numChildren() == 0){
-		this->List::ItemsProvider::notifyDataSetChanged();
+		if(i.depth() == 1){
+			//tree was empty
+			this->List::ItemsProvider::notifyDataSetChanged();
+		}else{
+			//parent item is collapsed, added item is not visible, but parent item might need to be updated
+			std::vector<size_t> parentPath(path.begin(), path.end() - 1);
+			this->List::ItemsProvider::notifyItemsChanged(this->visibleTree.indexOf(parentPath));
+		}
 		return;
 	}
 	
-	if(this->iter >= i){
-		++this->iterIndex;
-	}
-	
 	this->visibleTree.add(i);
-	this->visibleTree.correctIteratorAfterAddition(this->iter, i.path());
 	
-	this->List::ItemsProvider::notifyDataSetChanged();
+	this->List::ItemsProvider::notifyItemsInserted(this->visibleTree.indexOf(path));
 }
 
 void TreeView::ItemsProvider::notifyItemRemoved(const std::vector<size_t>& path) {
+	this->cancelLoadings(path);
+	
+	//nodes after the removed one, and their descendants, are shifted
+	for(auto& l : this->loadings){
+		auto& p = l.second;
+		if(p.size() >= path.size() && std::equal(path.begin(), path.end() - 1, p.begin()) && p[path.size() - 1] > path.back()){
+			--p[path.size() - 1];
+		}
+	}
+	
 	auto i = this->visibleTree.pos(path);
 //	TRACE(<< " sss = " << i.path()[0] << " iter = " << this->iter.path()[0] << std::endl)
 	
-	if(this->iter >= i){
-		auto pnext = path;
-		++pnext.back();
-		
-		if(this->iter.path() < pnext){
-			while(this->iter != i){
-				ASSERT(this->iterIndex != 0)
-				--this->iter;
-				--this->iterIndex;
-			}
-		}else{
-			this->iterIndex -= ((*i).size() + 1);
+	size_t index = this->visibleTree.indexOf(path);
+	size_t numRemoved = (*i).size() + 1;
+	
+	this->visibleTree.remove(i);
+	
+	this->List::ItemsProvider::notifyItemsRemoved(index, numRemoved);
+}
+
+void TreeView::ItemsProvider::notifyItemChanged(const std::vector<size_t>& path) {
+	this->List::ItemsProvider::notifyItemsChanged(this->visibleTree.indexOf(path));
+}
+
+
+
+void Tree::updateWeights()const{
+	this->weights.assign(this->children.size() + 1, 0);
+	
+	//linear time construction of Fenwick tree
+	for(size_t i = 1; i < this->weights.size(); ++i){
+		this->weights[i] += this->children[i - 1].size() + 1;
+		size_t parent = i + (i & (~i + 1));
+		if(parent < this->weights.size()){
+			this->weights[parent] += this->weights[i];
 		}
 	}
+}
+
+
+
+void Tree::childSizeChanged(size_t index, std::ptrdiff_t delta)noexcept{
+	if(!this->areWeightsValid()){
+		return;
+	}
 	
-	this->visibleTree.remove(i);
-	this->visibleTree.correctIteratorAfterDeletion(this->iter, i.path());
+	for(size_t i = index + 1; i < this->weights.size(); i += i & (~i + 1)){
+		this->weights[i] += delta;
+	}
+}
+
+
+
+size_t Tree::childrenPrefix(size_t index)const{
+	ASSERT(index <= this->children.size())
 	
-	this->List::ItemsProvider::notifyDataSetChanged();
+	if(!this->areWeightsValid()){
+		this->updateWeights();
+	}
+	
+	size_t ret = 0;
+	for(size_t i = index; i != 0; i -= i & (~i + 1)){
+		ret += this->weights[i];
+	}
+	return ret;
+}
+
+
+
+size_t Tree::findChild(size_t& index)const{
+	ASSERT(index < this->size())
+	
+	if(!this->areWeightsValid()){
+		this->updateWeights();
+	}
+	
+	size_t step = 1;
+	while(step * 2 < this->weights.size()){
+		step *= 2;
+	}
+	
+	//binary descent, pos is the number of children whose subtrees end not after the index
+	size_t pos = 0;
+	for(; step != 0; step /= 2){
+		size_t next = pos + step;
+		if(next >= this->weights.size()){
+			continue;
+		}
+		if(this->weights[next] <= index){
+			pos = next;
+			index -= this->weights[next];
+		}
+	}
+	
+	ASSERT(pos < this->children.size())
+	return pos;
+}
+
+
+
+size_t Tree::indexOf(const std::vector<size_t>& path)const{
+	ASSERT(path.size() != 0)
+	
+	size_t ret = 0;
+	const Tree* node = this;
+	for(auto i = path.begin(); i != path.end(); ++i){
+		if(i != path.begin()){
+			//the parent node itself
+			++ret;
+		}
+		ASSERT(*i < node->children.size())
+		ret += node->childrenPrefix(*i);
+		node = &node->children[*i];
+	}
+	return ret;
+}
+
+
+
+void Tree::posAt(size_t index, Iterator& ret){
+	ret.pathIdx.clear();
+	ret.pathPtr.clear();
+	
+	if(index >= this->size()){
+		return;
+	}
+	
+	for(Tree* node = this;;){
+		size_t c = node->findChild(index);
+		ret.pathPtr.push_back(node);
+		ret.pathIdx.push_back(c);
+		if(index == 0){
+			break;
+		}
+		--index;
+		node = &node->children[c];
+	}
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <map>
 
 #include "core/Widget.hpp"
 #include "List.hpp"
@@ -16,6 +17,30 @@ class Tree{
 	
 	std::vector<Tree> children;
 	
+	//children are being loaded asynchronously, last child is a placeholder
+	bool pending_v = false;
+	
+	//Fenwick tree of children subtree sizes (including the child itself), 1-based,
+	//used to convert between flat index and path in O(log n) time.
+	//Invalid if its size does not match number of children, rebuilt lazily.
+	mutable std::vector<size_t> weights;
+	
+	void invalidateWeights()noexcept{
+		this->weights.clear();
+	}
+	
+	bool areWeightsValid()const noexcept{
+		return this->weights.size() == this->children.size() + 1;
+	}
+	
+	void updateWeights()const;
+	
+	void childSizeChanged(size_t index, std::ptrdiff_t delta)noexcept;
+	
+	size_t childrenPrefix(size_t index)const;
+	
+	size_t findChild(size_t& index)const;
+	
 public:
 	class Iterator{
 		friend class Tree;
@@ -47,6 +72,20 @@ public:
 			return *this->pathPtr.back();
 		}
 		
+		const Tree& parent()const{
+			ASSERT(this->pathPtr.size() != 0)
+			return *this->pathPtr.back();
+		}
+		
+		/**
+		 * @brief Check if iterator points to a placeholder.
+		 * @return true if the node is a placeholder for children being loaded asynchronously.
+		 * @return false otherwise.
+		 */
+		bool isPlaceholder()const{
+			return this->parent().isPending() && this->pathIdx.back() + 1 == this->parent().numChildren();
+		}
+		
 		Tree& operator*(){
 			ASSERT(this->pathPtr.size() != 0)
 			ASSERT(this->pathIdx.size() == this->pathPtr.size())
@@ -54,6 +93,13 @@ public:
 			return this->pathPtr.back()->children[this->pathIdx.back()];
 		}
 		
+		const Tree& operator*()const{
+			ASSERT(this->pathPtr.size() != 0)
+			ASSERT(this->pathIdx.size() == this->pathPtr.size())
+			ASSERT(this->pathIdx.back() < this->pathPtr.back()->children.size())
+			return this->pathPtr.back()->children[this->pathIdx.back()];
+		}
+		
 		Iterator& operator++(){
 			if(this->pathIdx.size() == 0){
 				return *this;
@@ -258,10 +304,12 @@ public:
 	}
 	
 	void resetChildren(Iterator childrenOf, size_t numberOfChildren){
-		for(auto t : childrenOf.pathPtr){
+		std::ptrdiff_t delta = std::ptrdiff_t(numberOfChildren) - std::ptrdiff_t((*childrenOf).size());
+		for(size_t i = 0; i != childrenOf.pathPtr.size(); ++i){
+			auto t = childrenOf.pathPtr[i];
 //			TRACE(<< "t = " << t << std::endl)
-			t->size_var -= (*childrenOf).size();
-			t->size_var += numberOfChildren;
+			t->size_var += delta;
+			t->childSizeChanged(childrenOf.pathIdx[i], delta);
 		}
 		
 		(*childrenOf).resetChildren(numberOfChildren);
@@ -271,20 +319,27 @@ public:
 		this->children.clear();
 		this->children.resize(this->children.size() + numberOfChildren);
 		this->size_var = numberOfChildren;
+		this->invalidateWeights();
 	}
 	
 	void add(size_t before){
 		this->children.insert(this->children.begin() + before, Tree());
 		++this->size_var;
+		this->invalidateWeights();
 	}
 	
-	void add(Iterator before){
-		for(auto t : before.pathPtr){
+	void add(Iterator before, size_t num = 1){
+		for(size_t i = 0; i != before.pathPtr.size(); ++i){
+			auto t = before.pathPtr[i];
 //			TRACE(<< "t = " << t << std::endl)
-			++t->size_var;
+			t->size_var += num;
+			if(i + 1 != before.pathPtr.size()){
+				t->childSizeChanged(before.pathIdx[i], std::ptrdiff_t(num));
+			}
 		}
 		
-		before.parent().children.insert(before.parent().children.begin() + before.path().back(), Tree());
+		before.parent().children.insert(before.parent().children.begin() + before.path().back(), num, Tree());
+		before.parent().invalidateWeights();
 	}
 	
 	void remove(Iterator i){
@@ -294,8 +349,12 @@ public:
 		
 		size_t numNodesToRemove = (*i).size() + 1;
 		
-		for(auto p : i.pathPtr){
+		for(size_t k = 0; k != i.pathPtr.size(); ++k){
+			auto p = i.pathPtr[k];
 			p->size_var -= numNodesToRemove;
+			if(k + 1 != i.pathPtr.size()){
+				p->childSizeChanged(i.pathIdx[k], -std::ptrdiff_t(numNodesToRemove));
+			}
 		}
 		
 		size_t index = i.path().back();
@@ -308,22 +367,27 @@ public:
 		}
 		ASSERT(index < node->children.size())
 		node->children.erase(node->children.begin() + index);
+		node->invalidateWeights();
 	}
 	
 	void removeAll(Iterator& from){
 		size_t numChildrenToRemove = (*from).size();
 		(*from).children.clear();
+		(*from).invalidateWeights();
 		(*from).size_var -= numChildrenToRemove;
 		ASSERT((*from).size() == 0)
-		for(auto t : from.pathPtr){
+		for(size_t i = 0; i != from.pathPtr.size(); ++i){
+			auto t = from.pathPtr[i];
 			ASSERT(t->size_var >= numChildrenToRemove)
 			t->size_var -= numChildrenToRemove;
+			t->childSizeChanged(from.pathIdx[i], -std::ptrdiff_t(numChildrenToRemove));
 		}
 	}
 	
 	void removeAll(){
 		this->children.clear();
 		this->size_var = 0;
+		this->invalidateWeights();
 	}
 	
 	decltype(size_var) size()const noexcept{
@@ -334,6 +398,19 @@ public:
 		return this->children.size();
 	}
 	
+	/**
+	 * @brief Check if children of the node are being loaded.
+	 * @return true if children are being loaded asynchronously. In this case the last child is a placeholder.
+	 * @return false otherwise.
+	 */
+	bool isPending()const noexcept{
+		return this->pending_v;
+	}
+	
+	void setPending(bool pending)noexcept{
+		this->pending_v = pending;
+	}
+	
 	Iterator begin(){
 		if(this->children.size() == 0){
 			return Iterator();
@@ -365,8 +442,36 @@ public:
 		return ret;
 	}
 	
-private:
-
+	/**
+	 * @brief Get flat index of a node.
+	 * Flat index is the index of the node in depth-first traversal order.
+	 * Complexity is O(depth * log(n)).
+	 * @param path - path to the node.
+	 * @return Flat index of the node.
+	 */
+	size_t indexOf(const std::vector<size_t>& path)const;
+	
+	/**
+	 * @brief Get iterator to node by its flat index.
+	 * Memory already allocated by the given iterator is reused, so that
+	 * no memory allocation happens when the same iterator is reused for lookups.
+	 * Complexity is O(depth * log(n)).
+	 * @param index - flat index of the node.
+	 * @param ret - iterator to set to the node, set to end() if index is out of range.
+	 */
+	void posAt(size_t index, Iterator& ret);
+	
+	/**
+	 * @brief Get iterator to node by its flat index.
+	 * @param index - flat index of the node.
+	 * @return Iterator to the node.
+	 * @return end() if index is out of range.
+	 */
+	Iterator posAt(size_t index){
+		Iterator ret;
+		this->posAt(index, ret);
+		return ret;
+	}
 };
 
 
@@ -398,23 +503,97 @@ public:
 		
 		mutable Tree visibleTree;
 		
-		//cached values for faster lookup by index
-		mutable size_t iterIndex;
+		//reused for lookups by index to avoid memory allocations
 		mutable decltype(visibleTree)::Iterator iter;
 		
+		//reused for placeholder parent paths
+		std::vector<size_t> placeholderPath;
+		
 		const decltype(iter)& iterForIndex(size_t index)const;
 		
+		//current paths of nodes whose children are being loaded asynchronously, by loading token
+		std::map<unsigned, std::vector<size_t>> loadings;
+		
+		unsigned nextLoadingToken = 1;
+		
+		//token of the loading which is being started by loadChildrenAsync(), 0 if none
+		unsigned startingLoadingToken = 0;
+		
+		//description of the default placeholder widget, parsed once
+		std::unique_ptr<stob::Node> placeholderDesc;
+		
+		//cancels loadings of the node and of its descendants
+		void cancelLoadings(const std::vector<size_t>& path);
+		
 	protected:
 		ItemsProvider(){
 		}
 	public:
 		
+		/**
+		 * @brief Get widget for tree node.
+		 * @param path - path to the node. The referenced vector is owned by the provider and is only valid during the call.
+		 * @param isCollapsed - whether the node is collapsed.
+		 * @return Widget for the node.
+		 */
 		virtual std::shared_ptr<Widget> getWidget(const std::vector<size_t>& path, bool isCollapsed) = 0;
 		
+		/**
+		 * @brief Recycle widget of tree node.
+		 * @param path - path to the node. The referenced vector is owned by the provider and is only valid during the call.
+		 * @param w - widget to recycle.
+		 */
 		virtual void recycle(const std::vector<size_t>& path, std::shared_ptr<Widget> w){}
 		
 		virtual size_t count(const std::vector<size_t>& path)const noexcept = 0;
 		
+		/**
+		 * @brief Start loading children of a node asynchronously.
+		 * Called when a node is uncollapsed. If the provider decides to load children asynchronously,
+		 * e.g. from file system or database, it should start the loading, for example with Morda::runAsync(),
+		 * and return true. Loaded children are then delivered by calling notifyChildrenLoaded() from UI thread.
+		 * The loading is identified by the token rather than by the path, because the path of the node
+		 * changes when items are added or removed before it.
+		 * Until loading is finished, a placeholder row is shown after already loaded children, see getPlaceholderWidget().
+		 * Default implementation returns false.
+		 * @param path - path to the node.
+		 * @param token - token identifying the loading, to be passed to notifyChildrenLoaded().
+		 * @return true if loading has been started, count() is not called for the node in this case.
+		 * @return false to get number of children synchronously with count().
+		 */
+		virtual bool loadChildrenAsync(const std::vector<size_t>& path, unsigned token){
+			return false;
+		}
+		
+		/**
+		 * @brief Cancel asynchronous loading of children.
+		 * Called when a node with children being loaded, or its ancestor, is collapsed or removed, or when the whole data set is changed.
+		 * Results of the canceled loading will be ignored by notifyChildrenLoaded().
+		 * @param path - current path to the node.
+		 * @param token - token of the loading, as passed to loadChildrenAsync().
+		 */
+		virtual void cancelLoading(const std::vector<size_t>& path, unsigned token){}
+		
+		/**
+		 * @brief Get placeholder widget.
+		 * Placeholder is shown in place of children which are being loaded asynchronously.
+		 * Default implementation shows a text label.
+		 * @param path - path to the node whose children are being loaded.
+		 * @return Placeholder widget.
+		 */
+		virtual std::shared_ptr<Widget> getPlaceholderWidget(const std::vector<size_t>& path);
+		
+		/**
+		 * @brief Deliver asynchronously loaded children.
+		 * Children can be delivered in chunks, each call appends given number of children after
+		 * the already delivered ones. Should be called from UI thread.
+		 * Call is ignored if the loading has been canceled.
+		 * @param token - token of the loading, as passed to loadChildrenAsync().
+		 * @param num - number of loaded children in this chunk.
+		 * @param finished - true if this is the last chunk.
+		 */
+		void notifyChildrenLoaded(unsigned token, size_t num, bool finished);
+		
 		void uncollapse(const std::vector<size_t>& path);
 		void collapse(const std::vector<size_t>& path);
 		
@@ -424,6 +603,31 @@ public:
 			this->List::ItemsProvider::notifyDataSetChanged();
 		}
 		
+		/**
+		 * @brief Notify that an item has changed.
+		 * Only the widget of the changed item is recreated.
+		 * @param path - index path of the changed item.
+		 */
+		void notifyItemChanged(const std::vector<size_t>& path);
+		
+		/**
+		 * @brief Get list index of a visible item.
+		 * @param path - index path of the item, all its parents must be uncollapsed.
+		 * @return Index of the item's row in the list.
+		 */
+		size_t indexOf(const std::vector<size_t>& path)const{
+			return this->visibleTree.indexOf(path);
+		}
+		
+		/**
+		 * @brief Get path of an item by its list index.
+		 * @param index - index of the item's row in the list.
+		 * @return Index path of the item. The referenced vector is only valid until next call to the provider.
+		 */
+		const std::vector<size_t>& pathOf(size_t index)const{
+			return this->iterForIndex(index).path();
+		}
+		
 		/**
 		 * @brief Notify that an item has been removed.
 		 * @param path - index path of the removed item.
@@ -461,6 +665,17 @@ public:
 	Vec2r scrollFactor()const{
 		return Vec2r(this->ScrollArea::scrollFactor().x, this->list->scrollFactor());
 	}
+	
+	/**
+	 * @brief Set prefetch window.
+	 * See List::setPrefetch().
+	 * @param before - number of rows before the first visible row to prepare.
+	 * @param after - number of rows after the last visible row to prepare.
+	 * @param budgetMs - maximum time in milliseconds to spend on preparing rows per UI update.
+	 */
+	void setPrefetch(size_t before, size_t after, std::uint32_t budgetMs = 2){
+		this->list->setPrefetch(before, after, budgetMs);
+	}
 };
 
 
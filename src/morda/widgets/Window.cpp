@@ -418,10 +418,11 @@ void morda::Window::setBorders(Sidesr borders) {
 
 bool morda::Window::onMouseButton(bool isDown, const morda::Vec2r& pos, MouseButton_e button, unsigned pointerId){
 	if(isDown){
-		morda::Morda::inst().postToUiThread_ts(
+		morda::Morda::inst().postToUiQueue_ts(
 				[this](){
 					this->makeTopmost();
-				}
+				},
+				UiQueue::Priority_e::INPUT
 			);
 
 		if(!this->isTopmost()){
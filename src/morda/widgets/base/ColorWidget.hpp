@@ -29,8 +29,14 @@ public:
 		
 		this->color_v = color;
 		this->clearCache();
+		this->onColorChanged();
 	}
 	
+	/**
+	 * @brief Invoked when color is changed.
+	 */
+	virtual void onColorChanged(){}
+	
 	std::uint32_t color()const noexcept{
 		return this->color_v;
 	}
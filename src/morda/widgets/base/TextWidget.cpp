@@ -44,6 +44,27 @@ Vec2r SingleLineTextWidget::measure(const morda::Vec2r& quotum)const noexcept{
 	return ret;
 }
 
+const std::vector<real>& SingleLineTextWidget::advances()const{
+	if(this->advances_v.size() != 0){
+		ASSERT(this->advances_v.size() == this->text_v.size() + 1)
+		return this->advances_v;
+	}
+	
+	this->advances_v.reserve(this->text_v.size() + 1);
+	
+	real a = 0;
+	this->advances_v.push_back(a);
+	for(auto i = this->text_v.begin(); i != this->text_v.end(); ++i){
+		a += this->font().charAdvance(*i);
+		if(i + 1 != this->text_v.end()){
+			a += this->font().kerning(*i, *(i + 1));
+		}
+		this->advances_v.push_back(a);
+	}
+	
+	return this->advances_v;
+}
+
 void SingleLineTextWidget::onTextChanged() {
 	if (this->textChanged) {
 		this->textChanged(*this);
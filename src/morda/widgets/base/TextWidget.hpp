@@ -39,6 +39,14 @@ public:
 		return this->font_v->font();
 	}
 	
+	/**
+	 * @brief Get font resource.
+	 * @return Font resource of the widget.
+	 */
+	const std::shared_ptr<ResFont>& fontResource()const noexcept{
+		return this->font_v;
+	}
+	
 	virtual void onFontChanged(){}
 	
 protected:
@@ -54,6 +62,9 @@ class SingleLineTextWidget : public TextWidget{
 	
 	mutable Rectr bb;
 	
+	//cumulative advances, empty if need to be recomputed
+	mutable std::vector<real> advances_v;
+	
 protected:
 	Vec2r measure(const morda::Vec2r& quotum)const noexcept override;
 	
@@ -70,6 +81,7 @@ public:
 	
 	void setText(decltype(text_v)&& text){
 		this->text_v = std::move(text);
+		this->advances_v.clear();
 		this->setRelayoutNeeded();
 		this->recomputeBoundingBox();
 		this->onTextChanged();
@@ -80,6 +92,7 @@ public:
 	}
 
 	void onFontChanged()override{
+		this->advances_v.clear();
 		this->recomputeBoundingBox();
 	}
 
@@ -88,12 +101,35 @@ public:
 	std::function<void(SingleLineTextWidget& w)> textChanged;
 	
 	decltype(text_v) clear(){
+		this->advances_v.clear();
 		return std::move(this->text_v);
 	}
 	
 	const decltype(text_v)& text()const noexcept{
 		return this->text_v;
 	}
+	
+	/**
+	 * @brief Get cumulative advances of text characters.
+	 * The i'th element is the advance of the first i characters of the text including kerning, i.e. the position
+	 * where i'th character starts. Number of elements is one more than the text length.
+	 * The array is computed on first request after text or font change.
+	 * Being non-decreasing, it allows finding character by position with binary search.
+	 * @return Cumulative advances of the text characters.
+	 */
+	const std::vector<real>& advances()const;
+	
+	/**
+	 * @brief Get advance of the part of the text.
+	 * @param begin - index of the first character.
+	 * @param end - index of the character after the last one.
+	 * @return Advance of the characters from the given range.
+	 */
+	real advance(size_t begin, size_t end)const{
+		auto& a = this->advances();
+		ASSERT(begin <= end && end < a.size())
+		return a[end] - a[begin];
+	}
 };
 
 
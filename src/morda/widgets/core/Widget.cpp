@@ -14,7 +14,7 @@ using namespace morda;
 
 Widget::Widget(const stob::Node* chain){
 	if(const stob::Node* n = getProperty(chain, "layout")){
-		this->layout = n->cloneChain();
+		this->layout = internChain(n);
 	}
 
 	if(const stob::Node* n = getProperty(chain, "x")){
@@ -161,7 +161,8 @@ private:
 	
 	bool relayoutNeeded = true;
 	
-	std::unique_ptr<stob::Node> layout;
+	//shared by widgets with the same layout parameters description, see internChain()
+	std::shared_ptr<const stob::Node> layout;
 	
 	mutable std::unique_ptr<LayoutParams> layoutParams;
 public:
@@ -0,0 +1,96 @@
+#include "ParagraphLabel.hpp"
+
+
+#include "../../Morda.hpp"
+#include "../../util/util.hpp"
+
+
+
+using namespace morda;
+
+
+
+ParagraphLabel::ParagraphLabel(const stob::Node* chain) :
+		Widget(chain),
+		TextWidget(chain)
+{
+	if(auto p = getProperty(chain, "align")){
+		std::string a = p->value();
+		if(a == "center"){
+			this->paragraph_v.setAlignment(Paragraph::Align_e::CENTER);
+		}else if(a == "right"){
+			this->paragraph_v.setAlignment(Paragraph::Align_e::RIGHT);
+		}else if(a != "left"){
+			throw morda::Exc("ParagraphLabel: unknown alignment value");
+		}
+	}
+	
+	if(auto p = getProperty(chain, "text")){
+		this->plainText = unikod::toUtf32(p->value());
+	}
+	
+	this->applyPlainText();
+}
+
+
+
+void ParagraphLabel::applyPlainText(){
+	ASSERT(this->isPlainText)
+	
+	//keep own copy of the text to be able to re-apply it when font changes
+	auto text = this->plainText;
+	this->paragraph_v.setText(std::move(text), std::shared_ptr<const Font>(this->fontResource(), &this->font()), this->color());
+	
+	this->setRelayoutNeeded();
+}
+
+
+
+void ParagraphLabel::setRuns(std::vector<Paragraph::Run>&& runs){
+	this->isPlainText = false;
+	this->plainText.clear();
+	this->paragraph_v.setRuns(std::move(runs));
+	
+	this->setRelayoutNeeded();
+}
+
+
+
+void ParagraphLabel::onFontChanged(){
+	if(this->isPlainText){
+		this->applyPlainText();
+	}
+}
+
+
+
+void ParagraphLabel::onColorChanged(){
+	if(this->isPlainText){
+		this->paragraph_v.setColor(0, this->color());
+	}
+}
+
+
+
+Vec2r ParagraphLabel::measure(const morda::Vec2r& quotum)const{
+	Vec2r ret = this->paragraph_v.dim(quotum.x);
+	
+	for(unsigned i = 0; i != ret.size(); ++i){
+		if(quotum[i] >= 0){
+			ret[i] = quotum[i];
+		}
+	}
+	
+	return ret;
+}
+
+
+
+void ParagraphLabel::render(const morda::Matr4r& matrix)const{
+	morda::Matr4r matr(matrix);
+	
+	//align top of the text with the top edge of the widget
+	matr.translate(0, this->rect().d.y - this->paragraph_v.dim(this->rect().d.x).y);
+	
+	this->paragraph_v.render(matr, this->rect().d.x);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+
+#include "../base/TextWidget.hpp"
+#include "../../fonts/Paragraph.hpp"
+
+
+
+namespace morda{
+
+/**
+ * @brief Multi-line text label widget.
+ * This widget shows a word wrapped text which can consist of several runs of different fonts and colors.
+ * From GUI script it can be instantiated as "ParagraphLabel".
+ * 
+ * @param text - text of the label. Lines are separated with '\n'.
+ * @param align - horizontal alignment of lines, one of 'left', 'center', 'right'. Default is 'left'.
+ */
+class ParagraphLabel : public TextWidget{
+	Paragraph paragraph_v;
+	
+	//true if the text was set as plain text with font and color of the widget
+	bool isPlainText = true;
+	
+	std::u32string plainText;
+	
+	void applyPlainText();
+
+protected:
+	Vec2r measure(const morda::Vec2r& quotum)const override;
+
+public:
+	ParagraphLabel(const stob::Node* chain = nullptr);
+	
+	ParagraphLabel(const ParagraphLabel&) = delete;
+	ParagraphLabel& operator=(const ParagraphLabel&) = delete;
+	
+	~ParagraphLabel()noexcept{}
+	
+	/**
+	 * @brief Set plain text.
+	 * Whole text is shown with the font and color of the widget.
+	 * @param text - text to set.
+	 */
+	void setText(std::u32string&& text){
+		this->plainText = std::move(text);
+		this->isPlainText = true;
+		this->applyPlainText();
+	}
+	
+	/**
+	 * @brief Set plain text.
+	 * @param text - text to set in UTF-8.
+	 */
+	void setText(const std::string& text){
+		this->setText(unikod::toUtf32(text));
+	}
+	
+	/**
+	 * @brief Set rich text.
+	 * @param runs - text runs with their own fonts and colors.
+	 */
+	void setRuns(std::vector<Paragraph::Run>&& runs);
+	
+	/**
+	 * @brief Set horizontal alignment of lines.
+	 * @param align - alignment.
+	 */
+	void setAlignment(Paragraph::Align_e align){
+		this->paragraph_v.setAlignment(align);
+		this->clearCache();
+	}
+	
+	/**
+	 * @brief Get laid out text.
+	 * @return Paragraph object of the label.
+	 */
+	const Paragraph& paragraph()const noexcept{
+		return this->paragraph_v;
+	}
+	
+	void render(const morda::Matr4r& matrix)const override;
+	
+	void onFontChanged()override;
+	
+	void onColorChanged()override;
+};
+	
+
+
+}
@@ -27,6 +27,8 @@ App::T_Instance App::instance;
 void App::render(){
 	//TODO: render only if needed?
 	
+	this->gui.flushMouseMoves();
+	
 	this->renderer->clearFramebuffer();
 
 	this->gui.render();
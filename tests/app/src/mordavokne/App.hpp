@@ -514,6 +514,10 @@ private:
 				Morda(r, dotsPerInch, dotsPerPt)
 		{}
 		
+		~MordaVOkne()noexcept{
+			this->shutdownThreadPool();
+		}
+		
 		void postToUiThread_ts(std::function<void()>&& f) override{
 #if M_OS == M_OS_WINDOWS || M_OS == M_OS_MACOSX
 			App::inst().postToUiThread_ts(std::move(f));
@@ -15,6 +15,14 @@
 
 #include <GL/glew.h>
 
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#	define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#	define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
 using namespace mordaren;
 
 OpenGL2Factory::OpenGL2Factory(){
@@ -29,17 +37,7 @@ OpenGL2Factory::~OpenGL2Factory()noexcept{
 
 
 std::shared_ptr<morda::Texture2D> OpenGL2Factory::createTexture2D(morda::Texture2D::TexType_e type, kolme::Vec2ui dim, const utki::Buf<std::uint8_t>& data) {
-	//TODO: turn these asserts to real checks with exceptions throwing
-	ASSERT(data.size() % morda::Texture2D::bytesPerPixel(type) == 0)
 	ASSERT_INFO(dim.isPositive(), "dim = " << dim)
-	ASSERT(data.size() % dim.x == 0)
-
-	ASSERT(data.size() == 0 || data.size() / morda::Texture2D::bytesPerPixel(type) / dim.x == dim.y)
-	
-	auto ret = utki::makeShared<OpenGL2Texture2D>(dim.to<float>());
-	
-	//TODO: save previous bind and restore it after?
-	ret->bind(0);
 	
 	GLint internalFormat;
 	switch(type){
@@ -57,24 +55,57 @@ std::shared_ptr<morda::Texture2D> OpenGL2Factory::createTexture2D(morda::Texture
 		case decltype(type)::RGBA:
 			internalFormat = GL_RGBA;
 			break;
+		case decltype(type)::ETC2_RGB8:
+			internalFormat = GL_COMPRESSED_RGB8_ETC2;
+			break;
+		case decltype(type)::ETC2_RGBA8:
+			internalFormat = GL_COMPRESSED_RGBA8_ETC2_EAC;
+			break;
+	}
+	
+	auto ret = utki::makeShared<OpenGL2Texture2D>(dim.to<float>(), internalFormat);
+	
+	//TODO: save previous bind and restore it after?
+	ret->bind(0);
+	
+	if(morda::Texture2D::isCompressed(type)){
+		//TODO: turn this assert to real check with exception throwing
+		ASSERT(data.size() == morda::Texture2D::dataSize(type, dim))
+		
+		glCompressedTexImage2D(
+				GL_TEXTURE_2D,
+				0,//0th level, no mipmaps
+				internalFormat,
+				dim.x,
+				dim.y,
+				0,//border, should be 0!
+				GLsizei(data.size()),
+				&*data.begin()
+			);
+		assertOpenGLNoError();
+	}else{
+		//TODO: turn these asserts to real checks with exceptions throwing
+		ASSERT(data.size() % morda::Texture2D::bytesPerPixel(type) == 0)
+		ASSERT(data.size() % dim.x == 0)
+		ASSERT(data.size() == 0 || data.size() / morda::Texture2D::bytesPerPixel(type) / dim.x == dim.y)
+		
+		//we will be passing pixels to OpenGL which are 1-byte aligned.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		assertOpenGLNoError();
+		
+		glTexImage2D(
+				GL_TEXTURE_2D,
+				0,//0th level, no mipmaps
+				internalFormat, //internal format
+				dim.x,
+				dim.y,
+				0,//border, should be 0!
+				internalFormat, //format of the texel data
+				GL_UNSIGNED_BYTE,
+				data.size() == 0 ? nullptr : &*data.begin()
+			);
+		assertOpenGLNoError();
 	}
-
-	//we will be passing pixels to OpenGL which are 1-byte aligned.
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	assertOpenGLNoError();
-
-	glTexImage2D(
-			GL_TEXTURE_2D,
-			0,//0th level, no mipmaps
-			internalFormat, //internal format
-			dim.x,
-			dim.y,
-			0,//border, should be 0!
-			internalFormat, //format of the texel data
-			GL_UNSIGNED_BYTE,
-			data.size() == 0 ? nullptr : &*data.begin()
-		);
-	assertOpenGLNoError();
 
 	//NOTE: on OpenGL ES 2 it is necessary to set the filter parameters
 	//      for every texture!!! Otherwise it may not work!
@@ -89,6 +120,15 @@ std::shared_ptr<morda::Texture2D> OpenGL2Factory::createTexture2D(morda::Texture
 	return ret;
 }
 
+bool OpenGL2Factory::isSupported(morda::Texture2D::TexType_e type){
+	if(!morda::Texture2D::isCompressed(type)){
+		return true;
+	}
+	
+	//ETC2 textures are supported by implementations compatible with OpenGL ES 3.0
+	return GLEW_ARB_ES3_compatibility != 0;
+}
+
 std::shared_ptr<morda::VertexBuffer> OpenGL2Factory::createVertexBuffer(const utki::Buf<kolme::Vec4f> vertices){
 	return utki::makeShared<OpenGL2VertexBuffer>(vertices);
 }
@@ -1,3 +1,5 @@
+#include <string>
+
 #include <utki/config.hpp>
 
 #include "OpenGLES2Factory.hpp"
@@ -22,6 +24,14 @@
 #	include <GLES2/gl2.h>
 #endif
 
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#	define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#	define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
 
 using namespace mordaren;
 
@@ -37,17 +47,6 @@ OpenGLES2Factory::~OpenGLES2Factory()noexcept{
 
 
 std::shared_ptr<morda::Texture2D> OpenGLES2Factory::createTexture2D(morda::Texture2D::TexType_e type, kolme::Vec2ui dim, const utki::Buf<std::uint8_t>& data) {
-	//TODO: turn these asserts to real checks with exceptions throwing
-	ASSERT(data.size() % morda::Texture2D::bytesPerPixel(type) == 0)
-	ASSERT(data.size() % dim.x == 0)
-
-	ASSERT(data.size() == 0 || data.size() / morda::Texture2D::bytesPerPixel(type) / dim.x == dim.y)
-	
-	auto ret = utki::makeShared<OpenGLES2Texture2D>(dim.to<float>());
-	
-	//TODO: save previous bind and restore it after?
-	ret->bind(0);
-	
 	GLint internalFormat;
 	switch(type){
 		default:
@@ -64,24 +63,57 @@ std::shared_ptr<morda::Texture2D> OpenGLES2Factory::createTexture2D(morda::Textu
 		case decltype(type)::RGBA:
 			internalFormat = GL_RGBA;
 			break;
+		case decltype(type)::ETC2_RGB8:
+			internalFormat = GL_COMPRESSED_RGB8_ETC2;
+			break;
+		case decltype(type)::ETC2_RGBA8:
+			internalFormat = GL_COMPRESSED_RGBA8_ETC2_EAC;
+			break;
+	}
+	
+	auto ret = utki::makeShared<OpenGLES2Texture2D>(dim.to<float>(), internalFormat);
+	
+	//TODO: save previous bind and restore it after?
+	ret->bind(0);
+	
+	if(morda::Texture2D::isCompressed(type)){
+		//TODO: turn this assert to real check with exception throwing
+		ASSERT(data.size() == morda::Texture2D::dataSize(type, dim))
+		
+		glCompressedTexImage2D(
+				GL_TEXTURE_2D,
+				0,//0th level, no mipmaps
+				internalFormat,
+				dim.x,
+				dim.y,
+				0,//border, should be 0!
+				GLsizei(data.size()),
+				&*data.begin()
+			);
+		assertOpenGLNoError();
+	}else{
+		//TODO: turn these asserts to real checks with exceptions throwing
+		ASSERT(data.size() % morda::Texture2D::bytesPerPixel(type) == 0)
+		ASSERT(data.size() % dim.x == 0)
+		ASSERT(data.size() == 0 || data.size() / morda::Texture2D::bytesPerPixel(type) / dim.x == dim.y)
+		
+		//we will be passing pixels to OpenGL which are 1-byte aligned.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		assertOpenGLNoError();
+		
+		glTexImage2D(
+				GL_TEXTURE_2D,
+				0,//0th level, no mipmaps
+				internalFormat, //internal format
+				dim.x,
+				dim.y,
+				0,//border, should be 0!
+				internalFormat, //format of the texel data
+				GL_UNSIGNED_BYTE,
+				data.size() == 0 ? nullptr : &*data.begin()
+			);
+		assertOpenGLNoError();
 	}
-
-	//we will be passing pixels to OpenGL which are 1-byte aligned.
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	assertOpenGLNoError();
-
-	glTexImage2D(
-			GL_TEXTURE_2D,
-			0,//0th level, no mipmaps
-			internalFormat, //internal format
-			dim.x,
-			dim.y,
-			0,//border, should be 0!
-			internalFormat, //format of the texel data
-			GL_UNSIGNED_BYTE,
-			data.size() == 0 ? nullptr : &*data.begin()
-		);
-	assertOpenGLNoError();
 
 	//NOTE: on OpenGL ES 2 it is necessary to set the filter parameters
 	//      for every texture!!! Otherwise it may not work!
@@ -96,6 +128,16 @@ std::shared_ptr<morda::Texture2D> OpenGLES2Factory::createTexture2D(morda::Textu
 	return ret;
 }
 
+bool OpenGLES2Factory::isSupported(morda::Texture2D::TexType_e type){
+	if(!morda::Texture2D::isCompressed(type)){
+		return true;
+	}
+	
+	//ETC2 support is mandatory since OpenGL ES 3.0
+	auto version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	return version && std::string(version).find("OpenGL ES 3") != std::string::npos;
+}
+
 std::shared_ptr<morda::VertexBuffer> OpenGLES2Factory::createVertexBuffer(const utki::Buf<kolme::Vec4f> vertices){
 	return utki::makeShared<OpenGLES2VertexBuffer>(vertices);
 }
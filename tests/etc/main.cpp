@@ -0,0 +1,238 @@
+#include "../../src/morda/util/Etc.hpp"
+#include "../../src/morda/Exc.hpp"
+
+#include <utki/debug.hpp>
+#include <papki/FSFile.hpp>
+
+#include <array>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+
+
+namespace{
+
+using namespace morda;
+
+std::uint64_t readBlock(const std::uint8_t* p){
+	std::uint64_t ret = 0;
+	for(unsigned i = 0; i != 8; ++i){
+		ret = (ret << 8) | p[i];
+	}
+	return ret;
+}
+
+//Compressed image of one 4x4 block.
+etc::CompressedImage makeBlock(std::uint64_t color, bool hasAlpha = false, std::uint64_t alpha = 0){
+	etc::CompressedImage ret;
+	ret.type = hasAlpha ? Texture2D::TexType_e::ETC2_RGBA8 : Texture2D::TexType_e::ETC2_RGB8;
+	ret.dim = kolme::Vec2ui(4, 4);
+	
+	auto append = [&ret](std::uint64_t bits){
+		for(unsigned i = 0; i != 8; ++i){
+			ret.data.push_back(std::uint8_t(bits >> (56 - i * 8)));
+		}
+	};
+	
+	if(hasAlpha){
+		append(alpha);
+	}
+	append(color);
+	return ret;
+}
+
+std::uint64_t bit(unsigned pos, std::uint64_t value = 1){
+	return value << pos;
+}
+
+//Pixel indices of color block, pixels of the first row get indices 0, 1, 2 and 3, the rest get 0.
+//Index of pixel (x, y) has least significant bit at x * 4 + y and most significant bit at x * 4 + y + 16.
+const std::uint64_t firstRowIndices_c = bit(4) | bit(8 + 16) | bit(12) | bit(12 + 16);
+
+void checkPixel(const Image& im, unsigned x, unsigned y, std::array<int, 3> expected){
+	auto p = &im.buf()[(y * im.dim().x + x) * im.numChannels()];
+	for(unsigned c = 0; c != expected.size(); ++c){
+		if(p[c] != expected[c]){
+			std::cout << "pixel (" << x << ", " << y << ") channel " << c << " is " << int(p[c]) << ", expected " << expected[c] << std::endl;
+		}
+		ASSERT_ALWAYS(p[c] == expected[c])
+	}
+}
+
+//maximum difference of channels [begin, end) of pixels of images
+int maxError(const Image& a, const Image& b, unsigned begin, unsigned end){
+	ASSERT_ALWAYS(a.dim() == b.dim())
+	int ret = 0;
+	for(unsigned i = 0; i != a.dim().x * a.dim().y; ++i){
+		for(unsigned c = begin; c != end; ++c){
+			ret = std::max(ret, std::abs(int(a.buf()[i * a.numChannels() + c]) - int(b.buf()[i * b.numChannels() + c])));
+		}
+	}
+	return ret;
+}
+
+}
+
+int main(int argc, char** argv){
+	//individual and differential modes made by encoder
+	{
+		Image im(kolme::Vec2ui(8, 4), Image::ColorDepth_e::RGB);
+		for(unsigned y = 0; y != 4; ++y){
+			for(unsigned x = 0; x != 8; ++x){
+				auto p = &im.pixChan(x, y, 0);
+				if(x < 4){
+					//smooth block goes to differential mode
+					p[0] = std::uint8_t(100 + x);
+					p[1] = std::uint8_t(150 + y);
+					p[2] = 200;
+				}else{
+					//halves of too different colors go to individual mode
+					p[0] = x < 6 ? 255 : 0;
+					p[1] = 0;
+					p[2] = x < 6 ? 0 : 255;
+				}
+			}
+		}
+		
+		auto e = etc::encode(im);
+		ASSERT_ALWAYS(e.type == Texture2D::TexType_e::ETC2_RGB8)
+		ASSERT_ALWAYS(e.data.size() == 16)
+		
+		//differential bit
+		ASSERT_ALWAYS((readBlock(&e.data[0]) & bit(33)) != 0)
+		ASSERT_ALWAYS((readBlock(&e.data[8]) & bit(33)) == 0)
+		
+		auto d = etc::decode(e);
+		ASSERT_ALWAYS(d.colorDepth() == Image::ColorDepth_e::RGB)
+		ASSERT_ALWAYS(maxError(d, im, 0, 3) <= 8)
+	}
+	
+	//T mode, red overflows in differential mode
+	{
+		//R = 13 (1 at bits 63..61 to overflow, 11 at 60..59, 01 at 57..56), G = 2, B = 4; R = G = B = 8; distance index 2
+		auto d = etc::decode(makeBlock(
+				bit(61, 0x7) | bit(59, 0x3) | bit(56, 0x1) | bit(52, 2) | bit(48, 4)
+						| bit(44, 8) | bit(40, 8) | bit(36, 8)
+						| bit(34, 0x1) | bit(33) | firstRowIndices_c
+			));
+		
+		checkPixel(d, 0, 0, {{221, 34, 68}});
+		checkPixel(d, 1, 0, {{147, 147, 147}});
+		checkPixel(d, 2, 0, {{136, 136, 136}});
+		checkPixel(d, 3, 0, {{125, 125, 125}});
+		checkPixel(d, 3, 3, {{221, 34, 68}});
+	}
+	
+	//H mode, green overflows in differential mode
+	{
+		//R = 8, G = 3 (001 at 58..56, 1 at 52), B = 10 (1 at 51, 010 at 49..47), 111 at 55..53 to overflow;
+		//R = 2, G = 4, B = 6; distance index 5, its lowest bit is 1 as the first color is greater
+		auto d = etc::decode(makeBlock(
+				bit(59, 8) | bit(56, 0x1) | bit(53, 0x7) | bit(52) | bit(51) | bit(47, 0x2)
+						| bit(43, 2) | bit(39, 4) | bit(35, 6)
+						| bit(34) | bit(33) | firstRowIndices_c
+			));
+		
+		checkPixel(d, 0, 0, {{168, 83, 202}});
+		checkPixel(d, 1, 0, {{104, 19, 138}});
+		checkPixel(d, 2, 0, {{66, 100, 134}});
+		checkPixel(d, 3, 0, {{2, 36, 70}});
+	}
+	
+	//planar mode, blue overflows in differential mode
+	{
+		//origin R = 32, G = 64 (1 at 56), B = 26 (11 at 44..43, 010 at 41..39), 111 at 47..45 to overflow;
+		//horizontal R = 48 (11000 at 38..34), G = 64, B = 26; vertical R = 32, G = 96, B = 26
+		auto d = etc::decode(makeBlock(
+				bit(57, 32) | bit(56) | bit(45, 0x7) | bit(43, 0x3) | bit(39, 0x2)
+						| bit(34, 0x18) | bit(33) | bit(25, 64) | bit(19, 26)
+						| bit(13, 32) | bit(6, 96) | bit(0, 26)
+			));
+		
+		checkPixel(d, 0, 0, {{130, 129, 105}});
+		checkPixel(d, 3, 0, {{179, 129, 105}});
+		checkPixel(d, 0, 3, {{130, 177, 105}});
+		checkPixel(d, 3, 3, {{179, 177, 105}});
+	}
+	
+	//EAC alpha
+	{
+		//base 128, multiplier 2, table 13; pixel (0, 0) has index 7, pixel (1, 0) has index 3, the rest have index 4
+		std::uint64_t alpha = bit(56, 128) | bit(52, 2) | bit(48, 13) | bit(45, 7) | bit(45 - 3 * 4, 3);
+		for(unsigned i = 0; i != 16; ++i){
+			if(i != 0 && i != 4){
+				alpha |= bit(45 - 3 * i, 4);
+			}
+		}
+		
+		auto d = etc::decode(makeBlock(0, true, alpha));
+		ASSERT_ALWAYS(d.colorDepth() == Image::ColorDepth_e::RGBA)
+		ASSERT_ALWAYS(d.pixChan(0, 0, 3) == 146)
+		ASSERT_ALWAYS(d.pixChan(1, 0, 3) == 108)
+		ASSERT_ALWAYS(d.pixChan(2, 0, 3) == 128)
+		ASSERT_ALWAYS(d.pixChan(0, 1, 3) == 128)
+		
+		//encoded alpha gradient, image dimensions are not multiples of block size
+		Image im(kolme::Vec2ui(7, 5), Image::ColorDepth_e::RGBA);
+		for(unsigned y = 0; y != im.dim().y; ++y){
+			for(unsigned x = 0; x != im.dim().x; ++x){
+				auto p = &im.pixChan(x, y, 0);
+				p[0] = 50;
+				p[1] = 100;
+				p[2] = 150;
+				p[3] = std::uint8_t(40 + x * 10 + y * 5);
+			}
+		}
+		
+		auto e = etc::encode(im);
+		ASSERT_ALWAYS(e.type == Texture2D::TexType_e::ETC2_RGBA8)
+		ASSERT_ALWAYS(e.data.size() == 2 * 2 * 16)
+		
+		auto r = etc::decode(e);
+		ASSERT_ALWAYS(maxError(r, im, 0, 3) <= 8)
+		ASSERT_ALWAYS(maxError(r, im, 3, 4) <= 4)
+	}
+	
+	//KTX orientation
+	{
+		Image im(kolme::Vec2ui(5, 6), Image::ColorDepth_e::RGB);
+		for(unsigned i = 0; i != im.buf().size(); ++i){
+			im.buf()[i] = std::uint8_t(i * 7);
+		}
+		auto e = etc::encode(im);
+		
+		papki::FSFile f("test.ktx");
+		etc::saveKtx(e, f);
+		
+		auto l = etc::loadKtx(f);
+		ASSERT_ALWAYS(l.type == e.type)
+		ASSERT_ALWAYS(l.dim == e.dim)
+		ASSERT_ALWAYS(l.data == e.data)
+		
+		//same file with top to bottom rows
+		auto data = f.loadWholeFileIntoMemory();
+		std::string value = "S=r,T=u";
+		auto i = std::search(data.begin(), data.end(), value.begin(), value.end());
+		ASSERT_ALWAYS(i != data.end())
+		*(i + value.size() - 1) = 'd';
+		{
+			papki::File::Guard fileGuard(f, papki::File::E_Mode::CREATE);
+			f.write(utki::wrapBuf(data));
+		}
+		
+		bool thrown = false;
+		try{
+			etc::loadKtx(f);
+		}catch(morda::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+		
+		std::remove("test.ktx");
+	}
+	
+	return 0;
+}
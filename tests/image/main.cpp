@@ -0,0 +1,105 @@
+#include "../../src/morda/util/Image.hpp"
+
+#include <utki/debug.hpp>
+#include <papki/FSFile.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+
+namespace{
+
+using namespace morda;
+
+Image crop(const Image& im, kolme::Vec2ui pos, kolme::Vec2ui dim){
+	Image ret(dim, im.colorDepth());
+	for(unsigned y = 0; y != dim.y; ++y){
+		memcpy(&ret.pixChan(0, y, 0), &im.pixChan(pos.x, pos.y + y, 0), dim.x * im.numChannels());
+	}
+	return ret;
+}
+
+//mean absolute difference of pixel channels
+double meanDiff(const Image& a, const Image& b){
+	ASSERT_ALWAYS(a.dim() == b.dim())
+	ASSERT_ALWAYS(a.colorDepth() == b.colorDepth())
+	
+	double sum = 0;
+	for(size_t i = 0; i != a.buf().size(); ++i){
+		sum += std::abs(int(a.buf()[i]) - int(b.buf()[i]));
+	}
+	return sum / double(a.buf().size());
+}
+
+}
+
+int main(int argc, char** argv){
+	papki::FSFile f("../app/res/texture.jpg");
+	
+	Image full(f);
+	ASSERT_ALWAYS(full.dim() == kolme::Vec2ui(512, 512))
+	
+	//test JPEG crop decoding, it has to match the cropped full size image exactly
+	{
+		const kolme::Rectangle<unsigned> crops[] = {
+			kolme::Rectangle<unsigned>(7, 7, 2, 2),
+			kolme::Rectangle<unsigned>(0, 0, 8, 8),
+			kolme::Rectangle<unsigned>(13, 250, 100, 3),
+			kolme::Rectangle<unsigned>(500, 500, 12, 12)
+		};
+		
+		for(auto& c : crops){
+			Image::LoadOptions o;
+			o.crop = c;
+			
+			Image im(f, o);
+			ASSERT_ALWAYS(im.dim() == c.d)
+			ASSERT_INFO_ALWAYS(
+					meanDiff(im, crop(full, c.p, c.d)) == 0,
+					"crop = (" << c.p.x << ", " << c.p.y << ", " << c.d.x << ", " << c.d.y << ")"
+				)
+		}
+	}
+	
+	//Test JPEG crop and target size decoding. Decoder downscales the image, so the result may differ
+	//a bit from resampling the full size image, but it must not be upscaled from too few decoded pixels.
+	{
+		struct{
+			kolme::Rectangle<unsigned> crop;
+			kolme::Vec2ui dim;
+		} cases[] = {
+			{kolme::Rectangle<unsigned>(4, 4, 16, 16), kolme::Vec2ui(3, 3)},
+			{kolme::Rectangle<unsigned>(100, 37, 64, 48), kolme::Vec2ui(16, 12)},
+			{kolme::Rectangle<unsigned>(3, 5, 100, 90), kolme::Vec2ui(30, 27)},
+			{kolme::Rectangle<unsigned>(250, 250, 40, 40), kolme::Vec2ui(7, 7)},
+			{kolme::Rectangle<unsigned>(0, 0, 512, 512), kolme::Vec2ui(64, 64)}
+		};
+		
+		for(auto& c : cases){
+			Image::LoadOptions o;
+			o.crop = c.crop;
+			o.dim = c.dim;
+			
+			Image im(f, o);
+			ASSERT_ALWAYS(im.dim() == c.dim)
+			
+			double diff = meanDiff(im, crop(full, c.crop.p, c.crop.d).resize(c.dim));
+			ASSERT_INFO_ALWAYS(
+					diff <= 3.5,
+					"diff = " << diff << " crop = (" << c.crop.p.x << ", " << c.crop.p.y << ", " << c.crop.d.x << ", " << c.crop.d.y << ")"
+				)
+		}
+	}
+	
+	//test reading image dimensions without decoding the image
+	{
+		ASSERT_ALWAYS(Image::readDim(f) == full.dim())
+		
+		papki::FSFile pf("../app/res/mouse_arrow.png");
+		Image png(pf);
+		ASSERT_ALWAYS(Image::readDim(pf) == png.dim())
+		ASSERT_ALWAYS(png.dim() == kolme::Vec2ui(30, 52))
+	}
+	
+	return 0;
+}
@@ -0,0 +1,159 @@
+#include "../../src/morda/util/ImageKernels.hpp"
+
+#include <utki/debug.hpp>
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <functional>
+#include <string>
+#include <iostream>
+
+
+namespace{
+
+typedef std::chrono::steady_clock Clock;
+
+double msSince(Clock::time_point t){
+	return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+}
+
+const unsigned numIterations_c = 50;
+
+//image of odd dimensions, so that vectorized loops always have tails
+const unsigned width_c = 1023;
+const unsigned height_c = 511;
+
+std::vector<std::uint8_t> randomBytes(size_t size, std::mt19937& rnd){
+	std::vector<std::uint8_t> ret(size);
+	for(auto& b : ret){
+		b = std::uint8_t(rnd());
+	}
+	return ret;
+}
+
+std::vector<float> randomFloats(size_t size, std::mt19937& rnd){
+	//values are out of [0, 255] range sometimes, to check clamping
+	std::uniform_real_distribution<float> dist(-20, 280);
+	std::vector<float> ret(size);
+	for(auto& f : ret){
+		f = dist(rnd);
+	}
+	return ret;
+}
+
+//runs both versions of the kernel on same data, checks that results are equal and prints timings
+template <class T> void benchmark(
+		const std::string& name,
+		std::vector<T> data,
+		const std::function<void(T*)>& vectorized,
+		const std::function<void(T*)>& scalar
+	)
+{
+	auto vectorizedData = data;
+	auto scalarData = data;
+	
+	vectorized(vectorizedData.data());
+	scalar(scalarData.data());
+	ASSERT_ALWAYS(vectorizedData == scalarData)
+	
+	double vectorizedMs;
+	{
+		auto t = Clock::now();
+		for(unsigned i = 0; i != numIterations_c; ++i){
+			vectorized(vectorizedData.data());
+		}
+		vectorizedMs = msSince(t);
+	}
+	
+	double scalarMs;
+	{
+		auto t = Clock::now();
+		for(unsigned i = 0; i != numIterations_c; ++i){
+			scalar(scalarData.data());
+		}
+		scalarMs = msSince(t);
+	}
+	
+	std::cout << name << " x " << numIterations_c << ": " << vectorizedMs << " ms, scalar " << scalarMs << " ms, speedup " << (scalarMs / vectorizedMs) << std::endl;
+}
+
+}
+
+int main(int argc, char** argv){
+	using namespace morda;
+	
+	std::mt19937 rnd(1);
+	
+	const size_t numPixels = width_c * height_c;
+	
+	auto grey = randomBytes(numPixels, rnd);
+	
+	for(unsigned chan = 0; chan != 2; ++chan){
+		benchmark<std::uint8_t>(
+				chan == 0 ? "copyChannel GREY -> GREYA[0]" : "copyChannel GREY -> GREYA[1]",
+				randomBytes(numPixels * 2, rnd),
+				[&grey, chan, numPixels](std::uint8_t* d){imageKernels::copyChannel(d + chan, 2, grey.data(), 1, numPixels);},
+				[&grey, chan, numPixels](std::uint8_t* d){imageKernels::scalar::copyChannel(d + chan, 2, grey.data(), 1, numPixels);}
+			);
+		
+		benchmark<std::uint8_t>(
+				chan == 0 ? "maxChannel GREY -> GREYA[0]" : "maxChannel GREY -> GREYA[1]",
+				randomBytes(numPixels * 2, rnd),
+				[&grey, chan, numPixels](std::uint8_t* d){imageKernels::maxChannel(d + chan, 2, grey.data(), 1, numPixels);},
+				[&grey, chan, numPixels](std::uint8_t* d){imageKernels::scalar::maxChannel(d + chan, 2, grey.data(), 1, numPixels);}
+			);
+	}
+	
+	benchmark<std::uint8_t>(
+			"maxChannel GREY -> GREY",
+			randomBytes(numPixels, rnd),
+			[&grey, numPixels](std::uint8_t* d){imageKernels::maxChannel(d, 1, grey.data(), 1, numPixels);},
+			[&grey, numPixels](std::uint8_t* d){imageKernels::scalar::maxChannel(d, 1, grey.data(), 1, numPixels);}
+		);
+	
+	for(unsigned numChannels = 1; numChannels <= 4; ++numChannels){
+		benchmark<std::uint8_t>(
+				"flipVertical " + std::to_string(numChannels) + " channels",
+				randomBytes(numPixels * numChannels, rnd),
+				[numChannels](std::uint8_t* d){imageKernels::flipVertical(d, width_c * numChannels, height_c);},
+				[numChannels](std::uint8_t* d){imageKernels::scalar::flipVertical(d, width_c * numChannels, height_c);}
+			);
+	}
+	
+	for(unsigned numChannels = 2; numChannels <= 4; numChannels += 2){
+		benchmark<std::uint8_t>(
+				numChannels == 2 ? "premultiplyAlpha GREYA" : "premultiplyAlpha RGBA",
+				randomBytes(numPixels * numChannels, rnd),
+				[numChannels, numPixels](std::uint8_t* d){imageKernels::premultiplyAlpha(d, numChannels, numPixels);},
+				[numChannels, numPixels](std::uint8_t* d){imageKernels::scalar::premultiplyAlpha(d, numChannels, numPixels);}
+			);
+	}
+	
+	for(unsigned numChannels = 3; numChannels <= 4; ++numChannels){
+		benchmark<std::uint8_t>(
+				numChannels == 3 ? "swapRedBlue RGB" : "swapRedBlue RGBA",
+				randomBytes(numPixels * numChannels, rnd),
+				[numChannels, numPixels](std::uint8_t* d){imageKernels::swapRedBlue(d, numChannels, numPixels);},
+				[numChannels, numPixels](std::uint8_t* d){imageKernels::scalar::swapRedBlue(d, numChannels, numPixels);}
+			);
+	}
+	
+	auto floats = randomFloats(numPixels * 4, rnd);
+	
+	benchmark<float>(
+			"addWeighted",
+			randomFloats(numPixels * 4, rnd),
+			[&floats](float* d){imageKernels::addWeighted(d, floats.data(), 0.3f, floats.size());},
+			[&floats](float* d){imageKernels::scalar::addWeighted(d, floats.data(), 0.3f, floats.size());}
+		);
+	
+	benchmark<std::uint8_t>(
+			"floatsToBytes",
+			std::vector<std::uint8_t>(floats.size()),
+			[&floats](std::uint8_t* d){imageKernels::floatsToBytes(d, floats.data(), floats.size());},
+			[&floats](std::uint8_t* d){imageKernels::scalar::floatsToBytes(d, floats.data(), floats.size());}
+		);
+	
+	return 0;
+}
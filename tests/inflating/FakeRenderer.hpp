@@ -1,11 +1,12 @@
 #pragma once
 
 #include "../../src/morda/render/Renderer.hpp"
+#include "../../src/morda/render/CpuTexture2D.hpp"
 
 class FakeFactory : public morda::RenderFactory{
 public:
 	std::shared_ptr<morda::FrameBuffer> createFramebuffer(std::shared_ptr<morda::Texture2D> color) override{
-		return nullptr;
+		return utki::makeShared<morda::FrameBuffer>(std::move(color));
 	}
 	
 	std::shared_ptr<morda::IndexBuffer> createIndexBuffer(const utki::Buf<std::uint16_t> indices) override{
@@ -17,7 +18,7 @@ public:
 	}
 
 	std::shared_ptr<morda::Texture2D> createTexture2D(morda::Texture2D::TexType_e type, kolme::Vec2ui dim, const utki::Buf<std::uint8_t>& data) override{
-		return nullptr;
+		return utki::makeShared<morda::CpuTexture2D>(type, dim, data);
 	}
 
 	std::shared_ptr<morda::VertexArray> createVertexArray(
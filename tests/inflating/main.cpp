@@ -7,6 +7,9 @@ class TestMorda : public morda::Morda{
 	
 public:
 	TestMorda() : morda::Morda(utki::makeShared<FakeRenderer>(), 0, 0){}
+	~TestMorda()noexcept{
+		this->shutdownThreadPool();
+	}
 	void postToUiThread_ts(std::function<void()>&& f) override{
 		
 	}
@@ -0,0 +1,173 @@
+#include "../../src/morda/Morda.hpp"
+
+#include "../../src/morda/widgets/TreeView.hpp"
+
+#include "../inflating/FakeRenderer.hpp"
+
+#include <random>
+
+
+class TestMorda : public morda::Morda{
+	
+public:
+	TestMorda() : morda::Morda(utki::makeShared<FakeRenderer>(), 0, 0){}
+	~TestMorda()noexcept{
+		this->shutdownThreadPool();
+	}
+	void postToUiThread_ts(std::function<void()>&& f) override{
+		
+	}
+};
+
+namespace{
+
+//checks flat indices against stepping through the whole tree in depth-first order
+void checkTree(morda::Tree& tree){
+	size_t index = 0;
+	for(auto i = tree.begin(); i != tree.end(); ++i, ++index){
+		ASSERT_INFO_ALWAYS(tree.indexOf(i.path()) == index, "index = " << index)
+		
+		auto p = tree.posAt(index);
+		ASSERT_INFO_ALWAYS(p.path() == i.path(), "index = " << index)
+	}
+	ASSERT_ALWAYS(index == tree.size())
+	ASSERT_ALWAYS(!tree.posAt(tree.size()))
+}
+
+}
+
+int main(int argc, char** argv){
+	TestMorda m;
+	
+	//test conversion between flat index and path
+	{
+		morda::Tree tree;
+		tree.resetChildren(10);
+		checkTree(tree);
+		
+		std::mt19937 rnd(1);
+		
+		for(unsigned k = 0; k != 2000; ++k){
+			ASSERT_ALWAYS(tree.size() != 0)
+			auto i = tree.posAt(rnd() % tree.size());
+			ASSERT_ALWAYS(i)
+			
+			switch(rnd() % 4){
+				case 0:
+					//expand a leaf node
+					if((*i).numChildren() == 0){
+						tree.resetChildren(i, rnd() % 5 + 1);
+					}
+					break;
+				case 1:
+					//add siblings before the node
+					tree.add(i, rnd() % 3 + 1);
+					break;
+				case 2:
+					//collapse the node
+					if(tree.size() > 20){
+						tree.removeAll(i);
+					}
+					break;
+				case 3:
+					//remove the node with its subtree
+					if(tree.size() > 20){
+						tree.remove(i);
+					}
+					break;
+			}
+			
+			if(k % 50 == 0){
+				checkTree(tree);
+			}
+		}
+		checkTree(tree);
+	}
+	
+	//test adding child to collapsed tree view item
+	{
+		class Provider : public morda::TreeView::ItemsProvider{
+		public:
+			size_t numChildrenOfFirst = 0;
+			
+			std::shared_ptr<morda::Widget> getWidget(const std::vector<size_t>& path, bool isCollapsed)override{
+				return utki::makeShared<morda::Widget>(nullptr);
+			}
+			
+			size_t count(const std::vector<size_t>& path)const noexcept override{
+				if(path.size() == 0){
+					return 2;
+				}
+				if(path.size() == 1 && path[0] == 0){
+					return this->numChildrenOfFirst;
+				}
+				return 0;
+			}
+		};
+		
+		auto tv = utki::makeShared<morda::TreeView>();
+		auto p = utki::makeShared<Provider>();
+		tv->setItemsProvider(p);
+		
+		ASSERT_ALWAYS(p->indexOf(std::vector<size_t>({1})) == 1)
+		
+		p->numChildrenOfFirst = 1;
+		p->notifyItemAdded(std::vector<size_t>({0, 0}));
+		
+		//added child is not visible since its parent is collapsed
+		ASSERT_ALWAYS(p->indexOf(std::vector<size_t>({1})) == 1)
+		
+		p->uncollapse(std::vector<size_t>({0}));
+		ASSERT_ALWAYS(p->indexOf(std::vector<size_t>({0, 0})) == 1)
+		ASSERT_ALWAYS(p->indexOf(std::vector<size_t>({1})) == 2)
+	}
+	
+	//test children delivered synchronously from within loadChildrenAsync()
+	{
+		class Provider : public morda::TreeView::ItemsProvider{
+		public:
+			bool finish = true;
+			unsigned lastToken = 0;
+			
+			std::shared_ptr<morda::Widget> getWidget(const std::vector<size_t>& path, bool isCollapsed)override{
+				return utki::makeShared<morda::Widget>(nullptr);
+			}
+			
+			size_t count(const std::vector<size_t>& path)const noexcept override{
+				if(path.size() == 0){
+					return 2;
+				}
+				return 0;
+			}
+			
+			bool loadChildrenAsync(const std::vector<size_t>& path, unsigned token)override{
+				this->lastToken = token;
+				this->notifyChildrenLoaded(token, 3, this->finish);
+				return true;
+			}
+		};
+		
+		auto tv = utki::makeShared<morda::TreeView>();
+		auto p = utki::makeShared<Provider>();
+		tv->setItemsProvider(p);
+		
+		p->uncollapse(std::vector<size_t>({0}));
+		ASSERT_ALWAYS(p->indexOf(std::vector<size_t>({0, 2})) == 3)
+		ASSERT_ALWAYS(p->indexOf(std::vector<size_t>({1})) == 4)
+		
+		//loading is finished partially, the rest is delivered later
+		p->finish = false;
+		p->uncollapse(std::vector<size_t>({1}));
+		ASSERT_ALWAYS(p->indexOf(std::vector<size_t>({1, 2})) == 7)
+		ASSERT_ALWAYS(p->pathOf(8) == std::vector<size_t>({1, 3})) //placeholder
+		
+		p->notifyChildrenLoaded(p->lastToken, 1, true);
+		ASSERT_ALWAYS(p->indexOf(std::vector<size_t>({1, 3})) == 8)
+		
+		//placeholder is removed
+		std::shared_ptr<morda::TreeView::ItemsProvider> tp = p;
+		ASSERT_ALWAYS(std::static_pointer_cast<morda::List::ItemsProvider>(tp)->count() == 9)
+	}
+	
+	return 0;
+}
@@ -0,0 +1,122 @@
+#include "../../src/morda/Morda.hpp"
+
+#include "../inflating/FakeRenderer.hpp"
+
+#include <chrono>
+#include <thread>
+#include <random>
+#include <iostream>
+
+
+class TestMorda : public morda::Morda{
+	
+public:
+	TestMorda() : morda::Morda(utki::makeShared<FakeRenderer>(), 0, 0){}
+	~TestMorda()noexcept{
+		this->shutdownThreadPool();
+	}
+	void postToUiThread_ts(std::function<void()>&& f) override{
+		
+	}
+};
+
+namespace{
+
+class TestUpdateable : public morda::Updateable{
+public:
+	unsigned numUpdates = 0;
+	
+	void update(std::uint32_t dtMs)override{
+		++this->numUpdates;
+	}
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double msSince(Clock::time_point t){
+	return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+}
+
+}
+
+int main(int argc, char** argv){
+	TestMorda m;
+	
+	const unsigned numUpdateables_c = 100000;
+	const unsigned numChurns_c = 200000;
+	
+	std::mt19937 rnd(1);
+	
+	std::vector<std::shared_ptr<TestUpdateable>> updateables;
+	updateables.reserve(numUpdateables_c);
+	for(unsigned i = 0; i != numUpdateables_c; ++i){
+		updateables.push_back(utki::makeShared<TestUpdateable>());
+	}
+	
+	//benchmark start updating
+	{
+		auto t = Clock::now();
+		for(auto& u : updateables){
+			u->startUpdating(std::uint16_t(10 + rnd() % 1000));
+		}
+		std::cout << "startUpdating() x " << numUpdateables_c << ": " << msSince(t) << " ms" << std::endl;
+	}
+	
+	//benchmark random stop/start churn
+	{
+		auto t = Clock::now();
+		for(unsigned i = 0; i != numChurns_c; ++i){
+			auto& u = updateables[rnd() % updateables.size()];
+			if(u->isUpdating()){
+				u->stopUpdating();
+			}else{
+				u->startUpdating(std::uint16_t(10 + rnd() % 1000));
+			}
+		}
+		std::cout << "stopUpdating()/startUpdating() x " << numChurns_c << ": " << msSince(t) << " ms" << std::endl;
+	}
+	
+	//make sure all are updating
+	for(auto& u : updateables){
+		if(!u->isUpdating()){
+			u->startUpdating(std::uint16_t(10 + rnd() % 1000));
+		}
+	}
+	
+	//benchmark updating
+	{
+		double updateMs = 0;
+		unsigned numUpdateCalls = 0;
+		
+		auto t = Clock::now();
+		while(msSince(t) < 2000){
+			auto ut = Clock::now();
+			auto wait = m.update();
+			updateMs += msSince(ut);
+			++numUpdateCalls;
+			
+			ASSERT_ALWAYS(wait != std::uint32_t(-1))
+			std::this_thread::sleep_for(std::chrono::milliseconds(std::min(wait, std::uint32_t(10))));
+		}
+		
+		unsigned long long numUpdates = 0;
+		for(auto& u : updateables){
+			//every updateable has period of at most 1010 ms, so within 2 seconds it should be updated at least once
+			ASSERT_ALWAYS(u->numUpdates != 0)
+			numUpdates += u->numUpdates;
+		}
+		
+		std::cout << "update() x " << numUpdateCalls << ": " << updateMs << " ms, " << numUpdates << " updates" << std::endl;
+	}
+	
+	//destroying updateables which are in the update queue should remove them from the queue
+	{
+		auto t = Clock::now();
+		updateables.clear();
+		std::cout << "destroying " << numUpdateables_c << " updating objects: " << msSince(t) << " ms" << std::endl;
+		
+		ASSERT_ALWAYS(m.update() == std::uint32_t(-1))
+	}
+	
+	return 0;
+}
@@ -0,0 +1,216 @@
+#include "../../src/morda/util/ZipFile.hpp"
+#include "../../src/morda/util/MappedFile.hpp"
+#include "../../src/morda/ThreadPool.hpp"
+
+#include <utki/debug.hpp>
+#include <papki/FSFile.hpp>
+
+#include <string>
+#include <array>
+#include <algorithm>
+
+
+namespace{
+
+using namespace morda;
+
+//test.zip contains stored.txt (stored), dir/deflated.txt, big1.bin and big2.bin (deflated)
+std::unique_ptr<ZipFile> openArchive(const std::string& fileName){
+	return utki::makeUnique<ZipFile>(utki::makeUnique<papki::FSFile>(fileName));
+}
+
+std::vector<std::uint8_t> repeat(const std::string& s, unsigned n){
+	std::vector<std::uint8_t> ret;
+	for(unsigned i = 0; i != n; ++i){
+		ret.insert(ret.end(), s.begin(), s.end());
+	}
+	return ret;
+}
+
+std::vector<std::uint8_t> load(ZipFile& zf, const std::string& path){
+	zf.setPath(path);
+	return zf.loadWholeFileIntoMemory();
+}
+
+const size_t bigFileSize = 30000;
+	
+}
+
+
+
+int main(int argc, char** argv){
+	auto storedContents = repeat("stored file contents\n", 10);
+	auto deflatedContents = repeat("deflated file contents\n", 100);
+	
+	//reference contents of big files, read without cache
+	std::vector<std::uint8_t> big1, big2;
+	{
+		auto zf = openArchive("test.zip");
+		zf->setCacheSize(0);
+		
+		big1 = load(*zf, "big1.bin");
+		big2 = load(*zf, "big2.bin");
+		ASSERT_ALWAYS(big1.size() == bigFileSize)
+		ASSERT_ALWAYS(big2.size() == bigFileSize)
+		ASSERT_ALWAYS(big1 != big2)
+	}
+	
+	//test reading files through the index
+	{
+		auto zf = openArchive("test.zip");
+		
+		zf->setPath("stored.txt");
+		ASSERT_ALWAYS(zf->exists())
+		zf->setPath("dir/deflated.txt");
+		ASSERT_ALWAYS(zf->exists())
+		zf->setPath("absent.txt");
+		ASSERT_ALWAYS(!zf->exists())
+		
+		zf->setPath("dir/");
+		auto ls = zf->listDirContents();
+		ASSERT_INFO_ALWAYS(ls.size() == 1 && ls[0] == "deflated.txt", "ls.size() = " << ls.size())
+		
+		ASSERT_ALWAYS(load(*zf, "stored.txt") == storedContents)
+		ASSERT_ALWAYS(load(*zf, "dir/deflated.txt") == deflatedContents)
+		
+		//spawned file interfaces share the index
+		auto s = zf->spawn();
+		s->setPath("dir/deflated.txt");
+		ASSERT_ALWAYS(s->loadWholeFileIntoMemory() == deflatedContents)
+		
+		//reading in small chunks
+		{
+			zf->setPath("stored.txt");
+			papki::File::Guard guard(*zf);
+			std::vector<std::uint8_t> chunks;
+			std::array<std::uint8_t, 7> buf;
+			while(auto n = zf->read(utki::wrapBuf(buf))){
+				chunks.insert(chunks.end(), buf.begin(), buf.begin() + n);
+			}
+			ASSERT_ALWAYS(chunks == storedContents)
+		}
+		
+		bool thrown = false;
+		try{
+			load(*zf, "absent.txt");
+		}catch(papki::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+	
+	//test reading stored file right from the archive mapping
+	{
+		auto zf = openArchive("test.zip");
+		
+		std::shared_ptr<const MappedFile> archive;
+		
+		zf->setPath("stored.txt");
+		auto data = zf->storedData(archive);
+		ASSERT_ALWAYS(archive)
+		ASSERT_ALWAYS(data.size() == storedContents.size())
+		ASSERT_ALWAYS(std::equal(data.begin(), data.end(), storedContents.begin()))
+		ASSERT_ALWAYS(data.begin() >= archive->data() && data.end() <= archive->data() + archive->size())
+		
+		//mapping outlives the file interface
+		zf.reset();
+		ASSERT_ALWAYS(std::equal(data.begin(), data.end(), storedContents.begin()))
+		
+		zf = openArchive("test.zip");
+		zf->setPath("dir/deflated.txt");
+		ASSERT_ALWAYS(zf->storedData(archive).size() == 0)
+		ASSERT_ALWAYS(!archive)
+		
+		zf->setPath("absent.txt");
+		ASSERT_ALWAYS(zf->storedData(archive).size() == 0)
+		ASSERT_ALWAYS(!archive)
+		
+		//MappedFile uses the archive mapping for stored files
+		zf->setPath("stored.txt");
+		MappedFile mf(*zf);
+		ASSERT_ALWAYS(mf.size() == storedContents.size())
+		ASSERT_ALWAYS(std::equal(mf.data(), mf.data() + mf.size(), storedContents.begin()))
+	}
+	
+	//test that file with wrong CRC is rejected
+	{
+		auto zf = openArchive("bad_crc.zip");
+		
+		bool thrown = false;
+		try{
+			load(*zf, "deflated.txt");
+		}catch(papki::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+		
+		//file with wrong CRC is not put to the cache
+		thrown = false;
+		try{
+			zf->preload({"deflated.txt"});
+		}catch(papki::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+		
+		thrown = false;
+		try{
+			load(*zf, "deflated.txt");
+		}catch(papki::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+	
+	//test preloading with thread pool
+	{
+		ThreadPool pool(2);
+		
+		auto zf = openArchive("test.zip");
+		zf->preload({"stored.txt", "dir/deflated.txt", "big1.bin", "big2.bin"}, &pool);
+		
+		ASSERT_ALWAYS(load(*zf, "stored.txt") == storedContents)
+		ASSERT_ALWAYS(load(*zf, "dir/deflated.txt") == deflatedContents)
+		ASSERT_ALWAYS(load(*zf, "big1.bin") == big1)
+		ASSERT_ALWAYS(load(*zf, "big2.bin") == big2)
+		
+		//spawned file interfaces share the cache
+		auto s = zf->spawn();
+		s->setPath("big2.bin");
+		ASSERT_ALWAYS(s->loadWholeFileIntoMemory() == big2)
+		
+		bool thrown = false;
+		try{
+			zf->preload({"absent.txt"}, &pool);
+		}catch(papki::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+	
+	//test cache eviction, the cache fits only one big file
+	{
+		auto zf = openArchive("test.zip");
+		zf->setCacheSize(bigFileSize + bigFileSize / 2);
+		
+		zf->preload({"big1.bin", "big2.bin"});
+		
+		//big1.bin was evicted, it is inflated again
+		ASSERT_ALWAYS(load(*zf, "big1.bin") == big1)
+		ASSERT_ALWAYS(load(*zf, "big2.bin") == big2)
+		
+		//file which does not fit into the cache is skipped
+		zf->setCacheSize(bigFileSize / 2);
+		zf->preload({"big1.bin"});
+		ASSERT_ALWAYS(load(*zf, "big1.bin") == big1)
+		ASSERT_ALWAYS(load(*zf, "dir/deflated.txt") == deflatedContents)
+		
+		//disabling the cache drops cached files
+		zf->setCacheSize(0);
+		zf->preload({"dir/deflated.txt", "big2.bin"});
+		ASSERT_ALWAYS(load(*zf, "dir/deflated.txt") == deflatedContents)
+		ASSERT_ALWAYS(load(*zf, "big2.bin") == big2)
+	}
+	
+	return 0;
+}